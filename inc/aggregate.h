@@ -0,0 +1,52 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <stdint.h>
+
+/* kernels folding a column of a leaf's rows into running totals. Rows sit
+ * one after another at a fixed stride, so the column is read straight out of
+ * the page: AVX2 gathers when the CPU has it, SSE2 or plain loops otherwise */
+
+/**
+ * Structure of AggregateState
+ *
+ * sum, min and max of a column over the rows seen so far, the integer fields
+ * are for sl_no and year, the real ones for power
+ */
+typedef struct {
+	uint64_t sum;
+	uint32_t min;
+	uint32_t max;
+	double real_sum;
+	double real_min;
+	double real_max;
+} AggregateState;
+
+/**
+  * @brief: reset state to no rows seen
+  * @param: state to reset
+  */
+void aggregate_state_init(AggregateState* state);
+
+/**
+  * @brief: fold a uint32 column of count rows into state
+  * @param: state to update
+  * @param: column of the first row, the rest are stride bytes apart
+  * @param: number of rows
+  * @param: bytes from one row to the next
+  */
+void aggregate_uint32_block(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride);
+
+/**
+  * @brief: fold a double column of count rows into state, NaN is left out of
+  *         min and max but makes the sum NaN
+  * @param: state to update
+  * @param: column of the first row, the rest are stride bytes apart
+  * @param: number of rows
+  * @param: bytes from one row to the next
+  */
+void aggregate_double_block(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride);
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pager.h"
+#include "dictionary.h"
+#include "zonemap.h"
+#include "hashindex.h"
+#include "threadpool.h"
+
+/* table is stored as a B+tree keyed on Row.sl_no, page 0 is the table header
+ * and the tree lives in the pages after it */
+
+#define TABLE_HEADER_PAGE 0
+#define TABLE_MAGIC 0x42445053  // "SPDB" read as little endian
+#define TABLE_FORMAT_VERSION 1  // files written before there was one read as 0
+
+typedef enum {
+	NODE_INTERNAL,
+	NODE_LEAF
+} NodeType;
+
+/* how a leaf stores its cells, whole rows one after another, each column
+ * of all its rows together so scans of a few columns read only those, or
+ * variable length records holding only the bytes their strings use */
+typedef enum {
+	LEAF_LAYOUT_ROWS,
+	LEAF_LAYOUT_COLUMNS,
+	LEAF_LAYOUT_SLOTTED,
+	LEAF_LAYOUT_DICTIONARY  // slotted, company is a code into the table's dictionary
+} LeafLayout;
+
+/* table header layout, page 0 */
+extern const uint32_t TABLE_MAGIC_OFFSET;
+extern const uint32_t TABLE_ROOT_PAGE_OFFSET;
+extern const uint32_t TABLE_NUM_ROWS_OFFSET;
+extern const uint32_t TABLE_LAYOUT_OFFSET;
+extern const uint32_t TABLE_DICTIONARY_OFFSET;
+extern const uint32_t TABLE_ZONE_MAP_OFFSET;
+extern const uint32_t TABLE_COMPANY_INDEX_OFFSET;
+extern const uint32_t TABLE_VERSION_OFFSET;
+extern const uint32_t TABLE_PAGE_COUNT_OFFSET;
+extern const uint32_t TABLE_FREE_LIST_OFFSET;
+
+/* common node header layout */
+extern const uint32_t NODE_TYPE_SIZE;
+extern const uint32_t NODE_TYPE_OFFSET;
+extern const uint32_t COMMON_NODE_HEADER_SIZE;
+
+/* leaf node layout */
+extern const uint32_t LEAF_NODE_LAYOUT_OFFSET;
+extern const uint32_t LEAF_NODE_NUM_CELLS_OFFSET;
+extern const uint32_t LEAF_NODE_NEXT_LEAF_OFFSET;
+extern const uint32_t LEAF_NODE_HEADER_SIZE;
+extern const uint32_t LEAF_NODE_CELL_SIZE;
+extern const uint32_t LEAF_NODE_MAX_CELLS;  // fixed size cells, slotted leaves fit as many as have room
+
+/* slotted leaf layout */
+extern const uint32_t LEAF_NODE_HEAP_START_OFFSET;
+extern const uint32_t LEAF_NODE_SLOT_SIZE;
+extern const uint32_t RECORD_SLNO_OFFSET;
+extern const uint32_t RECORD_YEAR_OFFSET;
+extern const uint32_t RECORD_POWER_OFFSET;
+extern const uint32_t RECORD_COMPANY_OFFSET;
+extern const uint32_t RECORD_COMPANY_CODE_SIZE;
+
+/* internal node layout */
+extern const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET;
+extern const uint32_t INTERNAL_NODE_RIGHT_CHILD_OFFSET;
+extern const uint32_t INTERNAL_NODE_HEADER_SIZE;
+extern const uint32_t INTERNAL_NODE_CHILD_SIZE;
+extern const uint32_t INTERNAL_NODE_KEY_SIZE;
+extern const uint32_t INTERNAL_NODE_CELL_SIZE;
+extern const uint32_t INTERNAL_NODE_MAX_KEYS;
+
+/* Table structure that points to the root of the tree and keeps track of how many rows are there */
+typedef struct {
+	uint32_t root_page_num;
+	uint32_t num_rows;
+	LeafLayout layout;  // of leaves made for this table
+	Dictionary* dictionary;  // company names of a LEAF_LAYOUT_DICTIONARY table, NULL otherwise
+	ZoneMap* zones;  // ranges of every leaf, NULL for files made before there were any
+	HashIndex* company_index;  // sl_no of the rows of every company, NULL in older files
+	Pager* pager;  // making request for page from Pager
+	ThreadPool* pool;  // workers for scans of many leaves, NULL to scan on the calling thread
+} Table;
+
+/**
+ * Structure of Cursor
+ *
+ * position of a row in the table, a leaf page and a cell in it
+ */
+typedef struct {
+	Table* table;
+	uint32_t page_num;
+	uint32_t cell_num;
+	bool end_of_table;  // position one past the last row
+} Cursor;
+
+/* result of inserting into the tree */
+typedef enum {
+	BTREE_INSERT_SUCCESS,
+	BTREE_DUPLICATE_KEY
+} BtreeInsertResult;
+
+NodeType get_node_type(void* node);
+uint32_t* leaf_node_num_cells(void* node);
+uint32_t* leaf_node_next_leaf(void* node);
+LeafLayout leaf_node_layout(void* node);
+void* leaf_node_cell(void* node, uint32_t cell_num);  // LEAF_LAYOUT_ROWS only
+uint32_t leaf_node_key(void* node, uint32_t cell_num);
+
+/**
+  * @brief: where one column of a cell is stored, for any layout. Company
+  *         of a dictionary leaf is its code, RECORD_COMPANY_CODE_SIZE bytes
+  * @param: leaf node
+  * @param: cell in the leaf
+  * @param: offset of the column in a serialized row
+  * @param: size of the column
+  */
+void* leaf_node_field(void* node, uint32_t cell_num, uint32_t offset, uint32_t size);
+
+/**
+  * @brief: distance between a column of consecutive cells
+  * @param: leaf node
+  * @param: size of the column
+  * @return: stride, 0 if cells aren't evenly spaced(slotted leaf)
+  */
+uint32_t leaf_node_field_stride(void* node, uint32_t size);
+
+/**
+  * @brief: serialized row of a cell
+  * @param: leaf node
+  * @param: cell in the leaf
+  * @param: LEAF_NODE_CELL_SIZE bytes the row is gathered into unless the leaf stores rows whole
+  * @param: dictionary of the table, to decode the company of a dictionary leaf
+  * @return: the row, in the page or in buffer
+  */
+void* leaf_node_row(void* node, uint32_t cell_num, void* buffer, Dictionary* dictionary);
+uint32_t* internal_node_num_keys(void* node);
+uint32_t* internal_node_right_child(void* node);
+uint32_t* internal_node_child(void* node, uint32_t child_num);
+uint32_t* internal_node_key(void* node, uint32_t key_num);
+
+/**
+  * @brief: set up header page and an empty root leaf for a new database
+  * @param: table whose pager has no pages yet
+  * @param: layout of the table's leaves
+  */
+void btree_init(Table* table, LeafLayout layout);
+
+/**
+  * @brief: load root page, row count and the other structures from the
+  *         header page, exits if the file is newer or shorter than it says
+  * @param: table with its pager opened
+  */
+void btree_load_header(Table* table);
+
+/**
+  * @brief: cursor at the first row of the table
+  * @param: table to walk
+  * @return: cursor, end_of_table is set if table is empty
+  */
+Cursor table_start(Table* table);
+
+/**
+  * @brief: cursor at the first row whose key is >= key
+  * @param: table to search
+  * @param: key to search for
+  * @return: cursor, end_of_table is set if all keys are smaller
+  */
+Cursor table_find(Table* table, uint32_t key);
+
+/**
+  * @brief: pointer to the serialized row under the cursor, valid until the
+  *         next page request
+  * @param: cursor positioned on a row
+  * @param: LEAF_NODE_CELL_SIZE bytes the row is gathered into unless the leaf stores rows whole
+  */
+void* cursor_value(Cursor* cursor, void* buffer);
+
+/**
+  * @brief: key(sl_no) of the row under the cursor
+  * @param: cursor positioned on a row
+  */
+uint32_t cursor_key(Cursor* cursor);
+
+/**
+  * @brief: move cursor to the next row, following next_leaf across pages
+  * @param: cursor to advance
+  */
+void cursor_advance(Cursor* cursor);
+
+/**
+  * @brief: insert serialized row into the tree, splitting nodes on the way up
+  * @param: table to insert into
+  * @param: key of the row, its sl_no
+  * @param: serialized row, LEAF_NODE_CELL_SIZE bytes
+  * @return: BTREE_DUPLICATE_KEY if key is already in the table
+  */
+BtreeInsertResult btree_insert(Table* table, uint32_t key, void* row);
+
+/**
+  * @brief: insert meant for bulk loads where keys mostly ascend, appends to
+  *         the last leaf without searching when key is the largest so far
+  * @param: table to insert into
+  * @param: key of the row, its sl_no
+  * @param: serialized row, LEAF_NODE_CELL_SIZE bytes
+  * @return: BTREE_DUPLICATE_KEY if key is already in the table
+  */
+BtreeInsertResult btree_append(Table* table, uint32_t key, void* row);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pager.h"
+
+/* dictionary of a table's company names, a name is stored once and rows
+ * refer to it by its code, the order it was first seen in. Kept in a chain of
+ * pages so it's written and logged like any other page, and loaded whole
+ * into memory when the table is opened
+
+   dictionary page
+   attr        size     offset
+   next_page   4        0     0 on the last page
+   num_entries 4        4
+   entries              8     length(1 byte) and the name, no terminator
+   */
+
+#define DICTIONARY_NONE UINT32_MAX  // code of a name that isn't in the dictionary
+#define DICTIONARY_MAX_ENTRIES 65536  // codes are stored in 2 bytes
+
+#define DICTIONARY_BLOCK_ENTRIES 256  // entries are allocated this many at a time
+#define DICTIONARY_NAMES_BLOCK 4096  // bytes of names allocated at a time
+
+/**
+ * Structure of DictionaryEntry
+ *
+ * a name of the dictionary
+ */
+typedef struct {
+	const char* name;  // NUL terminated, in one of the name blocks
+	uint32_t length;
+} DictionaryEntry;
+
+/**
+ * Structure of Dictionary
+ *
+ * every name with its code as the index, and a hash on the names to find
+ * the code of one. Entries and names are kept in blocks which never move,
+ * so a reader can turn a code into its name while the writer adds others
+ */
+typedef struct {
+	Pager* pager;
+	uint32_t first_page;
+	uint32_t last_page;  // page new entries go to
+	uint32_t last_page_used;  // bytes of last page in use
+
+	DictionaryEntry* entries[DICTIONARY_MAX_ENTRIES / DICTIONARY_BLOCK_ENTRIES];
+	uint32_t num_entries;
+	char** name_blocks;
+	uint32_t num_name_blocks;
+	uint32_t names_used;  // bytes of the last name block in use
+	uint32_t* slots;  // code, DICTIONARY_NONE if empty
+	uint32_t num_slots;
+} Dictionary;
+
+/**
+  * @brief: new empty dictionary with its first page allocated
+  * @param: pager of the table
+  * @return: dictionary, its first_page goes to the table header
+  */
+Dictionary* dictionary_create(Pager* pager);
+
+/**
+  * @brief: load a dictionary written before
+  * @param: pager of the table
+  * @param: first page of the dictionary
+  * @return: dictionary with every name in memory
+  */
+Dictionary* dictionary_open(Pager* pager, uint32_t first_page);
+
+/**
+  * @brief: code of a name
+  * @param: dictionary
+  * @param: name, not NUL terminated
+  * @param: length of the name
+  * @return: code, DICTIONARY_NONE if no row has the name
+  */
+uint32_t dictionary_lookup(Dictionary* dictionary, const char* name, uint32_t length);
+
+/**
+  * @brief: code of a name, adding it to the dictionary and its pages if it's
+  *         new
+  * @param: dictionary
+  * @param: name, not NUL terminated
+  * @param: length of the name
+  * @return: code
+  */
+uint32_t dictionary_encode(Dictionary* dictionary, const char* name, uint32_t length);
+
+/**
+  * @brief: name of a code, safe to call while the writer encodes others
+  * @param: dictionary
+  * @param: code returned by dictionary_encode()
+  * @return: NUL terminated name, names never move so it's valid until
+  *          dictionary_close(), however many names are encoded meanwhile
+  */
+const char* dictionary_name(Dictionary* dictionary, uint32_t code);
+
+/**
+  * @brief: free the in memory copy, pages are left to the pager
+  * @param: dictionary to free
+  */
+void dictionary_close(Dictionary* dictionary);
+
+#endif
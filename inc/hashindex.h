@@ -0,0 +1,98 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pager.h"
+
+/* linear hash index from a company name to the sl_no of every row having it.
+ * Buckets are chains of pages holding the hash of the name and the key, a
+ * name with many rows fills a chain of its own. A bucket getting an overflow
+ * page splits the next bucket in turn, so the number of buckets grows with
+ * the rows and a lookup reads about one page plus those its rows fill. Rows
+ * are found by key, leaves move rows around when they split, keys don't.
+ * The page numbers of the buckets are kept in a chain of directory pages
+ * loaded whole into memory when the table is opened
+
+   directory page
+   attr        size     offset
+   next_page   4        0     0 on the last page
+   num_buckets 4        4     on the first page only
+   buckets     1022*4   8     page number of the first page of a bucket
+
+   bucket page
+   attr        size     offset
+   next_page   4        0     overflow page, 0 on the last one
+   num_entries 4        4
+   entries     511*8    8     hash of the name and the key
+   */
+
+#define HASH_INDEX_BUCKETS_PER_PAGE 1022
+#define HASH_INDEX_ENTRIES_PER_PAGE 511
+
+/**
+ * Structure of HashIndex
+ *
+ * bucket pages of the index and the directory pages they're written to
+ */
+typedef struct {
+	Pager* pager;
+	uint32_t first_page;
+	uint32_t* directory;  // n-th page of the directory chain
+	uint32_t num_directory_pages;
+	uint32_t* buckets;  // first page of every bucket
+	uint32_t num_buckets;
+	uint32_t buckets_capacity;
+} HashIndex;
+
+/**
+  * @brief: hash of a company name, what the index is looked up by
+  * @param: name, not NUL terminated
+  * @param: length of the name
+  * @return: hash
+  */
+uint32_t hashindex_hash(const char* name, uint32_t length);
+
+/**
+  * @brief: new index with one empty bucket
+  * @param: pager of the table
+  * @return: index, its first_page goes to the table header
+  */
+HashIndex* hashindex_create(Pager* pager);
+
+/**
+  * @brief: load an index written before
+  * @param: pager of the table
+  * @param: first page of the directory
+  * @return: index with the page of every bucket in memory
+  */
+HashIndex* hashindex_open(Pager* pager, uint32_t first_page);
+
+/**
+  * @brief: add the key of a row to the bucket of its name, a bucket running
+  *         out of room splits the next one in turn
+  * @param: index
+  * @param: hashindex_hash() of the row's company
+  * @param: sl_no of the row
+  */
+void hashindex_insert(HashIndex* index, uint32_t hash, uint32_t key);
+
+/**
+  * @brief: keys stored with a hash, rows of other names with the same hash
+  *         are among them
+  * @param: index
+  * @param: hashindex_hash() of the name looked up
+  * @param: set to a malloc'd array of the keys, in no order, for the caller
+  *         to free
+  * @return: number of keys
+  */
+uint32_t hashindex_find(HashIndex* index, uint32_t hash, uint32_t** keys);
+
+/**
+  * @brief: free the in memory copy, pages are left to the pager
+  * @param: index to free
+  */
+void hashindex_close(HashIndex* index);
+
+#endif
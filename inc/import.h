@@ -0,0 +1,35 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <stdint.h>
+
+#include "btree.h"
+
+#define IMPORT_CHUNK_SIZE (1024 * 1024)  // bytes read from the input file at a time
+#define IMPORT_MAX_ERRORS_SHOWN 10  // bad lines reported one by one, the rest are only counted
+
+/**
+ * Structure of ImportStats
+ *
+ * what happened to the lines of an imported file
+ */
+typedef struct {
+	uint64_t imported;
+	uint64_t duplicates;  // sl_no already in the table
+	uint64_t bad_lines;  // wrong number of fields, bad numbers or strings too long
+	double seconds;
+} ImportStats;
+
+/**
+  * @brief: bulk load rows from a CSV or tab separated file, fields in order
+  *         sl_no, year, company, model, power. Delimiter is picked from the
+  *         first line and a first line which doesn't start with a number is
+  *         taken as header. Committed once per chunk read, not once per row
+  * @param: table to load into
+  * @param: path of the file to import
+  * @param: filled with counts and time taken
+  * @return: 0 on success, -1 if the file couldn't be read
+  */
+int import_file(Table* table, const char* filename, ImportStats* stats);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef IORING_H
+#define IORING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* just enough of io_uring for the pager to have reads in flight while a
+ * scan works on pages already read, set up with the raw system calls so no
+ * library is needed. Reads are queued, handed to the kernel in one call,
+ * and their completions picked up in any order by the number they were
+ * queued with. Where io_uring isn't there (an old kernel, one without
+ * IORING_OP_READ, a sandbox, not Linux) ioring_open() says so and the pager
+ * falls back to fadvise */
+
+typedef struct IoRing IoRing;
+
+/**
+  * @brief: set up a ring
+  * @param: reads it can have queued or in flight at once
+  * @return: the ring, NULL if io_uring can't be used
+  */
+IoRing* ioring_open(uint32_t entries);
+
+/**
+  * @brief: number of reads the ring can have at once
+  * @param: ring
+  */
+uint32_t ioring_entries(const IoRing* ring);
+
+/**
+  * @brief: queue a read, it isn't started until ioring_submit()
+  * @param: ring
+  * @param: file to read
+  * @param: memory to read into
+  * @param: bytes to read
+  * @param: offset in file
+  * @param: handed back with its completion
+  * @return: false if the ring is full
+  */
+bool ioring_queue_read(IoRing* ring, int file_descriptor, void* buffer, uint32_t length,
+		off_t offset, uint64_t user_data);
+
+/**
+  * @brief: start every queued read
+  * @param: ring
+  */
+void ioring_submit(IoRing* ring);
+
+/**
+  * @brief: take a completed read
+  * @param: ring
+  * @param: wait for one if none has completed
+  * @param: set to the user_data it was queued with
+  * @param: set to bytes read, or -errno
+  * @return: false if none had completed and wait is false
+  */
+bool ioring_complete(IoRing* ring, bool wait, uint64_t* user_data, int32_t* result);
+
+/**
+  * @brief: tear the ring down, reads must have completed
+  * @param: ring
+  */
+void ioring_close(IoRing* ring);
+
+#endif
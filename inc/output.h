@@ -0,0 +1,129 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* result rows are formatted by hand into a buffer and handed to the stream a
+ * buffer at a time, instead of a printf() per row */
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/* how select prints rows */
+typedef enum {
+	OUTPUT_TABLE,  // (1, 2000, company, model, 1.500000), same as print_row()
+	OUTPUT_CSV,  // 1,2000,company,model,1.500000, fields quoted when needed
+	OUTPUT_TSV,  // tab separated, tab/newline/backslash escaped as \t \n \\ .
+	OUTPUT_BINARY  // serialized rows as stored, ROW_SIZE bytes each
+} OutputFormat;
+
+/* type of a value in a computed result row */
+typedef enum {
+	VALUE_NULL,  // like avg() of no rows
+	VALUE_INTEGER,
+	VALUE_REAL,
+	VALUE_TEXT
+} ValueType;
+
+/**
+ * Structure of Value
+ *
+ * one column of a computed result row, only the field for its type is used
+ */
+typedef struct {
+	ValueType type;
+	uint64_t integer;
+	double real;
+	const char* text;
+	size_t text_length;
+} Value;
+
+/* takes the rows of an output without a stream whenever its buffer fills,
+ * see output_open_sink() */
+typedef void (*OutputSink)(void* context, const char* data, size_t length);
+
+/**
+ * Structure of Output
+ *
+ * where results go, in which format, and the rows formatted so far
+ */
+typedef struct {
+	FILE* stream;  // NULL to keep everything in the buffer
+	OutputSink sink;  // without a stream, takes a full buffer instead of it growing
+	void* sink_context;
+	OutputFormat format;
+	char* buffer;
+	size_t length;
+	size_t capacity;
+} Output;
+
+/**
+  * @brief: create output writing to stream
+  * @param: stream, stdout usually, or NULL for an output whose buffer grows
+  *         to hold everything written to it, like a part of a parallel scan's
+  *         result before it's put in order
+  * @param: format rows are written in
+  * @return: output with an empty buffer
+  */
+Output* output_open(FILE* stream, OutputFormat format);
+
+/**
+  * @brief: create output handing its buffer to sink each time it fills, what
+  *         is left in the buffer at the end of a select is the caller's to
+  *         take, output_flush() leaves it be
+  * @param: called with every full buffer
+  * @param: passed on to sink
+  * @param: format rows are written in
+  * @return: output with an empty buffer
+  */
+Output* output_open_sink(OutputSink sink, void* context, OutputFormat format);
+
+/**
+  * @brief: parse format name as given to -o
+  * @param: "table", "csv", "tsv" or "binary"
+  * @param: set to the format if name is known
+  * @return: false if name isn't a format
+  */
+bool output_parse_format(const char* name, OutputFormat* format);
+
+/**
+  * @brief: format a serialized row into the buffer, buffer is handed to the
+  *         stream when full
+  * @param: output to write to
+  * @param: serialized row, as returned by cursor_value()
+  */
+void output_row(Output* output, void* row);
+
+/**
+  * @brief: format a computed row, like the result of an aggregate select. In
+  *         binary every value is 8 bytes, uint64 or double with NaN for null,
+  *         except text which is NUL padded to COMPANY_SIZE
+  * @param: output to write to
+  * @param: values of the row
+  * @param: number of values
+  */
+void output_values(Output* output, Value* values, uint32_t count);
+
+/**
+  * @brief: append what another output has buffered, already formatted
+  * @param: output to write to
+  * @param: output whose buffer is copied, left empty
+  */
+void output_append(Output* output, Output* other);
+
+/**
+  * @brief: hand buffered rows to the stream, done at the end of every select
+  *         so rows don't get behind messages printed after them
+  * @param: output to flush
+  */
+void output_flush(Output* output);
+
+/**
+  * @brief: flush and free output, stream is left open
+  * @param: output to close
+  */
+void output_close(Output* output);
+
+#endif
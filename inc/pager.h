@@ -0,0 +1,284 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "wal.h"
+#include "ioring.h"
+
+#define PAGER_MIN_FRAMES 16  // never go below this, a statement may pin a few pages at once
+#define PAGER_DEFAULT_POOL_SIZE (8 * 1024 * 1024)  // 8MB worth of page frames
+#define PAGER_DEFAULT_MMAP_SIZE ((size_t)64 * 1024 * 1024 * 1024)  // address space reserved for mmap backend
+#define PAGER_MMAP_GROW_PAGES 256  // file is grown at least this much at a time with mmap backend
+#define PAGER_HUGE_PAGE_SIZE (2 * 1024 * 1024)  // buffer pool is rounded up to this with huge pages
+#define PAGER_READ_AHEAD_DEPTH 64  // reads the pool can have in flight, at most a quarter of its frames
+
+extern const uint32_t PAGE_SIZE;
+
+/* how Pager gets pages of the file into memory */
+typedef enum {
+	PAGER_BACKEND_POOL,  // pread/pwrite into a buffer pool of frames
+	PAGER_BACKEND_MMAP  // file is memory mapped, pages are pointers into the mapping
+} PagerBackend;
+
+/* options to tune Pager at pager_open() */
+typedef struct {
+	PagerBackend backend;
+	size_t pool_size;  // memory budget for the page cache in bytes
+	size_t mmap_size;  // address space to reserve up front for the mapping
+	bool use_wal;  // write changed pages to a write-ahead log, db file only at checkpoint
+	WalSyncPolicy sync;  // when commits are fsync'd to the log
+	uint32_t checkpoint_frames;  // checkpoint once the log has this many frames
+	bool read_ahead;  // read pages a scan is about to get before it asks
+	bool direct_io;  // O_DIRECT on the db file with the pool backend, pages are cached once, in the pool
+	bool huge_pages;  // back the buffer pool with huge pages, or transparent ones if none are reserved
+} PagerOptions;
+
+/**
+ * Structure of a Frame
+ *
+ * one slot of the buffer pool, holds a page worth of memory and the
+ * bookkeeping needed to decide which page to evict
+ */
+typedef struct {
+	void* data;
+	uint32_t page_num;
+	uint32_t pin_count;  // pinned frames are never evicted
+	bool in_use;  // frame holds a page
+	bool referenced;  // CLOCK reference bit, set on every access
+	bool dirty;  // page changed since it was read, write back on eviction
+	bool loading;  // read ahead still in flight, pinned until it completes
+} Frame;
+
+/**
+ * Structure of PageVersion
+ *
+ * image of a page saved before the writer changed it, for snapshots which
+ * still read it as it was
+ */
+typedef struct PageVersion {
+	uint64_t epoch;  // the page as of this many commits
+	struct PageVersion* next;  // older version of the same page
+	uint8_t data[];
+} PageVersion;
+
+/**
+ * Structure of Snapshot
+ *
+ * a reader's view of the file, the pages as they were after epoch commits
+ */
+typedef struct Snapshot {
+	uint64_t epoch;
+	struct Snapshot* next;  // other open snapshots
+} Snapshot;
+
+/* Pager structure, to access the page cache and the file, Table's object will make requests for pages through the pager */
+typedef struct {
+	PagerBackend backend;
+	int file_descriptor;
+	uint64_t file_length;  // bytes, page numbers are 32 bit so files go well past 4GB
+	uint32_t num_pages;  // pages in file plus pages handed out since open
+	uint32_t file_pages;  // pages the file is currently sized to, those past it are read as zeroes
+	Wal* wal;  // NULL when running without write-ahead log
+	bool wal_uncommitted;  // frames went to the log since the last commit
+	uint32_t* dirty_list;  // pages which went from clean to dirty since last commit
+	uint32_t dirty_count;
+	uint32_t dirty_capacity;
+	pthread_mutex_t lock;  // held by pager_pin() and pager_unpin(), parallel scans share the pager
+
+	/* one writer and any number of readers, see pager_begin_write() */
+	pthread_rwlock_t latch;
+	uint64_t epoch;  // writes ended since open
+	Snapshot* snapshots;  // open snapshots, under lock
+	uint64_t newest_snapshot;  // epoch of the newest one
+	PageVersion** versions;  // page_num -> newest saved version, under lock
+	uint32_t versions_length;
+	uint32_t num_versions;
+
+	/* PAGER_BACKEND_POOL */
+	Frame* frames;  // the buffer pool
+	uint32_t num_frames;
+	void* arena;  // memory of every frame, PAGE_SIZE aligned for O_DIRECT
+	size_t arena_length;
+	bool direct_io;  // db file was opened with O_DIRECT
+	uint32_t clock_hand;
+	uint32_t* page_table;  // page_num -> index in frames, or FRAME_NONE
+	uint32_t page_table_length;
+	bool read_ahead;
+	IoRing* ring;  // reads ahead are in flight on, NULL to leave them to the OS with fadvise
+	uint32_t num_loading;  // frames with a read in flight
+
+	/* PAGER_BACKEND_MMAP */
+	void* map;  // private mapping of the file
+	size_t map_length;  // reserved length of the mapping, can be past end of file
+	bool* dirty_pages;  // page_num -> changed since last flush
+	uint32_t dirty_pages_length;
+	uint32_t pinned;  // pins taken, the mapping can't move while any are held
+} Pager;
+
+/**
+  * @brief: fill options with default values
+  * @param: options to initialize
+  */
+void pager_options_init(PagerOptions* options);
+
+/**
+  * @brief: opens the database file and keeps track of its size
+  * @param: filename to open/create
+  * @param: options to size the buffer pool, NULL for defaults
+  * @return: created Pager object
+  */
+Pager* pager_open(const char* filename, const PagerOptions* options);
+
+/**
+  * @brief: fetch the required page(reads from file on cache miss)
+  *         returned pointer is valid until the next get_page() call which may
+  *         evict it or move the mapping, use pager_pin() to hold on to a page
+  *         longer than that
+  * @param: instance of Pager
+  * @param: page_num to which get the page of
+  * @return: memory of the page in the buffer pool
+  */
+void* get_page(Pager* pager, uint32_t page_num);
+
+/**
+  * @brief: hand out a new page number at the end of the file
+  * @param: instance of Pager
+  * @return: page number of the new(zeroed) page
+  */
+uint32_t pager_allocate_page(Pager* pager);
+
+/**
+  * @brief: fetch the page and mark it dirty, use before modifying a page.
+  *         The first time in a write, its image is saved for open snapshots
+  * @param: instance of Pager
+  * @param: page_num to which get the page of
+  * @return: memory of the page in the buffer pool
+  */
+void* get_page_for_write(Pager* pager, uint32_t page_num);
+
+/**
+  * @brief: fetch the page and keep it from being evicted until pager_unpin(),
+  *         safe to call from several threads at once as long as none of them
+  *         uses the rest of the pager meanwhile
+  * @param: instance of Pager
+  * @param: page_num to pin
+  * @return: memory of the page in the buffer pool
+  */
+void* pager_pin(Pager* pager, uint32_t page_num);
+
+/**
+  * @brief: release a pin taken by pager_pin()
+  * @param: instance of Pager
+  * @param: page_num to unpin
+  */
+void pager_unpin(Pager* pager, uint32_t page_num);
+
+/**
+  * @brief: start reading pages which are about to be fetched, without
+  *         waiting for them. A page is found in the pool (or the OS cache)
+  *         when it's fetched, or waited for there if its read is still in
+  *         flight. Pages already in the pool or the log are skipped. Called
+  *         by readers the way pager_snapshot_read() is
+  * @param: instance of Pager
+  * @param: pages in the order they'll be fetched
+  * @param: number of pages
+  */
+void pager_read_ahead(Pager* pager, const uint32_t* page_nums, uint32_t count);
+
+/**
+  * @brief: start a statement changing the file, waiting for readers settling
+  *         a snapshot or copying a page. Only one thread writes. The latch
+  *         is held until pager_end_write(), and it prefers the writer, so a
+  *         reader asking for its next page waits out the whole write: one
+  *         statement, or one chunk of an import
+  * @param: instance of Pager
+  */
+void pager_begin_write(Pager* pager);
+
+/**
+  * @brief: end a statement started with pager_begin_write(), after it's
+  *         committed. Snapshots opened from here on see what it changed
+  * @param: instance of Pager
+  */
+void pager_end_write(Pager* pager);
+
+/**
+  * @brief: keep the writer out while a reader looks at the tree and what's
+  *         kept in memory along with it, so the two agree
+  * @param: instance of Pager
+  */
+void pager_begin_read(Pager* pager);
+
+/**
+  * @brief: let the writer back in
+  * @param: instance of Pager
+  */
+void pager_end_read(Pager* pager);
+
+/**
+  * @brief: take a snapshot of the file as it is, the caller is between
+  *         pager_begin_read() and pager_end_read()
+  * @param: instance of Pager
+  * @return: snapshot to read pages through until pager_snapshot_close()
+  */
+Snapshot* pager_snapshot_open(Pager* pager);
+
+/**
+  * @brief: copy a page as it was when snapshot was taken, safe to call from
+  *         several threads while another writes
+  * @param: instance of Pager
+  * @param: open snapshot
+  * @param: page_num to read
+  * @param: PAGE_SIZE bytes to copy it to
+  */
+void pager_snapshot_read(Pager* pager, const Snapshot* snapshot, uint32_t page_num,
+		void* buffer);
+
+/**
+  * @brief: done with a snapshot, versions no open snapshot reads are freed
+  * @param: instance of Pager
+  * @param: snapshot from pager_snapshot_open()
+  */
+void pager_snapshot_close(Pager* pager, Snapshot* snapshot);
+
+/**
+  * @brief: writes to file(disk) from the buffer pool
+  * @param: Pager instance where the data is loaded and currently stored
+  * @param: page_num from which to write to file
+  */
+void pager_flush(Pager* pager, uint32_t page_num);
+
+/**
+  * @brief: end of a transaction, every dirty page is appended to the log
+  *         and the last frame marks the commit, then the log is synced
+  *         according to the sync policy and checkpointed if it's grown big.
+  *         Does nothing without a log, pages are written back on eviction
+  *         and close as before
+  * @param: Pager instance
+  */
+void pager_commit(Pager* pager);
+
+/**
+  * @brief: copy the latest version of every page in the log into the
+  *         database file, sync it and empty the log
+  * @param: Pager instance, everything must be committed
+  */
+void pager_checkpoint(Pager* pager);
+
+/**
+  * @brief: write back every dirty page in the pool
+  * @param: Pager instance
+  */
+void pager_flush_all(Pager* pager);
+
+/**
+  * @brief: write back every dirty page, close the file and free the pool
+  * @param: Pager instance
+  */
+void pager_close(Pager* pager);
+
+#endif
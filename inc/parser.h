@@ -0,0 +1,88 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* statements are split into tokens and parsed by recursive descent into a
+ * Statement, see prepare_statement(). The grammar
+
+   statement   := insert | select
+   insert      := "insert" value value value value value
+   select      := "select" [item {[","] item}] ["where" condition {"and" condition}]
+                  ["group" "by" "company"] ["limit" number]
+   item        := "company" | function "(" ("*" | column) ")"
+   condition   := column (compare value | "between" value "and" value)
+   compare     := "=" | "!=" | "<" | "<=" | ">" | ">="
+   value       := word | 'quoted string' | "?"
+   */
+
+#define TOKEN_MAX_LENGTH 128  // longest value a statement can hold, a model name
+
+typedef enum {
+	TOKEN_WORD,  // keyword, name or number, told apart by the parser
+	TOKEN_STRING,  // 'quoted', may hold spaces and symbols
+	TOKEN_SYMBOL,  // ( ) , * ? = != < <= > >=
+	TOKEN_END,
+	TOKEN_INVALID  // unterminated string or stray character
+} TokenType;
+
+/**
+ * Structure of Token
+ *
+ * where a token is in the input, quotes of a string left out
+ */
+typedef struct {
+	TokenType type;
+	const char* start;
+	uint32_t length;
+} Token;
+
+/**
+ * Structure of Tokenizer
+ *
+ * input being split and the token the parser is looking at, one token of
+ * lookahead is all the grammar needs
+ */
+typedef struct {
+	const char* position;
+	Token current;
+} Tokenizer;
+
+/**
+  * @brief: start splitting input, the first token is read right away
+  * @param: tokenizer to set up
+  * @param: NUL terminated statement, must outlive the tokenizer
+  */
+void tokenizer_init(Tokenizer* tokenizer, const char* input);
+
+/**
+  * @brief: move on to the next token
+  * @param: tokenizer
+  */
+void tokenizer_advance(Tokenizer* tokenizer);
+
+/**
+  * @brief: whether a token is a word or symbol spelled text
+  * @param: token
+  * @param: NUL terminated spelling
+  */
+bool token_is(const Token* token, const char* text);
+
+/**
+  * @brief: parse a whole token as unsigned number, fails on trailing garbage
+  * @param: NUL terminated token
+  * @param: set to the number
+  * @return: whether token is one
+  */
+bool parse_uint32(const char* token, uint32_t* value);
+
+/**
+  * @brief: parse a whole token as double, fails on trailing garbage
+  * @param: NUL terminated token
+  * @param: set to the number
+  * @return: whether token is one
+  */
+bool parse_double(const char* token, double* value);
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef PREPARED_H
+#define PREPARED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spdbutil.h"
+
+/* statements parsed once and run many times. A ? in place of a value of
+ * an insert or a condition of a select is bound before every run:
+
+   statement_prepare(&prepared, "insert ? ? ? ? ?")
+   statement_bind_uint32(&prepared, 1, 7) ... statement_bind_double(&prepared, 5, 119.3)
+   statement_step(table, &prepared, output)
+   statement_reset(&prepared), and bind the next row
+
+ * parameters are numbered from 1 in the order they're written. A cache of
+ * prepared statements keyed by their text lets the REPL skip parsing lines
+ * it has seen before */
+
+#define STATEMENT_CACHE_SIZE 64  // statements kept by the REPL
+
+/**
+ * Structure of PreparedStatement
+ *
+ * the statement as parsed, and a copy of it with the bound values put in
+ * which is what runs
+ */
+typedef struct {
+	Statement parsed;
+	Statement statement;
+	ParameterValue values[MAX_PARAMETERS];
+	bool bound[MAX_PARAMETERS];
+} PreparedStatement;
+
+/**
+ * Structure of StatementCacheEntry
+ *
+ * a prepared statement, its text and when it was last used
+ */
+typedef struct {
+	char* text;  // NULL if the entry is free
+	uint32_t hash;
+	uint64_t last_used;
+	PreparedStatement* prepared;
+} StatementCacheEntry;
+
+/**
+ * Structure of StatementCache
+ *
+ * prepared statements of a session, the least recently used one is
+ * dropped for a new one once every entry is taken
+ */
+typedef struct {
+	StatementCacheEntry* entries;
+	uint32_t num_entries;
+	uint64_t clock;  // bumped on every lookup
+	PreparedStatement* spare;  // a miss is parsed into, swapped with the entry it replaces
+} StatementCache;
+
+/**
+  * @brief: parse a statement to run later
+  * @param: prepared statement to set up
+  * @param: NUL terminated statement, ? for the values bound later
+  * @return: status code for statement preparation
+  */
+PrepareResult statement_prepare(PreparedStatement* prepared, const char* text);
+
+/**
+  * @brief: bind a number to a ? of sl_no, year or power
+  * @param: prepared statement
+  * @param: parameter, from 1
+  * @param: value
+  * @return: PREPARE_SYNTAX_ERROR if there's no such ? or it's of a string
+  */
+PrepareResult statement_bind_uint32(PreparedStatement* prepared, uint32_t index, uint32_t value);
+
+/**
+  * @brief: bind a number to a ? of power
+  * @param: prepared statement
+  * @param: parameter, from 1
+  * @param: value
+  * @return: PREPARE_SYNTAX_ERROR if there's no such ? or it's not of power
+  */
+PrepareResult statement_bind_double(PreparedStatement* prepared, uint32_t index, double value);
+
+/**
+  * @brief: bind text to a ?, a ? of a number has it parsed
+  * @param: prepared statement
+  * @param: parameter, from 1
+  * @param: NUL terminated value
+  * @return: PREPARE_STRING_TOO_LONG if it doesn't fit the column,
+  *          PREPARE_SYNTAX_ERROR if there's no such ? or it's not a number
+  *          where one is needed
+  */
+PrepareResult statement_bind_text(PreparedStatement* prepared, uint32_t index, const char* value);
+
+/**
+  * @brief: put the values bound into prepared->statement without running it
+  * @param: prepared statement
+  * @return: EXECUTE_UNBOUND_PARAMETER if a ? has no value
+  */
+ExecuteResult statement_apply(PreparedStatement* prepared);
+
+/**
+  * @brief: run a prepared statement with the values bound to it
+  * @param: table to run it on
+  * @param: prepared statement
+  * @param: output a select writes its rows to
+  * @return: EXECUTE_UNBOUND_PARAMETER if a ? has no value, otherwise what
+  *          execute_statement() returns
+  */
+ExecuteResult statement_step(Table* table, PreparedStatement* prepared, Output* output);
+
+/**
+  * @brief: forget the values bound, to bind those of the next run
+  * @param: prepared statement
+  */
+void statement_reset(PreparedStatement* prepared);
+
+/**
+  * @brief: empty cache
+  * @param: number of statements it keeps
+  * @return: cache
+  */
+StatementCache* statement_cache_open(uint32_t num_entries);
+
+/**
+  * @brief: prepared statement for text, parsed only if it's not in the cache
+  * @param: cache
+  * @param: NUL terminated statement
+  * @param: set to the status of preparing it, PREPARE_SUCCESS for a cached one
+  * @return: prepared statement with no values bound, valid until the next
+  *          lookup, NULL if it doesn't parse
+  */
+PreparedStatement* statement_cache_prepare(StatementCache* cache, const char* text,
+		PrepareResult* result);
+
+/**
+  * @brief: free the cache and its statements
+  * @param: cache
+  */
+void statement_cache_close(StatementCache* cache);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "btree.h"
+
+/* scan of a key range cut into tasks of a few consecutive leaves each, run
+ * on the table's thread pool when the range is big enough to be worth it and
+ * on the calling thread otherwise. Leaves are listed up front by walking only
+ * the internal nodes, leaving out those whose zone map entry can't match, and
+ * a task copies each leaf as of the scan's snapshot before looking at it. So
+ * a scan sees the table as it was when it was opened while inserts go on.
+ * The leaf list is known up front, so a task has the pager start reading the
+ * leaves of the next task before it works through its own */
+
+#define SCAN_TASK_LEAVES 16  // leaves one task scans
+#define SCAN_READ_AHEAD_LEAVES (2 * SCAN_TASK_LEAVES)  // leaves read ahead from the start of a task
+#define SCAN_MIN_PARALLEL_LEAVES 64  // smaller ranges are scanned on the calling thread
+#define SCAN_BATCH_TASKS 256  // tasks run before their results are merged, bounds memory held
+
+/* called for every leaf of a task with the cells [start, end) in the key range */
+typedef void (*LeafFunction)(void* context, uint32_t task, void* node, uint32_t start, uint32_t end);
+
+/**
+ * Structure of Scan
+ *
+ * leaves of a key range in key order and how they're split into tasks
+ */
+typedef struct {
+	Table* table;
+	uint32_t low;
+	uint32_t high;
+	ZoneFilter filter;  // NULL to take every leaf in range
+	void* filter_context;
+	uint32_t* leaves;
+	uint32_t num_leaves;
+	uint32_t leaves_capacity;
+	uint32_t num_tasks;
+	bool parallel;  // tasks go to the thread pool and may run at once
+	Snapshot* snapshot;  // leaves are read as of this
+
+	/* run in progress */
+	uint32_t first_task;
+	LeafFunction function;
+	void* context;
+} Scan;
+
+/**
+  * @brief: list the leaves holding keys in [low, high] and take the snapshot
+  *         they're read at, the caller holds the pager's read latch
+  * @param: scan to fill
+  * @param: table to scan
+  * @param: smallest key wanted
+  * @param: largest key wanted
+  * @param: tells from a leaf's zone map entry whether to scan it, NULL for all
+  * @param: passed on to filter
+  */
+void scan_open(Scan* scan, Table* table, uint32_t low, uint32_t high, ZoneFilter filter,
+		void* filter_context);
+
+/**
+  * @brief: run tasks [first_task, first_task + num_tasks), function gets task
+  *         numbers relative to first_task. Returns once all of them are done
+  * @param: planned scan
+  * @param: first task to run
+  * @param: number of tasks to run
+  * @param: called for every leaf
+  * @param: passed on to function
+  */
+void scan_run(Scan* scan, uint32_t first_task, uint32_t num_tasks, LeafFunction function,
+		void* context);
+
+/**
+  * @brief: cells of a leaf of the scan whose keys are in its range, for
+  *         callers walking scan->leaves themselves
+  * @param: planned scan
+  * @param: leaf node, one of scan->leaves
+  * @param: set to the first cell in range
+  * @param: set to one past the last cell in range, start if there's none
+  */
+void scan_leaf_cells(Scan* scan, void* node, uint32_t* start, uint32_t* end);
+
+/**
+  * @brief: have the pager start reading SCAN_READ_AHEAD_LEAVES leaves from
+  *         first on, for callers walking scan->leaves themselves
+  * @param: planned scan
+  * @param: position in scan->leaves of the next leaf to be read
+  */
+void scan_read_ahead(Scan* scan, uint32_t first);
+
+/**
+  * @brief: free the leaf list and close the snapshot
+  * @param: scan to free
+  */
+void scan_close(Scan* scan);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "spdbutil.h"
+#include "prepared.h"
+
+/* spdb serving clients over a Unix domain socket, and TCP on localhost if
+ * asked. One thread waits on every connection with epoll and runs their
+ * statements one at a time against the same table, so clients share its
+ * page cache and statement cache instead of each opening the file.
+
+ * every message is a frame, a header and a body of the length it gives
+
+   header      := length(uint32) kind(uint8)
+   request     := header(REQUEST_STATEMENT) count(uint8) {size(uint16) value}
+                  statement
+   response    := {header(RESPONSE_MORE) rows} header(RESPONSE_OK) rows
+                  | {header(RESPONSE_MORE) rows} header(RESPONSE_ERROR) message
+
+ * the values are bound to the ? of the statement in order, the statement
+ * takes the rest of the body and isn't NUL terminated. Rows are in the
+ * format the server was started with (-o), a result too big for one buffer
+ * comes in parts as it's produced and ends with the last part in
+ * RESPONSE_OK, the bodies joined are the rows. Parts before an error are to
+ * be dropped. Numbers are in host byte order,
+ * client and server are on the same machine. A client may send any number
+ * of requests before reading, responses come back in the order of the
+ * requests */
+
+#define PROTOCOL_HEADER_SIZE 5
+#define SERVER_MAX_REQUEST (64 * 1024)  // longest body a request may have
+#define SERVER_MAX_PENDING (4 * 1024 * 1024)  // responses a slow reader may fall behind by
+
+/* kind of a frame */
+typedef enum {
+	REQUEST_STATEMENT,
+	RESPONSE_OK,
+	RESPONSE_ERROR,
+	RESPONSE_MORE  // part of a result, more of it follows
+} FrameKind;
+
+/**
+  * @brief: serve clients until SIGINT or SIGTERM, the table stays open
+  * @param: table statements run on
+  * @param: format rows are sent in
+  * @param: path of the Unix domain socket, replaced if it exists
+  * @param: TCP port to also listen on at 127.0.0.1, 0 for none
+  */
+void server_run(Table* table, OutputFormat format, const char* socket_path, uint16_t port);
+
+/**
+  * @brief: frame a request
+  * @param: buffer to write it to
+  * @param: bytes the buffer has
+  * @param: NUL terminated statement
+  * @param: NUL terminated values for its ?
+  * @param: number of values, at most MAX_PARAMETERS
+  * @return: size of the frame, 0 if it doesn't fit buffer or is too long
+  */
+size_t protocol_encode_request(char* buffer, size_t capacity, const char* statement,
+		const char** values, uint32_t num_values);
+
+/**
+  * @brief: read a frame header
+  * @param: start of the frame
+  * @param: set to the length of the body
+  * @param: set to the kind of the frame
+  */
+void protocol_decode_header(const char* buffer, uint32_t* length, uint8_t* kind);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SPDB_H
+#define SPDB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spdbutil.h"
+#include "prepared.h"
+
+/* what a program linking libspdb includes. A table is opened with db_open()
+ * and closed with db_close(), statements are prepared and bound as in
+ * prepared.h, and the rows of a select are pulled one at a time:
+
+   statement_prepare(&prepared, "select where year >= ?")
+   statement_bind_uint32(&prepared, 1, 2015)
+   query_open(&query, table, &prepared)
+   while (query_next(&query)) {
+       query_sl_no(&query), query_company(&query) ...
+   }
+   query_close(&query)
+
+ * a leaf is copied out of the pager whole and rows are read in place in
+ * the copy, nothing is copied per row. Closing a query before the last row
+ * stops the scan there, no more leaves are read.
+
+ * one thread may insert while any number of others read. A query sees the
+ * table as it was when it was opened, the inserter never waits for it */
+
+/**
+ * Structure of QueryCursor
+ *
+ * a select being read row by row, the leaves of its scan are walked in key
+ * order and the one holding the current row is kept as of the snapshot
+ */
+typedef struct {
+	Statement* statement;
+	Dictionary* dictionary;
+	Scan scan;
+	void* page;  // copy of the leaf being read
+	uint32_t leaf;  // position in scan.leaves of node
+	void* node;  // page once it holds the current row's leaf, NULL before the first and after the last
+	uint32_t cell_num;
+	uint32_t end;  // one past the last cell of node in the key range
+	uint32_t remaining;  // rows left to the limit of the select
+} QueryCursor;
+
+/**
+  * @brief: start reading the rows of a prepared select, before the first row
+  * @param: cursor to set up
+  * @param: table to read
+  * @param: prepared select of rows, with every ? bound. It's read by the
+  *         cursor and must outlive it
+  * @return: EXECUTE_UNBOUND_PARAMETER if a ? has no value,
+  *          EXECUTE_NOT_A_QUERY for an insert or a select of aggregates
+  */
+ExecuteResult query_open(QueryCursor* query, Table* table, PreparedStatement* prepared);
+
+/**
+  * @brief: move to the next row the select matches
+  * @param: cursor
+  * @return: false once there are no more, or the select's limit is reached
+  */
+bool query_next(QueryCursor* query);
+
+/**
+  * @brief: columns of the current row, the strings point into the copy of
+  *         its leaf (or the dictionary) and are valid until query_next()
+  * @param: cursor on a row
+  */
+uint32_t query_sl_no(const QueryCursor* query);
+uint32_t query_year(const QueryCursor* query);
+const char* query_company(const QueryCursor* query);
+const char* query_model(const QueryCursor* query);
+double query_power(const QueryCursor* query);
+
+/**
+  * @brief: stop reading, may be called before the last row
+  * @param: cursor
+  */
+void query_close(QueryCursor* query);
+
+#endif
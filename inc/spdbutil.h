@@ -11,14 +11,22 @@
 #include <sys/stat.h>
 #include <errno.h>
 
+#include "pager.h"
+#include "btree.h"
+#include "import.h"
+#include "output.h"
+#include "aggregate.h"
+#include "scan.h"
+#include "parser.h"
+#include "vm.h"
+#include "stats.h"
+
 #define COLUMN_COMPANY_NAME 32  // byte size to store company name
 #define COLUMN_MODEL_NAME 128 // byte size to store model name
 
 // get the size of attribute for provided struct
 #define size_of_attribute(Struct, Attribute) sizeof(((Struct*)0)->Attribute)
 
-#define TABLE_MAX_PAGES 100  // arbitrary
-
 /* struct for InputBuffer */
 // small wrapper to interact with getline()
 typedef struct {
@@ -44,7 +52,10 @@ typedef enum {
 /* different exit status */
 typedef enum {
 	EXECUTE_SUCCESS,
-	EXECUTE_TABLE_FULL
+	EXECUTE_DUPLICATE_KEY,
+	EXECUTE_TABLE_FULL,
+	EXECUTE_UNBOUND_PARAMETER,
+	EXECUTE_NOT_A_QUERY  // a cursor was opened on something other than a select of rows
 } ExecuteResult;
 
 // currently our prepared statement just have only two possible values
@@ -64,14 +75,108 @@ typedef struct {
 	double power;
 } Row;
 
+/**
+ * Structure of KeyRange
+ *
+ * inclusive range of sl_no a select looks at, whole table if no where clause
+ */
+typedef struct {
+	uint32_t low;
+	uint32_t high;
+} KeyRange;
+
+#define MAX_PREDICATES 8  // conditions a where clause can have, joined by and
+#define SELECT_NO_LIMIT UINT32_MAX  // limit of a select without a limit clause
+#define COMPANY_INDEX_MAX_SHARE 16  // company = X scans instead once 1/16th of rows have X
+
+/* columns a where clause can test */
+typedef enum {
+	COLUMN_SLNO,
+	COLUMN_YEAR,
+	COLUMN_COMPANY,
+	COLUMN_POWER
+} Column;
+
+/* comparison of a column against a value */
+typedef enum {
+	COMPARE_EQUAL,
+	COMPARE_NOT_EQUAL,
+	COMPARE_LESS,
+	COMPARE_LESS_EQUAL,
+	COMPARE_GREATER,
+	COMPARE_GREATER_EQUAL
+} CompareOp;
+
+/**
+ * Structure of Predicate
+ *
+ * one condition of a where clause, only the value field for the column's type
+ * is used. Tested against the serialized row so non matching rows are never
+ * copied out of the page
+ */
+typedef struct {
+	Column column;
+	CompareOp op;
+	uint32_t number;  // sl_no, year
+	double real;  // power
+	char text[COLUMN_COMPANY_NAME + 1];  // company
+	uint32_t text_length;
+} Predicate;
+
+#define MAX_AGGREGATES 8  // columns an aggregate select can have
+
+/* what an aggregate select computes for a column */
+typedef enum {
+	AGGREGATE_COUNT,
+	AGGREGATE_SUM,
+	AGGREGATE_AVG,
+	AGGREGATE_MIN,
+	AGGREGATE_MAX,
+	AGGREGATE_GROUP  // the company a group by row is for
+} AggregateFunc;
+
+/* one column of an aggregate select, like avg(power) */
+typedef struct {
+	AggregateFunc func;
+	Column column;  // not used by count(*)
+} Aggregate;
+
+#define MAX_PARAMETERS 16  // ? placeholders a statement can have
+
+/* where the value bound to a ? goes */
+typedef struct {
+	bool condition;  // of a where clause, otherwise a value of the inserted row
+	uint32_t field;  // of an insert, sl_no, year, company, model, power in that order
+	Column column;  // of a condition
+	CompareOp op;
+} Parameter;
+
+/* value bound to a ?, in the member its column uses */
+typedef struct {
+	uint32_t number;  // sl_no, year
+	double real;  // power
+	char text[COLUMN_MODEL_NAME + 1];  // company, model
+} ParameterValue;
+
 /**
  * Structure for Statement
  *
- * have StatementType and Row
+ * have StatementType and Row, or the range of keys to select and the
+ * conditions rows in that range must meet
  */
 typedef struct {
 	StatementType type;
 	Row row_to_insert;
+	KeyRange key_range;  // conditions on sl_no end up here, except !=
+	Predicate predicates[MAX_PREDICATES];
+	uint32_t num_predicates;
+	Aggregate aggregates[MAX_AGGREGATES];  // none for a select returning rows
+	uint32_t num_aggregates;
+	bool group_by_company;
+	uint32_t limit;  // most rows the select returns, SELECT_NO_LIMIT for all
+	Program filter;  // predicates compiled by compile_filter() when the select runs
+	Parameter parameters[MAX_PARAMETERS];  // ? left out of the rest until bound
+	uint32_t num_parameters;
 } Statement;
 
 /**
@@ -91,11 +196,13 @@ void print_prompt();
 /**
  * @brief: read input to created input buffer
  * @param: created input buffer
+ * @param: stream to read a line from, stdin or a script given to .read
+ * @return: false at end of stream
  */
-void read_input(InputBuffer* input_buffer);
+bool read_input(InputBuffer* input_buffer, FILE* stream);
 
 /**
- * @brief: Prepare Statement
+ * @brief: Prepare Statement, tokenize and parse the input
  * @param: created input buffer to take input,
  * @param: created statement to store data and query type from input buffer to itself
  *         and other data inside row in statement
@@ -103,6 +210,23 @@ void read_input(InputBuffer* input_buffer);
  */
 PrepareResult prepare_statement(InputBuffer* input_buffer, Statement *statement);
 
+/**
+ * @brief: tokenize and parse a statement
+ * @param: NUL terminated statement
+ * @param: statement to fill in, a ? is recorded in its parameters
+ * @return: status code for statement preparation
+ */
+PrepareResult parse_statement(const char* input, Statement* statement);
+
+/**
+ * @brief: put the value bound to a ? where it goes in statement, a condition
+ *         is added like one written in the where clause
+ * @param: statement the parameter is from
+ * @param: parameter
+ * @param: value bound to it, checked by the binding already
+ */
+void apply_parameter(Statement* statement, const Parameter* parameter, const ParameterValue* value);
+
 
 
 extern const uint32_t SLNO_SIZE;
@@ -133,75 +257,68 @@ void serialize_row(Row* source, void* destination);
 void deserialize_row(void* source, Row* destination);
 
 
-extern const uint32_t PAGE_SIZE;
-extern const uint32_t ROWS_PER_PAGE;
-extern const uint32_t TABLE_MAX_ROWS;
-
-/* Pager structure, to access the page cache and the file, Table's object will make requests for pages through the pager */
-typedef struct {
-	int file_descriptor;
-	uint32_t file_length;
-	void* pages[TABLE_MAX_PAGES];
-} Pager;
-
-/* Table structure that points to pages and keeps track of how many rows are there */
-typedef struct {
-	uint32_t num_rows;
-	Pager* pager;  // making request for page from Pager
-} Table;
-
-/**
-  * @brief: create page, if not exists and/or provide the offset slot of row in which to store data
-  * @param: created table in which to find page to put row or to create new page
-  * @param: row number w.r.t. table to find page number and if that page exists with page number
-  * @return: location in page in table to store row in the page
-  */
-void* row_slot(Table* table, uint32_t row_num);
-
 /**
   * @brief: execution of insert statement(query),
   * @param: created table in which to store data provided by user from insert query
   * @param: statement created from the query from input buffer provided by user
-  * @return: execution status for whether the table is full not
+  * @return: execution status for whether the key already exists
   */
 ExecuteResult execute_insert(Table* table, Statement* statement);
 
 /**
   * @brief: execution of select statement(query),
   * @param: created table in which to store data provided by user from insert query
-  * @return: execution status for whether the table is full not
+  * @param: statement with the range of keys to show
+  * @param: output rows are written to
+  * @return: execution status
+  */
+ExecuteResult execute_select(Table* table, Statement* statement, Output* output);
+
+/**
+  * @brief: execution of an aggregate select, like count(*), avg(power),
+  *         optionally grouped by company
+  * @param: table to aggregate over
+  * @param: statement with the aggregates, key range and predicates
+  * @param: scan of its key range, opened by execute_select()
+  * @param: output the result rows are written to
+  * @return: execution status
+  */
+ExecuteResult execute_aggregate(Table* table, Statement* statement, Scan* scan, Output* output);
+
+/**
+  * @brief: compile the predicates of a select into its filter, run on every
+  *         row the select scans by vm_run()
+  * @param: select statement
+  * @param: table the select runs on, for the codes of a dictionary table
   */
-ExecuteResult execute_select(Table* table);
+void compile_filter(Statement* statement, Table* table);
+
+/**
+  * @brief: whether a leaf may have rows meeting every predicate of a select,
+  *         a ZoneFilter for its scan
+  * @param: select statement
+  * @param: zone map entry of the leaf
+  */
+bool zone_matches(void* context, const ZoneEntry* zone);
 
 /**
   * @brief: see type of query from provied statement and execute it and provide table
   *         on/from to perform action
   * @param: created table to/from which to perform action
   * @param: created statement from which to store data in table
+  * @param: output select writes its rows to
   * @return: execute status, return from the respective functions of performed operations
   */
-ExecuteResult execute_statement(Table *table, Statement* statement);
+ExecuteResult execute_statement(Table *table, Statement* statement, Output* output);
 
 /**
   * @brief: creates new table checking with already stored database file
+  * @param: filename of database file
+  * @param: options for the pager, NULL for defaults
+  * @param: layout of the leaves if the file is new
   * @return: newly created database
   */
-Table* db_open();
-
-/**
-  * @brief: opens the database file and keeps track of its size
-  * @param: filename to open/create
-  * @return: created Pager object
-  */
-Pager* pager_open(const char* filename);
-
-/**
-  * @brief: fetch the required page(reads from file)
-  * @param: instance of Pager
-  * @param: page_num to which get the page of
-  * @return: page as of Pager->pages[page_num]
-  */
-void* get_page(Pager* pager, uint32_t page_num);
+Table* db_open(const char* filename, const PagerOptions* options, LeafLayout layout);
 
 /**
   * @brief: calls function to flush the page cache to disk
@@ -209,14 +326,6 @@ void* get_page(Pager* pager, uint32_t page_num);
   */
 void db_close(Table* table);
 
-/**
-  * @brief: writes to file(disk) from Pager data structure
-  * @param: Pager instance where the data is loaded and currently stored
-  * @param: page_num from which to write to file
-  * @param: size of a full or partial page
-  */
-void pager_flush(Pager* pager, uint32_t page_num, uint32_t size);
-
 /**
  * @brief: handle Meta Commands (the one starting with dots(.))
  * @param: created input buffer
@@ -236,4 +345,12 @@ void print_row(Row* row);
   * @param: created input buffer to take input
   */
 void close_input_buffer(InputBuffer* input_buffer);
+
+/**
+  * @brief: order two uint32_t(keys, page numbers) for qsort()
+  * @param: pointer to the first
+  * @param: pointer to the second
+  * @return: negative, zero or positive as the first is smaller, equal or larger
+  */
+int compare_uint32(const void* a, const void* b);
 #endif
@@ -0,0 +1,91 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* counters of what the engine has done since it started, cheap enough to be
+ * always on. Every thread counts into its own block, found through a thread
+ * local pointer, so counting is a plain add with no lock and no shared cache
+ * line. Reading them adds up the blocks of every thread, including those of
+ * threads which have exited. Statement latencies are kept as histograms of
+ * power of two buckets of microseconds */
+
+#define STATS_LATENCY_BUCKETS 24  // bucket 0 is under 1us, bucket b is [2^(b-1), 2^b)us, the last one anything longer
+
+/* what is counted */
+typedef enum {
+	STAT_PAGE_HITS,  // get_page() of a page in the pool, or of the mapping
+	STAT_PAGE_MISSES,  // get_page() which had to read the page in
+	STAT_READ_AHEAD,  // pages read into the pool before they were asked for
+	STAT_BYTES_READ,  // from the db file and the log
+	STAT_BYTES_WRITTEN,  // to the db file and the log
+	STAT_READ_CALLS,
+	STAT_WRITE_CALLS,
+	STAT_SYNC_CALLS,
+	STAT_ROWS_SCANNED,  // rows in the key range of a scan, or looked up by index
+	STAT_ROWS_RETURNED,  // rows which met the conditions
+	STAT_NUM_COUNTERS
+} StatCounter;
+
+/* kinds of statement whose latency is kept */
+typedef enum {
+	STAT_INSERT,
+	STAT_SELECT,
+	STAT_AGGREGATE,  // select of aggregates
+	STAT_NUM_STATEMENTS
+} StatStatement;
+
+/**
+ * Structure of Stats
+ *
+ * counters of one thread, or the totals of all of them
+ */
+typedef struct Stats {
+	uint64_t counters[STAT_NUM_COUNTERS];
+	uint64_t latencies[STAT_NUM_STATEMENTS][STATS_LATENCY_BUCKETS];
+	struct Stats* next;  // block of another thread
+} Stats;
+
+/**
+  * @brief: count amount more of counter, on the calling thread's block
+  * @param: what to count
+  * @param: how many
+  */
+void stats_add(StatCounter counter, uint64_t amount);
+
+/**
+  * @brief: time to take the latency of a statement from
+  * @return: monotonic clock in nanoseconds
+  */
+uint64_t stats_clock(void);
+
+/**
+  * @brief: count a statement which started at start
+  * @param: kind of statement
+  * @param: stats_clock() when it started
+  */
+void stats_record_latency(StatStatement statement, uint64_t start);
+
+/**
+  * @brief: add up the counters of every thread, less those at the last
+  *         stats_reset()
+  * @param: set to the totals
+  */
+void stats_collect(Stats* totals);
+
+/**
+  * @brief: count from zero again, threads go on counting undisturbed
+  */
+void stats_reset(void);
+
+/**
+  * @brief: print the totals
+  * @param: stream to print to
+  * @param: one "name value" pair per line, tab separated, instead of a
+  *         summary for people
+  */
+void stats_print(FILE* stream, bool machine);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* fixed set of worker threads running numbered tasks. Every worker starts on
+ * its own contiguous share of the task numbers and takes them in order, one
+ * that runs out steals the back half of another's share, so tasks that take
+ * longer than others don't leave the rest of the workers idle */
+
+typedef void (*TaskFunction)(void* context, uint32_t task);
+
+/**
+ * Structure of TaskRange
+ *
+ * task numbers [next, end) a worker has left, owner takes from next and
+ * thieves take from end
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	uint32_t next;
+	uint32_t end;
+} TaskRange;
+
+/**
+ * Structure of ThreadPool
+ *
+ * workers and the run they're on, the thread calling threadpool_run() works
+ * along with them as the last worker
+ */
+typedef struct {
+	pthread_t* threads;
+	uint32_t num_threads;  // threads started, not counting the caller
+	TaskRange* ranges;  // one per thread and one for the caller
+	pthread_mutex_t run_lock;  // one run at a time, when several threads run selects
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	uint64_t run;  // bumped to start a run
+	uint32_t busy;  // threads not done with the current run yet
+	bool shutdown;
+	TaskFunction function;
+	void* context;
+} ThreadPool;
+
+/**
+  * @brief: start workers
+  * @param: number of threads to start besides the one calling threadpool_run()
+  * @return: pool waiting for work
+  */
+ThreadPool* threadpool_open(uint32_t num_threads);
+
+/**
+  * @brief: run function(context, task) for task in [0, num_tasks) and wait
+  *         until all are done, tasks may run in any order and at once
+  * @param: pool to run on
+  * @param: function to run for every task
+  * @param: passed on to function
+  * @param: number of tasks
+  */
+void threadpool_run(ThreadPool* pool, TaskFunction function, void* context, uint32_t num_tasks);
+
+/**
+  * @brief: stop and join workers, free pool
+  * @param: pool to close
+  */
+void threadpool_close(ThreadPool* pool);
+
+#endif
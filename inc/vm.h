@@ -0,0 +1,83 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* the where clause of a select compiled to bytecode once per statement, and
+ * run on every row of its scan. Columns are loaded from the leaf into
+ * registers the first time a condition needs them, so a row failing an
+ * early condition never has the rest read, and tests are specialized by
+ * column type and comparison so each is one dispatch. Every test rejects
+ * the row when it fails, reaching OP_MATCH accepts it */
+
+#define PROGRAM_MAX_INSTRUCTIONS 32  // a load and a test per predicate, and OP_MATCH
+
+typedef enum {
+	REGISTER_SLNO,
+	REGISTER_YEAR,
+	REGISTER_POWER,
+	REGISTER_COMPANY,
+	REGISTER_COUNT
+} Register;
+
+typedef enum {
+	OP_LOAD_UINT32,  // register from the uint32 column at offset
+	OP_LOAD_DOUBLE,  // register from the double column at offset
+	OP_LOAD_TEXT,  // register to point at the string column at offset
+	OP_LOAD_CODE,  // register from the dictionary code of the company
+	OP_UINT32_EQUAL,
+	OP_UINT32_NOT_EQUAL,
+	OP_UINT32_LESS,
+	OP_UINT32_LESS_EQUAL,
+	OP_UINT32_GREATER,
+	OP_UINT32_GREATER_EQUAL,
+	OP_DOUBLE_EQUAL,  // NaN on either side only ever passes !=, as in C
+	OP_DOUBLE_NOT_EQUAL,
+	OP_DOUBLE_LESS,
+	OP_DOUBLE_LESS_EQUAL,
+	OP_DOUBLE_GREATER,
+	OP_DOUBLE_GREATER_EQUAL,
+	OP_TEXT_EQUAL,  // terminator included, a longer string with the same prefix differs
+	OP_TEXT_NOT_EQUAL,
+	OP_MATCH
+} Opcode;
+
+/**
+ * Structure of Instruction
+ *
+ * an opcode, the register it works on, and its operand: the column's offset
+ * and size for a load, the value compared against for a test
+ */
+typedef struct {
+	uint8_t opcode;
+	uint8_t reg;
+	uint16_t size;  // of the loaded column, of text for OP_TEXT_*
+	union {
+		uint32_t offset;
+		uint32_t number;
+		double real;
+		const char* text;
+	} operand;
+} Instruction;
+
+/**
+ * Structure of Program
+ *
+ * instructions run in order until a test fails or OP_MATCH
+ */
+typedef struct {
+	Instruction code[PROGRAM_MAX_INSTRUCTIONS];
+	uint32_t length;
+} Program;
+
+/**
+  * @brief: run a program on a cell of a leaf
+  * @param: compiled program
+  * @param: leaf node
+  * @param: cell in the leaf
+  * @return: whether the row is accepted
+  */
+bool vm_run(const Program* program, void* node, uint32_t cell_num);
+
+#endif
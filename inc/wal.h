@@ -0,0 +1,149 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+
+/* write-ahead log, "<db file>-wal" next to the database file. Changed pages
+ * are appended to it as frames, a frame with a non zero commit field ends a
+ * transaction, and pages only reach the database file at checkpoint. After a
+ * crash the committed frames are copied back by recovery at open */
+
+#define WAL_MAGIC 0x4c415753  // "SWAL" read as little endian
+#define WAL_DEFAULT_GROUP_SIZE 32  // commits per fsync with WAL_SYNC_NORMAL
+#define WAL_DEFAULT_GROUP_INTERVAL_MS 10  // longest a commit waits for fsync with WAL_SYNC_NORMAL, idle or not
+#define WAL_DEFAULT_CHECKPOINT_FRAMES 1024  // checkpoint once the log has this many frames
+
+extern const uint32_t WAL_HEADER_SIZE;
+extern const uint32_t WAL_FRAME_HEADER_SIZE;
+
+/* when to fsync the log after a commit */
+typedef enum {
+	WAL_SYNC_OFF,  // never, leave it to the OS
+	WAL_SYNC_NORMAL,  // group commit, one fsync for a batch of commits
+	WAL_SYNC_FULL  // every commit
+} WalSyncPolicy;
+
+/**
+ * Structure of Wal
+ *
+ * open log file, where the next frame goes and which frame holds the latest
+ * copy of every page in it
+ */
+typedef struct {
+	int file_descriptor;
+	char* filename;
+	uint32_t salt;  // changes every reset, frames with another salt are stale
+	off_t end;  // offset of the next frame
+	uint32_t num_frames;
+	off_t* index;  // page_num -> offset of latest frame of that page, 0 if none
+	uint32_t index_length;
+	uint32_t* pages;  // every page_num with a frame in the log, once each
+	uint32_t num_pages;
+	uint32_t pages_capacity;
+
+	WalSyncPolicy sync;
+	uint32_t group_size;
+	uint32_t group_interval_ms;
+	uint32_t unsynced_commits;
+	struct timespec first_unsynced;  // when the oldest unsynced commit happened
+	pthread_mutex_t sync_lock;  // of the two above, shared with the syncer
+	pthread_cond_t syncer_wake;  // a first unsynced commit, or closing
+	pthread_t syncer;  // syncs a group no commit came along to finish in time
+	bool syncer_running;  // started by the first commit with WAL_SYNC_NORMAL
+	bool closing;
+	uint32_t checkpoint_frames;
+} Wal;
+
+/**
+  * @brief: open or create the log of a database file
+  * @param: filename of the database, log is filename + "-wal"
+  * @param: sync policy for commits
+  * @return: opened log, may still hold frames of an earlier session
+  */
+Wal* wal_open(const char* db_filename, WalSyncPolicy sync);
+
+/**
+  * @brief: scan frames left by an earlier session, keep the ones up to the
+  *         last valid commit frame and index them
+  * @param: opened log
+  * @return: number of pages of the database as of last commit, 0 if the log
+  *          has no committed frames
+  */
+uint32_t wal_recover(Wal* wal);
+
+/**
+  * @brief: offset of the latest frame of page_num
+  * @param: log to search
+  * @param: page_num to look for
+  * @return: offset of the frame, 0 if page isn't in the log
+  */
+off_t wal_find(Wal* wal, uint32_t page_num);
+
+/**
+  * @brief: read page contents of the frame at offset
+  * @param: log to read
+  * @param: offset returned by wal_find()
+  * @param: PAGE_SIZE buffer to read into
+  */
+void wal_read_page(Wal* wal, off_t offset, void* page);
+
+/**
+  * @brief: append a frame holding page
+  * @param: log to append to
+  * @param: page_num of the page
+  * @param: page contents
+  * @param: number of pages of the database for a commit frame, 0 otherwise
+  */
+void wal_append(Wal* wal, uint32_t page_num, void* page, uint32_t commit_pages);
+
+/**
+  * @brief: append a frame for each of pages, in one vectored write
+  * @param: log to append to
+  * @param: page_num of every page
+  * @param: contents of every page
+  * @param: number of pages to append
+  * @param: number of pages of the database if the last frame is a commit
+  *         frame, 0 otherwise
+  */
+void wal_append_pages(Wal* wal, uint32_t* page_nums, void** pages, uint32_t count,
+		uint32_t commit_pages);
+
+/**
+  * @brief: a transaction has been committed, fsync according to sync policy.
+  *         With WAL_SYNC_NORMAL a group is synced by a later commit or, if
+  *         none comes in time, by a thread of the log's own
+  * @param: log that was committed to
+  */
+void wal_commit(Wal* wal);
+
+/**
+  * @brief: fsync the log now if any commit isn't synced yet
+  * @param: log to sync
+  */
+void wal_sync(Wal* wal);
+
+/**
+  * @brief: whether the log has grown enough to be checkpointed
+  * @param: log to check
+  */
+bool wal_needs_checkpoint(Wal* wal);
+
+/**
+  * @brief: empty the log after its pages have been checkpointed, a new salt
+  *         makes any leftover frames invalid
+  * @param: log to reset
+  */
+void wal_reset(Wal* wal);
+
+/**
+  * @brief: close the log
+  * @param: log to close
+  * @param: true to delete the log file, only safe when it's been checkpointed
+  */
+void wal_close(Wal* wal, bool remove_file);
+
+#endif
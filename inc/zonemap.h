@@ -0,0 +1,110 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pager.h"
+
+/* smallest and largest sl_no, year and power of every leaf, so a scan with
+ * conditions on them can leave out leaves that can't hold a matching row
+ * without reading them. Entries are indexed by page number and kept in a
+ * chain of pages, written and logged like any other page, and loaded whole
+ * into memory when the table is opened
+
+   zone map page
+   attr        size     offset
+   next_page   4        0     0 on the last page
+   entries     127*32   8     of pages [n * 127, (n + 1) * 127) on the n-th page
+   */
+
+#define ZONE_ENTRIES_PER_PAGE 127
+
+/**
+ * Structure of ZoneEntry
+ *
+ * ranges of the rows of a leaf. An empty leaf has every min above its max,
+ * pages that never had an entry set cover every value so they're never left
+ * out
+ */
+typedef struct {
+	uint32_t min_key;
+	uint32_t max_key;
+	uint32_t min_year;
+	uint32_t max_year;
+	double min_power;  // NaN powers are left out of both
+	double max_power;
+} ZoneEntry;
+
+/**
+ * Structure of ZoneMap
+ *
+ * every entry in memory, and the pages they're written to
+ */
+typedef struct {
+	Pager* pager;
+	uint32_t first_page;
+	uint32_t* pages;  // n-th page of the chain
+	uint32_t num_pages;
+	uint32_t pages_capacity;
+	ZoneEntry* entries;  // num_pages * ZONE_ENTRIES_PER_PAGE
+} ZoneMap;
+
+/* called for a leaf's entry, whether the leaf may have rows a scan wants */
+typedef bool (*ZoneFilter)(void* context, const ZoneEntry* zone);
+
+/**
+  * @brief: entry of a leaf with no rows
+  * @param: entry to reset
+  */
+void zone_entry_init(ZoneEntry* entry);
+
+/**
+  * @brief: widen entry to hold a row
+  * @param: entry
+  * @param: sl_no of the row
+  * @param: year of the row
+  * @param: power of the row
+  */
+void zone_entry_add(ZoneEntry* entry, uint32_t key, uint32_t year, double power);
+
+/**
+  * @brief: new zone map with its first page allocated
+  * @param: pager of the table
+  * @return: zone map, its first_page goes to the table header
+  */
+ZoneMap* zonemap_create(Pager* pager);
+
+/**
+  * @brief: load a zone map written before
+  * @param: pager of the table
+  * @param: first page of the zone map
+  * @return: zone map with every entry in memory
+  */
+ZoneMap* zonemap_open(Pager* pager, uint32_t first_page);
+
+/**
+  * @brief: entry of a page
+  * @param: zone map
+  * @param: page number of a leaf
+  * @return: entry, NULL if the map doesn't reach the page, which is the same
+  *          as an entry never set
+  */
+const ZoneEntry* zonemap_get(ZoneMap* zones, uint32_t page_num);
+
+/**
+  * @brief: replace the entry of a page, written to its zone map page if it
+  *         changed, which is allocated first if the map doesn't reach that far
+  * @param: zone map
+  * @param: page number of a leaf
+  * @param: new entry
+  */
+void zonemap_set(ZoneMap* zones, uint32_t page_num, const ZoneEntry* entry);
+
+/**
+  * @brief: free the in memory copy, pages are left to the pager
+  * @param: zone map to free
+  */
+void zonemap_close(ZoneMap* zones);
+
+#endif
@@ -0,0 +1,638 @@
+#include <math.h>
+
+#include "../inc/spdbutil.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AGGREGATE_X86
+#endif
+
+#define GROUP_TABLE_INITIAL 64  // hash slots to start with, doubled at half full
+#define GROUP_NONE UINT32_MAX
+#define AGGREGATE_GATHER_ROWS 64  // values of a slotted leaf copied out per kernel call
+
+/**
+ * Structure of Group
+ *
+ * totals of the rows of one company, or of all rows without group by
+ */
+typedef struct {
+	char company[COLUMN_COMPANY_NAME + 2];  // room for what COMPANY_SIZE holds and a NUL
+	uint32_t company_length;
+	uint64_t rows;
+	AggregateState columns[COLUMN_POWER + 1];  // indexed by Column, company's is unused
+} Group;
+
+/**
+ * Structure of GroupTable
+ *
+ * groups found so far, hashed on company with open addressing
+ */
+typedef struct {
+	Group* groups;
+	uint32_t num_groups;
+	uint32_t groups_capacity;
+	uint32_t* slots;  // index into groups, GROUP_NONE if empty
+	uint32_t num_slots;
+	uint32_t* codes;  // index into groups by dictionary code, GROUP_NONE if not seen yet
+	uint32_t num_codes;
+} GroupTable;
+
+/**
+  * @brief: reset state to no rows seen
+  */
+void aggregate_state_init(AggregateState* state) {
+	state->sum = 0;
+	state->min = UINT32_MAX;
+	state->max = 0;
+	state->real_sum = 0;
+	state->real_min = INFINITY;
+	state->real_max = -INFINITY;
+}
+
+static void aggregate_uint32_scalar(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t value;
+		memcpy(&value, values + (size_t)i * stride, sizeof(uint32_t));
+		state->sum += value;
+		if (value < state->min) {
+			state->min = value;
+		}
+		if (value > state->max) {
+			state->max = value;
+		}
+	}
+}
+
+static void aggregate_double_scalar(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+	for (uint32_t i = 0; i < count; ++i) {
+		double value;
+		memcpy(&value, values + (size_t)i * stride, sizeof(double));
+		state->real_sum += value;
+		if (value < state->real_min) {
+			state->real_min = value;
+		}
+		if (value > state->real_max) {
+			state->real_max = value;
+		}
+	}
+}
+
+#ifdef AGGREGATE_X86
+/**
+  * @brief: whether the CPU running us has AVX2, asked once
+  */
+static bool aggregate_has_avx2() {
+	static int supported = -1;
+	if (supported == -1) {
+		supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+/**
+  * @brief: 8 rows at a time, one gather picks the column out of 8 rows, or a
+  *         plain load when the column is stored contiguously, and the sum is
+  *         kept in 64 bit lanes so it can't wrap
+  */
+__attribute__((target("avx2")))
+static void aggregate_uint32_avx2(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+	__m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm256_set1_epi32((int)stride));
+	__m256i sum = _mm256_setzero_si256();
+	__m256i min = _mm256_set1_epi32(-1);  // UINT32_MAX
+	__m256i max = _mm256_setzero_si256();
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i value = stride == sizeof(uint32_t)
+			? _mm256_loadu_si256((const __m256i*)(values + (size_t)i * stride))
+			: _mm256_i32gather_epi32((const int*)(values + (size_t)i * stride), index, 1);
+		min = _mm256_min_epu32(min, value);
+		max = _mm256_max_epu32(max, value);
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(value)));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(value, 1)));
+	}
+	if (i > 0) {
+		uint64_t sums[4];
+		uint32_t mins[8];
+		uint32_t maxs[8];
+		_mm256_storeu_si256((__m256i*)sums, sum);
+		_mm256_storeu_si256((__m256i*)mins, min);
+		_mm256_storeu_si256((__m256i*)maxs, max);
+		state->sum += sums[0] + sums[1] + sums[2] + sums[3];
+		for (int lane = 0; lane < 8; ++lane) {
+			if (mins[lane] < state->min) {
+				state->min = mins[lane];
+			}
+			if (maxs[lane] > state->max) {
+				state->max = maxs[lane];
+			}
+		}
+	}
+	aggregate_uint32_scalar(state, values + (size_t)i * stride, count - i, stride);
+}
+
+/**
+  * @brief: 4 rows at a time. min/max take the accumulator when the row's
+  *         value is NaN, same as the scalar comparisons
+  */
+__attribute__((target("avx2")))
+static void aggregate_double_avx2(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+	__m128i index = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)stride));
+	__m256d sum = _mm256_setzero_pd();
+	__m256d min = _mm256_set1_pd(INFINITY);
+	__m256d max = _mm256_set1_pd(-INFINITY);
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256d value = stride == sizeof(double)
+			? _mm256_loadu_pd((const double*)(values + (size_t)i * stride))
+			: _mm256_i32gather_pd((const double*)(values + (size_t)i * stride), index, 1);
+		sum = _mm256_add_pd(sum, value);
+		min = _mm256_min_pd(value, min);
+		max = _mm256_max_pd(value, max);
+	}
+	if (i > 0) {
+		double sums[4];
+		double mins[4];
+		double maxs[4];
+		_mm256_storeu_pd(sums, sum);
+		_mm256_storeu_pd(mins, min);
+		_mm256_storeu_pd(maxs, max);
+		state->real_sum += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+		for (int lane = 0; lane < 4; ++lane) {
+			if (mins[lane] < state->real_min) {
+				state->real_min = mins[lane];
+			}
+			if (maxs[lane] > state->real_max) {
+				state->real_max = maxs[lane];
+			}
+		}
+	}
+	aggregate_double_scalar(state, values + (size_t)i * stride, count - i, stride);
+}
+#endif
+
+#ifdef __SSE2__
+/**
+  * @brief: 2 rows at a time, SSE2 has no gather so unless the column is
+  *         contiguous both lanes are loaded on their own, the adds and
+  *         compares are still shared
+  */
+static void aggregate_double_sse2(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+	__m128d sum = _mm_setzero_pd();
+	__m128d min = _mm_set1_pd(INFINITY);
+	__m128d max = _mm_set1_pd(-INFINITY);
+	uint32_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const uint8_t* row = values + (size_t)i * stride;
+		__m128d value = stride == sizeof(double)
+			? _mm_loadu_pd((const double*)row)
+			: _mm_loadh_pd(_mm_load_sd((const double*)row), (const double*)(row + stride));
+		sum = _mm_add_pd(sum, value);
+		min = _mm_min_pd(value, min);
+		max = _mm_max_pd(value, max);
+	}
+	if (i > 0) {
+		double sums[2];
+		double mins[2];
+		double maxs[2];
+		_mm_storeu_pd(sums, sum);
+		_mm_storeu_pd(mins, min);
+		_mm_storeu_pd(maxs, max);
+		state->real_sum += sums[0] + sums[1];
+		for (int lane = 0; lane < 2; ++lane) {
+			if (mins[lane] < state->real_min) {
+				state->real_min = mins[lane];
+			}
+			if (maxs[lane] > state->real_max) {
+				state->real_max = maxs[lane];
+			}
+		}
+	}
+	aggregate_double_scalar(state, values + (size_t)i * stride, count - i, stride);
+}
+#endif
+
+/**
+  * @brief: fold a uint32 column of count rows into state
+  */
+void aggregate_uint32_block(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+#ifdef AGGREGATE_X86
+	if (aggregate_has_avx2()) {
+		aggregate_uint32_avx2(state, values, count, stride);
+		return;
+	}
+#endif
+	aggregate_uint32_scalar(state, values, count, stride);
+}
+
+/**
+  * @brief: fold a double column of count rows into state
+  */
+void aggregate_double_block(AggregateState* state, const uint8_t* values, uint32_t count,
+		uint32_t stride) {
+#ifdef AGGREGATE_X86
+	if (aggregate_has_avx2()) {
+		aggregate_double_avx2(state, values, count, stride);
+		return;
+	}
+#endif
+#ifdef __SSE2__
+	aggregate_double_sse2(state, values, count, stride);
+#else
+	aggregate_double_scalar(state, values, count, stride);
+#endif
+}
+
+static void group_init(Group* group, const char* company, uint32_t company_length) {
+	memcpy(group->company, company, company_length);
+	group->company[company_length] = '\0';
+	group->company_length = company_length;
+	group->rows = 0;
+	for (int column = 0; column <= COLUMN_POWER; ++column) {
+		aggregate_state_init(&group->columns[column]);
+	}
+}
+
+/**
+  * @brief: FNV-1a of the company name
+  */
+static uint32_t group_hash(const char* company, uint32_t length) {
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < length; ++i) {
+		hash ^= (uint8_t)company[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+  * @brief: rehash every group into twice as many slots
+  */
+static void group_table_grow(GroupTable* table) {
+	uint32_t num_slots = table->num_slots ? table->num_slots * 2 : GROUP_TABLE_INITIAL;
+	free(table->slots);
+	table->slots = malloc(num_slots * sizeof(uint32_t));
+	memset(table->slots, 0xff, num_slots * sizeof(uint32_t));  // GROUP_NONE
+	table->num_slots = num_slots;
+	for (uint32_t i = 0; i < table->num_groups; ++i) {
+		Group* group = &table->groups[i];
+		uint32_t slot = group_hash(group->company, group->company_length) & (num_slots - 1);
+		while (table->slots[slot] != GROUP_NONE) {
+			slot = (slot + 1) & (num_slots - 1);
+		}
+		table->slots[slot] = i;
+	}
+}
+
+/**
+  * @brief: group of the company, added if it's the first row of it
+  */
+static Group* group_table_find(GroupTable* table, const char* company, uint32_t length) {
+	uint32_t slot = group_hash(company, length) & (table->num_slots - 1);
+	while (table->slots[slot] != GROUP_NONE) {
+		Group* group = &table->groups[table->slots[slot]];
+		if (group->company_length == length && memcmp(group->company, company, length) == 0) {
+			return group;
+		}
+		slot = (slot + 1) & (table->num_slots - 1);
+	}
+
+	if (table->num_groups == table->groups_capacity) {
+		table->groups_capacity *= 2;
+		table->groups = realloc(table->groups, table->groups_capacity * sizeof(Group));
+	}
+	uint32_t index = table->num_groups++;
+	group_init(&table->groups[index], company, length);
+	table->slots[slot] = index;
+	if (table->num_groups * 2 > table->num_slots) {
+		group_table_grow(table);
+	}
+	return &table->groups[index];
+}
+
+/**
+  * @brief: fold one cell of a leaf into group, for rows that are tested one
+  *         by one
+  */
+static void group_add_row(Group* group, void* node, uint32_t cell_num, bool* needed) {
+	group->rows++;
+	if (needed[COLUMN_SLNO]) {
+		aggregate_uint32_scalar(&group->columns[COLUMN_SLNO],
+				leaf_node_field(node, cell_num, SLNO_OFFSET, SLNO_SIZE), 1, 0);
+	}
+	if (needed[COLUMN_YEAR]) {
+		aggregate_uint32_scalar(&group->columns[COLUMN_YEAR],
+				leaf_node_field(node, cell_num, YEAR_OFFSET, YEAR_SIZE), 1, 0);
+	}
+	if (needed[COLUMN_POWER]) {
+		aggregate_double_scalar(&group->columns[COLUMN_POWER],
+				leaf_node_field(node, cell_num, POWER_OFFSET, POWER_SIZE), 1, 0);
+	}
+}
+
+static int compare_groups(const void* a, const void* b) {
+	return strcmp(((const Group*)a)->company, ((const Group*)b)->company);
+}
+
+/**
+  * @brief: value of aggregate for the rows of group
+  */
+static Value aggregate_value(Aggregate* aggregate, Group* group) {
+	Value value;
+	value.type = VALUE_NULL;
+	AggregateState* state = &group->columns[aggregate->column];
+	bool real = aggregate->column == COLUMN_POWER;
+	switch (aggregate->func) {
+		case (AGGREGATE_COUNT):
+			value.type = VALUE_INTEGER;
+			value.integer = group->rows;
+			return value;
+		case (AGGREGATE_GROUP):
+			value.type = VALUE_TEXT;
+			value.text = group->company;
+			value.text_length = group->company_length;
+			return value;
+		default:
+			break;
+	}
+	if (group->rows == 0) {
+		return value;  // null, like SQL over no rows
+	}
+	switch (aggregate->func) {
+		case (AGGREGATE_SUM):
+			value.type = real ? VALUE_REAL : VALUE_INTEGER;
+			value.real = state->real_sum;
+			value.integer = state->sum;
+			break;
+		case (AGGREGATE_AVG):
+			value.type = VALUE_REAL;
+			value.real = (real ? state->real_sum : (double)state->sum) / group->rows;
+			break;
+		case (AGGREGATE_MIN):
+			value.type = real ? VALUE_REAL : VALUE_INTEGER;
+			value.real = state->real_min;
+			value.integer = state->min;
+			break;
+		case (AGGREGATE_MAX):
+			value.type = real ? VALUE_REAL : VALUE_INTEGER;
+			value.real = state->real_max;
+			value.integer = state->max;
+			break;
+		default:
+			break;
+	}
+	return value;
+}
+
+/**
+  * @brief: empty table, with a single group for all rows when not grouping
+  */
+static void group_table_init(GroupTable* table, bool grouped) {
+	table->groups_capacity = grouped ? 16 : 1;
+	table->groups = malloc(table->groups_capacity * sizeof(Group));
+	table->num_groups = 0;
+	table->slots = NULL;
+	table->num_slots = 0;
+	table->codes = NULL;
+	table->num_codes = 0;
+	if (grouped) {
+		group_table_grow(table);
+	}
+	else {
+		group_init(&table->groups[0], "", 0);
+		table->num_groups = 1;
+	}
+}
+
+static void group_table_free(GroupTable* table) {
+	free(table->groups);
+	free(table->slots);
+	free(table->codes);
+}
+
+/**
+  * @brief: group of the company of a cell. The code of a dictionary leaf is
+  *         looked up in an array, the name is only hashed the first time a
+  *         code turns up
+  */
+static Group* group_table_find_cell(GroupTable* table, Dictionary* dictionary, void* node,
+		uint32_t cell_num) {
+	const char* company = leaf_node_field(node, cell_num, COMPANY_OFFSET, COMPANY_SIZE);
+	if (leaf_node_layout(node) != LEAF_LAYOUT_DICTIONARY) {
+		return group_table_find(table, company, strnlen(company, COMPANY_SIZE));
+	}
+	uint16_t code;
+	memcpy(&code, company, sizeof(code));
+	if (code >= table->num_codes) {
+		uint32_t num_codes = dictionary->num_entries;
+		table->codes = realloc(table->codes, num_codes * sizeof(uint32_t));
+		for (uint32_t i = table->num_codes; i < num_codes; ++i) {
+			table->codes[i] = GROUP_NONE;
+		}
+		table->num_codes = num_codes;
+	}
+	if (table->codes[code] == GROUP_NONE) {
+		const char* name = dictionary_name(dictionary, code);
+		table->codes[code] = group_table_find(table, name, strlen(name)) - table->groups;
+	}
+	return &table->groups[table->codes[code]];
+}
+
+/**
+  * @brief: fold the totals of part of the rows into the totals of the rest
+  */
+static void aggregate_state_merge(AggregateState* into, AggregateState* from) {
+	into->sum += from->sum;
+	if (from->min < into->min) {
+		into->min = from->min;
+	}
+	if (from->max > into->max) {
+		into->max = from->max;
+	}
+	into->real_sum += from->real_sum;
+	if (from->real_min < into->real_min) {
+		into->real_min = from->real_min;
+	}
+	if (from->real_max > into->real_max) {
+		into->real_max = from->real_max;
+	}
+}
+
+/**
+  * @brief: fold every group of a task's table into the table of the whole scan
+  */
+static void group_table_merge(GroupTable* into, GroupTable* from, bool grouped) {
+	for (uint32_t i = 0; i < from->num_groups; ++i) {
+		Group* part = &from->groups[i];
+		if (part->rows == 0) {
+			continue;
+		}
+		Group* group = grouped
+			? group_table_find(into, part->company, part->company_length)
+			: &into->groups[0];
+		group->rows += part->rows;
+		for (int column = 0; column <= COLUMN_POWER; ++column) {
+			aggregate_state_merge(&group->columns[column], &part->columns[column]);
+		}
+	}
+}
+
+/* what the leaves of an aggregate select's scan fold their rows into */
+typedef struct {
+	Statement* statement;
+	Dictionary* dictionary;
+	bool needed[COLUMN_POWER + 1];  // columns some aggregate reads
+	bool whole_leaves;  // no predicates or grouping, every cell goes to the block kernels
+	GroupTable* tables;  // one per task of a batch
+} AggregateScan;
+
+/**
+  * @brief: fold a column of count cells of a leaf into state with the block
+  *         kernels. Records of a slotted leaf aren't evenly spaced, their
+  *         values are copied next to each other first, a few at a time
+  */
+static void aggregate_column(AggregateState* state, void* node, uint32_t start, uint32_t count,
+		uint32_t offset, uint32_t size) {
+	bool real = size == sizeof(double);
+	uint32_t stride = leaf_node_field_stride(node, size);
+	if (stride != 0) {
+		void* values = leaf_node_field(node, start, offset, size);
+		if (real) {
+			aggregate_double_block(state, values, count, stride);
+		}
+		else {
+			aggregate_uint32_block(state, values, count, stride);
+		}
+		return;
+	}
+	uint8_t values[AGGREGATE_GATHER_ROWS * sizeof(double)];
+	for (uint32_t first = 0; first < count; first += AGGREGATE_GATHER_ROWS) {
+		uint32_t rows = count - first;
+		if (rows > AGGREGATE_GATHER_ROWS) {
+			rows = AGGREGATE_GATHER_ROWS;
+		}
+		for (uint32_t i = 0; i < rows; ++i) {
+			memcpy(values + i * size, leaf_node_field(node, start + first + i, offset, size), size);
+		}
+		if (real) {
+			aggregate_double_block(state, values, rows, size);
+		}
+		else {
+			aggregate_uint32_block(state, values, rows, size);
+		}
+	}
+}
+
+/**
+  * @brief: fold the cells [start, end) of a leaf into the task's groups.
+  *         Without predicates or group by they go to the block kernels in one
+  *         call per column, otherwise rows are tested and added one at a time
+  *         to their company's group
+  */
+static void aggregate_leaf(void* context, uint32_t task, void* node, uint32_t start, uint32_t end) {
+	AggregateScan* scan = context;
+	GroupTable* table = &scan->tables[task];
+	uint32_t count = end - start;
+
+	if (scan->whole_leaves) {
+		Group* all = &table->groups[0];
+		all->rows += count;
+		stats_add(STAT_ROWS_RETURNED, count);
+		if (scan->needed[COLUMN_SLNO]) {
+			aggregate_column(&all->columns[COLUMN_SLNO], node, start, count, SLNO_OFFSET, SLNO_SIZE);
+		}
+		if (scan->needed[COLUMN_YEAR]) {
+			aggregate_column(&all->columns[COLUMN_YEAR], node, start, count, YEAR_OFFSET, YEAR_SIZE);
+		}
+		if (scan->needed[COLUMN_POWER]) {
+			aggregate_column(&all->columns[COLUMN_POWER], node, start, count, POWER_OFFSET,
+					POWER_SIZE);
+		}
+		return;
+	}
+
+	Statement* statement = scan->statement;
+	uint32_t returned = 0;
+	for (uint32_t i = start; i < end; ++i) {
+		if (!vm_run(&statement->filter, node, i)) {
+			continue;
+		}
+		Group* group = &table->groups[0];
+		if (statement->group_by_company) {
+			group = group_table_find_cell(table, scan->dictionary, node, i);
+		}
+		group_add_row(group, node, i, scan->needed);
+		++returned;
+	}
+	stats_add(STAT_ROWS_RETURNED, returned);
+}
+
+/**
+  * @brief: execution of an aggregate select. Leaves in the key range are
+  *         scanned like a select does, but instead of rows coming out one by
+  *         one each column needed is folded into totals straight from the
+  *         page. Every task of the scan has its own totals, which are merged
+  *         in task order once a batch of tasks is done, so tasks can run on
+  *         any of the worker threads at once
+  */
+ExecuteResult execute_aggregate(Table* table, Statement* statement, Scan* scan, Output* output) {
+	AggregateScan aggregate;
+	aggregate.statement = statement;
+	aggregate.dictionary = table->dictionary;
+	for (int column = 0; column <= COLUMN_POWER; ++column) {
+		aggregate.needed[column] = false;
+	}
+	for (uint32_t i = 0; i < statement->num_aggregates; ++i) {
+		Aggregate* item = &statement->aggregates[i];
+		if (item->func != AGGREGATE_COUNT && item->func != AGGREGATE_GROUP) {
+			aggregate.needed[item->column] = true;
+		}
+	}
+	aggregate.whole_leaves = !statement->group_by_company && statement->num_predicates == 0;
+#ifdef AGGREGATE_X86
+	aggregate_has_avx2();  // settled here, before workers ask for it
+#endif
+	bool grouped = statement->group_by_company;
+
+	GroupTable result;
+	group_table_init(&result, grouped);
+	// totals per task even on one thread, so a sum of power adds up in the
+	// same order however many threads there are
+	aggregate.tables = malloc(SCAN_BATCH_TASKS * sizeof(GroupTable));
+	for (uint32_t first = 0; first < scan->num_tasks; first += SCAN_BATCH_TASKS) {
+		uint32_t count = scan->num_tasks - first;
+		if (count > SCAN_BATCH_TASKS) {
+			count = SCAN_BATCH_TASKS;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			group_table_init(&aggregate.tables[i], grouped);
+		}
+		scan_run(scan, first, count, aggregate_leaf, &aggregate);
+		for (uint32_t i = 0; i < count; ++i) {
+			group_table_merge(&result, &aggregate.tables[i], grouped);
+			group_table_free(&aggregate.tables[i]);
+		}
+	}
+	free(aggregate.tables);
+
+	if (grouped) {
+		qsort(result.groups, result.num_groups, sizeof(Group), compare_groups);
+	}
+	Value values[MAX_AGGREGATES];
+	for (uint32_t g = 0; g < result.num_groups && g < statement->limit; ++g) {
+		for (uint32_t i = 0; i < statement->num_aggregates; ++i) {
+			values[i] = aggregate_value(&statement->aggregates[i], &result.groups[g]);
+		}
+		output_values(output, values, statement->num_aggregates);
+	}
+	output_flush(output);
+	group_table_free(&result);
+	return EXECUTE_SUCCESS;
+}
@@ -0,0 +1,961 @@
+#include "../inc/spdbutil.h"
+
+/* table header, page 0
+
+   attr        size     offset
+   magic       4        0
+   root_page   4        4
+   num_rows    4        8
+   layout      4        12
+   dictionary  4        16    first page of the company dictionary, 0 if none
+   zone_map    4        20    first page of the zone map, 0 in older files
+   company_idx 4        24    first page of the company hash index, 0 in older files
+   version     4        28    TABLE_FORMAT_VERSION it was last written by, 0 in older files
+   page_count  8        32    pages in use as of the last write, 0 if not known yet
+   free_list   4        40    first page of the free page list, 0 when it's empty
+
+   a new structure gets a field here which older files have as 0 and are
+   read as not having, so they open without being rewritten. version only
+   goes up for changes older code can't ignore, it refuses files with a
+   newer one
+   */
+const uint32_t TABLE_MAGIC_OFFSET = 0;
+const uint32_t TABLE_ROOT_PAGE_OFFSET = 4;
+const uint32_t TABLE_NUM_ROWS_OFFSET = 8;
+const uint32_t TABLE_LAYOUT_OFFSET = 12;  // LeafLayout of new leaves, 0(rows) in older files
+const uint32_t TABLE_DICTIONARY_OFFSET = 16;
+const uint32_t TABLE_ZONE_MAP_OFFSET = 20;
+const uint32_t TABLE_COMPANY_INDEX_OFFSET = 24;
+const uint32_t TABLE_VERSION_OFFSET = 28;
+const uint32_t TABLE_PAGE_COUNT_OFFSET = 32;
+const uint32_t TABLE_FREE_LIST_OFFSET = 40;  // nothing frees pages yet, always 0
+
+/* common node header, node type is first byte of every node */
+const uint32_t NODE_TYPE_SIZE = sizeof(uint8_t);
+const uint32_t NODE_TYPE_OFFSET = 0;
+const uint32_t COMMON_NODE_HEADER_SIZE = sizeof(uint32_t);  // type and padding
+
+/* leaf node, header followed by cells, a cell is a serialized row and its
+ * key is the sl_no at SLNO_OFFSET so keys are not stored twice
+
+   attr        size     offset
+   type        1        0
+   layout      1        1
+   num_cells   4        4
+   next_leaf   4        8
+   cells       22*178   12
+
+ * A LEAF_LAYOUT_COLUMNS leaf holds the same cells split by column, the
+ * column at row offset o and of size s starts at 12 + o * 22 and the value of
+ * cell i is at i * s in it, so a scan of one column reads contiguous bytes
+ * and the number of cells a leaf holds doesn't change */
+const uint32_t LEAF_NODE_LAYOUT_OFFSET = NODE_TYPE_OFFSET + NODE_TYPE_SIZE;  // was padding, 0 is rows
+const uint32_t LEAF_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
+const uint32_t LEAF_NODE_NEXT_LEAF_OFFSET = LEAF_NODE_NUM_CELLS_OFFSET + sizeof(uint32_t);
+const uint32_t LEAF_NODE_HEADER_SIZE = LEAF_NODE_NEXT_LEAF_OFFSET + sizeof(uint32_t);
+// same as ROW_SIZE
+const uint32_t LEAF_NODE_CELL_SIZE = size_of_attribute(Row, sl_no) + size_of_attribute(Row, year)
+	+ size_of_attribute(Row, company) + size_of_attribute(Row, model) + size_of_attribute(Row, power);
+// 4096 is PAGE_SIZE, spelled out so these fold to constants
+const uint32_t LEAF_NODE_MAX_CELLS = (4096 - LEAF_NODE_HEADER_SIZE) / LEAF_NODE_CELL_SIZE;
+
+/* LEAF_LAYOUT_SLOTTED leaf, a slot per cell after the header holds where the
+ * cell's record is, records are put at the end of the page going down and
+ * only take as many bytes as their strings have. Slots are kept in key
+ * order, records are in whatever order they came in
+
+   attr        size     offset
+   type        1        0
+   layout      1        1
+   heap_start  2        2     lowest record, PAGE_SIZE when there's none
+   num_cells   4        4
+   next_leaf   4        8
+   slots       2*n      12
+
+ * record
+   sl_no       4        0
+   year        4        4
+   power       8        8
+   company     <=33     16    NUL terminated
+   model       <=129          NUL terminated, right after company
+
+ * a LEAF_LAYOUT_DICTIONARY leaf is a slotted leaf whose records have the
+ * code of the company in the table's dictionary instead of its name
+   company     2        16    code
+   model       <=129    18    NUL terminated
+   */
+const uint32_t LEAF_NODE_HEAP_START_OFFSET = LEAF_NODE_LAYOUT_OFFSET + sizeof(uint8_t);
+const uint32_t LEAF_NODE_SLOT_SIZE = sizeof(uint16_t);
+const uint32_t RECORD_SLNO_OFFSET = 0;
+const uint32_t RECORD_YEAR_OFFSET = RECORD_SLNO_OFFSET + size_of_attribute(Row, sl_no);
+const uint32_t RECORD_POWER_OFFSET = RECORD_YEAR_OFFSET + size_of_attribute(Row, year);
+const uint32_t RECORD_COMPANY_OFFSET = RECORD_POWER_OFFSET + size_of_attribute(Row, power);
+const uint32_t RECORD_COMPANY_CODE_SIZE = sizeof(uint16_t);
+
+/* internal node, header followed by (child, key) cells, key is the largest
+ * key in the child's subtree, right_child holds everything larger than the
+ * last key
+
+   attr        size     offset
+   type        1        0
+   num_keys    4        4
+   right_child 4        8
+   cells       510*8    12
+   */
+const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
+const uint32_t INTERNAL_NODE_RIGHT_CHILD_OFFSET = INTERNAL_NODE_NUM_KEYS_OFFSET + sizeof(uint32_t);
+const uint32_t INTERNAL_NODE_HEADER_SIZE = INTERNAL_NODE_RIGHT_CHILD_OFFSET + sizeof(uint32_t);
+const uint32_t INTERNAL_NODE_CHILD_SIZE = sizeof(uint32_t);
+const uint32_t INTERNAL_NODE_KEY_SIZE = sizeof(uint32_t);
+const uint32_t INTERNAL_NODE_CELL_SIZE = INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE;
+const uint32_t INTERNAL_NODE_MAX_KEYS = (4096 - INTERNAL_NODE_HEADER_SIZE) / INTERNAL_NODE_CELL_SIZE;
+
+#define BTREE_MAX_DEPTH 16  // 510-way fanout, never gets anywhere close
+
+/* size of each column of a row in order, a column starts where the previous
+ * one ends */
+#define ROW_NUM_COLUMNS 5
+static const uint32_t ROW_COLUMN_SIZES[ROW_NUM_COLUMNS] = {
+	size_of_attribute(Row, sl_no), size_of_attribute(Row, year), size_of_attribute(Row, company),
+	size_of_attribute(Row, model), size_of_attribute(Row, power)
+};
+
+NodeType get_node_type(void* node) {
+	return (NodeType)*((uint8_t*)(node + NODE_TYPE_OFFSET));
+}
+
+static void set_node_type(void* node, NodeType type) {
+	*((uint8_t*)(node + NODE_TYPE_OFFSET)) = (uint8_t)type;
+}
+
+uint32_t* leaf_node_num_cells(void* node) {
+	return node + LEAF_NODE_NUM_CELLS_OFFSET;
+}
+
+uint32_t* leaf_node_next_leaf(void* node) {
+	return node + LEAF_NODE_NEXT_LEAF_OFFSET;
+}
+
+LeafLayout leaf_node_layout(void* node) {
+	return (LeafLayout)*((uint8_t*)(node + LEAF_NODE_LAYOUT_OFFSET));
+}
+
+void* leaf_node_cell(void* node, uint32_t cell_num) {
+	return node + LEAF_NODE_HEADER_SIZE + cell_num * LEAF_NODE_CELL_SIZE;
+}
+
+static uint16_t* leaf_node_heap_start(void* node) {
+	return node + LEAF_NODE_HEAP_START_OFFSET;
+}
+
+static uint16_t* leaf_node_slot(void* node, uint32_t cell_num) {
+	return node + LEAF_NODE_HEADER_SIZE + cell_num * LEAF_NODE_SLOT_SIZE;
+}
+
+static void* leaf_node_record(void* node, uint32_t cell_num) {
+	return node + *leaf_node_slot(node, cell_num);
+}
+
+/**
+  * @brief: whether leaves of layout keep their cells as records behind slots
+  */
+static bool layout_is_slotted(LeafLayout layout) {
+	return layout == LEAF_LAYOUT_SLOTTED || layout == LEAF_LAYOUT_DICTIONARY;
+}
+
+/**
+  * @brief: bytes the company of a record takes, name and terminator or code
+  */
+static uint32_t record_company_size(void* record, LeafLayout layout) {
+	if (layout == LEAF_LAYOUT_DICTIONARY) {
+		return RECORD_COMPANY_CODE_SIZE;
+	}
+	return strlen(record + RECORD_COMPANY_OFFSET) + 1;
+}
+
+/**
+  * @brief: bytes a record takes, its fixed columns, company and model with
+  *         its terminator
+  */
+static uint32_t record_size(void* record, LeafLayout layout) {
+	uint32_t model_offset = RECORD_COMPANY_OFFSET + record_company_size(record, layout);
+	return model_offset + strlen(record + model_offset) + 1;
+}
+
+/**
+  * @brief: bytes the record of a serialized row would take
+  */
+static uint32_t row_record_size(void* row, LeafLayout layout) {
+	uint32_t company_size = layout == LEAF_LAYOUT_DICTIONARY
+		? RECORD_COMPANY_CODE_SIZE
+		: strnlen(row + COMPANY_OFFSET, COMPANY_SIZE) + 1;
+	return RECORD_COMPANY_OFFSET + company_size + strnlen(row + MODEL_OFFSET, MODEL_SIZE) + 1;
+}
+
+/**
+  * @brief: where the column at offset, size bytes, of a cell is in the leaf.
+  *         Company of a dictionary leaf is its 2 byte code
+  */
+void* leaf_node_field(void* node, uint32_t cell_num, uint32_t offset, uint32_t size) {
+	LeafLayout layout = leaf_node_layout(node);
+	switch (layout) {
+		case (LEAF_LAYOUT_ROWS):
+			break;
+		case (LEAF_LAYOUT_COLUMNS):
+			return node + LEAF_NODE_HEADER_SIZE + offset * LEAF_NODE_MAX_CELLS + cell_num * size;
+		case (LEAF_LAYOUT_SLOTTED):
+		case (LEAF_LAYOUT_DICTIONARY): {
+			void* record = leaf_node_record(node, cell_num);
+			if (offset == SLNO_OFFSET) {
+				return record + RECORD_SLNO_OFFSET;
+			}
+			if (offset == YEAR_OFFSET) {
+				return record + RECORD_YEAR_OFFSET;
+			}
+			if (offset == POWER_OFFSET) {
+				return record + RECORD_POWER_OFFSET;
+			}
+			if (offset == COMPANY_OFFSET) {
+				return record + RECORD_COMPANY_OFFSET;
+			}
+			return record + RECORD_COMPANY_OFFSET + record_company_size(record, layout);
+		}
+	}
+	return leaf_node_cell(node, cell_num) + offset;
+}
+
+/**
+  * @brief: bytes from a column of one cell to the same column of the next,
+  *         0 for a slotted leaf whose records aren't evenly spaced
+  */
+uint32_t leaf_node_field_stride(void* node, uint32_t size) {
+	switch (leaf_node_layout(node)) {
+		case (LEAF_LAYOUT_ROWS):
+			break;
+		case (LEAF_LAYOUT_COLUMNS):
+			return size;
+		case (LEAF_LAYOUT_SLOTTED):
+		case (LEAF_LAYOUT_DICTIONARY):
+			return 0;
+	}
+	return LEAF_NODE_CELL_SIZE;
+}
+
+/**
+  * @brief: serialized row of a cell, the cell itself when rows are stored
+  *         whole, otherwise its columns gathered into buffer. This is the
+  *         only place a company code is turned back into its name
+  */
+void* leaf_node_row(void* node, uint32_t cell_num, void* buffer, Dictionary* dictionary) {
+	LeafLayout layout = leaf_node_layout(node);
+	if (layout == LEAF_LAYOUT_ROWS) {
+		return leaf_node_cell(node, cell_num);
+	}
+	if (layout_is_slotted(layout)) {
+		// strings are padded back out with zeros
+		void* record = leaf_node_record(node, cell_num);
+		const char* company = record + RECORD_COMPANY_OFFSET;
+		uint32_t company_size = record_company_size(record, layout);
+		char* model = record + RECORD_COMPANY_OFFSET + company_size;
+		if (layout == LEAF_LAYOUT_DICTIONARY) {
+			uint16_t code;
+			memcpy(&code, company, sizeof(code));
+			company = dictionary_name(dictionary, code);
+		}
+		memset(buffer, 0, LEAF_NODE_CELL_SIZE);
+		memcpy(buffer + SLNO_OFFSET, record + RECORD_SLNO_OFFSET, SLNO_SIZE);
+		memcpy(buffer + YEAR_OFFSET, record + RECORD_YEAR_OFFSET, YEAR_SIZE);
+		memcpy(buffer + POWER_OFFSET, record + RECORD_POWER_OFFSET, POWER_SIZE);
+		memcpy(buffer + COMPANY_OFFSET, company, strlen(company) + 1);
+		memcpy(buffer + MODEL_OFFSET, model, strlen(model) + 1);
+		return buffer;
+	}
+	uint32_t offset = 0;
+	for (int i = 0; i < ROW_NUM_COLUMNS; ++i) {
+		uint32_t size = ROW_COLUMN_SIZES[i];
+		memcpy(buffer + offset, leaf_node_field(node, cell_num, offset, size), size);
+		offset += size;
+	}
+	return buffer;
+}
+
+uint32_t leaf_node_key(void* node, uint32_t cell_num) {
+	uint32_t key;
+	memcpy(&key, leaf_node_field(node, cell_num, SLNO_OFFSET, SLNO_SIZE), sizeof(key));
+	return key;
+}
+
+/**
+  * @brief: store serialized row as a cell, scattering its columns for a
+  *         columnar leaf or packing it into a new record for a slotted one,
+  *         with code standing in for the company in a dictionary leaf.
+  *         Leaf must have room for it
+  */
+static void leaf_node_write_cell(void* node, uint32_t cell_num, void* row, uint32_t code) {
+	LeafLayout layout = leaf_node_layout(node);
+	if (layout == LEAF_LAYOUT_ROWS) {
+		memcpy(leaf_node_cell(node, cell_num), row, LEAF_NODE_CELL_SIZE);
+		return;
+	}
+	if (layout_is_slotted(layout)) {
+		uint16_t record_offset = *leaf_node_heap_start(node) - row_record_size(row, layout);
+		void* record = node + record_offset;
+		memcpy(record + RECORD_SLNO_OFFSET, row + SLNO_OFFSET, SLNO_SIZE);
+		memcpy(record + RECORD_YEAR_OFFSET, row + YEAR_OFFSET, YEAR_SIZE);
+		memcpy(record + RECORD_POWER_OFFSET, row + POWER_OFFSET, POWER_SIZE);
+		uint32_t company_size;
+		if (layout == LEAF_LAYOUT_DICTIONARY) {
+			uint16_t stored_code = code;
+			company_size = RECORD_COMPANY_CODE_SIZE;
+			memcpy(record + RECORD_COMPANY_OFFSET, &stored_code, company_size);
+		}
+		else {
+			company_size = strnlen(row + COMPANY_OFFSET, COMPANY_SIZE) + 1;
+			memcpy(record + RECORD_COMPANY_OFFSET, row + COMPANY_OFFSET, company_size);
+			((char*)record)[RECORD_COMPANY_OFFSET + company_size - 1] = '\0';
+		}
+		char* model = record + RECORD_COMPANY_OFFSET + company_size;
+		uint32_t model_size = strnlen(row + MODEL_OFFSET, MODEL_SIZE) + 1;
+		memcpy(model, row + MODEL_OFFSET, model_size);
+		model[model_size - 1] = '\0';
+		*leaf_node_slot(node, cell_num) = record_offset;
+		*leaf_node_heap_start(node) = record_offset;
+		return;
+	}
+	uint32_t offset = 0;
+	for (int i = 0; i < ROW_NUM_COLUMNS; ++i) {
+		uint32_t size = ROW_COLUMN_SIZES[i];
+		memcpy(leaf_node_field(node, cell_num, offset, size), row + offset, size);
+		offset += size;
+	}
+}
+
+/**
+  * @brief: copy count cells from source_num of source to destination_num of
+  *         destination, both of the same layout, may be the same leaf with
+  *         the ranges overlapping. One move for row leaves and one per column
+  *         for columnar ones
+  */
+static void leaf_node_move_cells(void* destination, uint32_t destination_num, void* source,
+		uint32_t source_num, uint32_t count) {
+	LeafLayout layout = leaf_node_layout(source);
+	if (layout == LEAF_LAYOUT_ROWS) {
+		memmove(leaf_node_cell(destination, destination_num), leaf_node_cell(source, source_num),
+				count * LEAF_NODE_CELL_SIZE);
+		return;
+	}
+	if (layout_is_slotted(layout)) {
+		// within a leaf records stay put and only the slots move
+		if (destination == source) {
+			memmove(leaf_node_slot(destination, destination_num), leaf_node_slot(source, source_num),
+					count * LEAF_NODE_SLOT_SIZE);
+			return;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			void* record = leaf_node_record(source, source_num + i);
+			uint32_t size = record_size(record, layout);
+			uint16_t record_offset = *leaf_node_heap_start(destination) - size;
+			memcpy(destination + record_offset, record, size);
+			*leaf_node_slot(destination, destination_num + i) = record_offset;
+			*leaf_node_heap_start(destination) = record_offset;
+		}
+		return;
+	}
+	uint32_t offset = 0;
+	for (int i = 0; i < ROW_NUM_COLUMNS; ++i) {
+		uint32_t size = ROW_COLUMN_SIZES[i];
+		memmove(leaf_node_field(destination, destination_num, offset, size),
+				leaf_node_field(source, source_num, offset, size), count * size);
+		offset += size;
+	}
+}
+
+uint32_t* internal_node_num_keys(void* node) {
+	return node + INTERNAL_NODE_NUM_KEYS_OFFSET;
+}
+
+uint32_t* internal_node_right_child(void* node) {
+	return node + INTERNAL_NODE_RIGHT_CHILD_OFFSET;
+}
+
+uint32_t* internal_node_cell(void* node, uint32_t cell_num) {
+	return node + INTERNAL_NODE_HEADER_SIZE + cell_num * INTERNAL_NODE_CELL_SIZE;
+}
+
+/**
+  * @brief: child page number, child_num == num_keys is the right child
+  */
+uint32_t* internal_node_child(void* node, uint32_t child_num) {
+	uint32_t num_keys = *internal_node_num_keys(node);
+	if (child_num > num_keys) {
+		printf("Tried to access child_num %d > num_keys %d\n", child_num, num_keys);
+		exit(EXIT_FAILURE);
+	}
+	if (child_num == num_keys) {
+		return internal_node_right_child(node);
+	}
+	return internal_node_cell(node, child_num);
+}
+
+uint32_t* internal_node_key(void* node, uint32_t key_num) {
+	return (void*)internal_node_cell(node, key_num) + INTERNAL_NODE_CHILD_SIZE;
+}
+
+/**
+  * @brief: whether row can be added to the leaf without splitting it
+  */
+static bool leaf_node_has_room(void* node, void* row) {
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	LeafLayout layout = leaf_node_layout(node);
+	if (!layout_is_slotted(layout)) {
+		return num_cells < LEAF_NODE_MAX_CELLS;
+	}
+	uint32_t slots_end = LEAF_NODE_HEADER_SIZE + (num_cells + 1) * LEAF_NODE_SLOT_SIZE;
+	return slots_end + row_record_size(row, layout) <= *leaf_node_heap_start(node);
+}
+
+/**
+  * @brief: pack the records of a slotted leaf's cells against the end of the
+  *         page again, giving back the space of records moved out of it
+  */
+static void leaf_node_compact(void* node) {
+	if (!layout_is_slotted(leaf_node_layout(node))) {
+		return;
+	}
+	uint8_t copy[4096];  // PAGE_SIZE
+	memcpy(copy, node, sizeof(copy));
+	*leaf_node_heap_start(node) = sizeof(copy);
+	leaf_node_move_cells(node, 0, copy, 0, *leaf_node_num_cells(node));
+}
+
+static void initialize_leaf_node(void* node, LeafLayout layout) {
+	memset(node, 0, PAGE_SIZE);
+	set_node_type(node, NODE_LEAF);
+	*((uint8_t*)(node + LEAF_NODE_LAYOUT_OFFSET)) = (uint8_t)layout;
+	*leaf_node_heap_start(node) = PAGE_SIZE;  // only used by slotted leaves
+	*leaf_node_num_cells(node) = 0;
+	*leaf_node_next_leaf(node) = 0;  // 0 is the header page, so it means no sibling
+}
+
+static void initialize_internal_node(void* node) {
+	memset(node, 0, PAGE_SIZE);
+	set_node_type(node, NODE_INTERNAL);
+	*internal_node_num_keys(node) = 0;
+}
+
+/**
+  * @brief: write root page, row count and page count back to the header
+  *         page, last thing a statement does so every page it allocated is
+  *         counted. Stamps the current version, which upgrades an older file
+  *         the first time it's written
+  */
+static void btree_store_header(Table* table) {
+	void* header = get_page_for_write(table->pager, TABLE_HEADER_PAGE);
+	memcpy(header + TABLE_ROOT_PAGE_OFFSET, &table->root_page_num, sizeof(uint32_t));
+	memcpy(header + TABLE_NUM_ROWS_OFFSET, &table->num_rows, sizeof(uint32_t));
+	uint32_t version = TABLE_FORMAT_VERSION;
+	memcpy(header + TABLE_VERSION_OFFSET, &version, sizeof(version));
+	uint64_t page_count = table->pager->num_pages;
+	memcpy(header + TABLE_PAGE_COUNT_OFFSET, &page_count, sizeof(page_count));
+}
+
+/**
+  * @brief: set up header page and an empty root leaf for a new database,
+  *         layout is kept in the header for every leaf made later
+  */
+void btree_init(Table* table, LeafLayout layout) {
+	void* header = get_page_for_write(table->pager, TABLE_HEADER_PAGE);
+	uint32_t magic = TABLE_MAGIC;
+	memcpy(header + TABLE_MAGIC_OFFSET, &magic, sizeof(magic));
+	uint32_t stored_layout = layout;
+	memcpy(header + TABLE_LAYOUT_OFFSET, &stored_layout, sizeof(stored_layout));
+
+	table->root_page_num = pager_allocate_page(table->pager);
+	table->num_rows = 0;
+	table->layout = layout;
+	initialize_leaf_node(get_page_for_write(table->pager, table->root_page_num), layout);
+	table->dictionary = NULL;
+	if (layout == LEAF_LAYOUT_DICTIONARY) {
+		table->dictionary = dictionary_create(table->pager);
+		header = get_page_for_write(table->pager, TABLE_HEADER_PAGE);
+		memcpy(header + TABLE_DICTIONARY_OFFSET, &table->dictionary->first_page, sizeof(uint32_t));
+	}
+	table->zones = zonemap_create(table->pager);
+	header = get_page_for_write(table->pager, TABLE_HEADER_PAGE);
+	memcpy(header + TABLE_ZONE_MAP_OFFSET, &table->zones->first_page, sizeof(uint32_t));
+	ZoneEntry empty;
+	zone_entry_init(&empty);
+	zonemap_set(table->zones, table->root_page_num, &empty);
+	table->company_index = hashindex_create(table->pager);
+	header = get_page_for_write(table->pager, TABLE_HEADER_PAGE);
+	memcpy(header + TABLE_COMPANY_INDEX_OFFSET, &table->company_index->first_page, sizeof(uint32_t));
+	btree_store_header(table);
+}
+
+/**
+  * @brief: load root page and row count from the header page, refuses files
+  *         which don't start with our magic number, were written by a newer
+  *         format or are shorter than the pages the header says are in use
+  */
+void btree_load_header(Table* table) {
+	void* header = get_page(table->pager, TABLE_HEADER_PAGE);
+	uint32_t magic;
+	memcpy(&magic, header + TABLE_MAGIC_OFFSET, sizeof(magic));
+	if (magic != TABLE_MAGIC) {
+		printf("Not a spdb database file.\n");
+		exit(EXIT_FAILURE);
+	}
+	uint32_t version;
+	memcpy(&version, header + TABLE_VERSION_OFFSET, sizeof(version));
+	if (version > TABLE_FORMAT_VERSION) {
+		printf("Database file has format version %u, this build reads up to %u.\n", version,
+				TABLE_FORMAT_VERSION);
+		exit(EXIT_FAILURE);
+	}
+	uint64_t page_count;
+	memcpy(&page_count, header + TABLE_PAGE_COUNT_OFFSET, sizeof(page_count));
+	if (page_count > table->pager->num_pages) {
+		printf("Database file is truncated, %lu pages in use but %u found.\n",
+				(unsigned long)page_count, table->pager->num_pages);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(&table->root_page_num, header + TABLE_ROOT_PAGE_OFFSET, sizeof(uint32_t));
+	memcpy(&table->num_rows, header + TABLE_NUM_ROWS_OFFSET, sizeof(uint32_t));
+	uint32_t layout;
+	memcpy(&layout, header + TABLE_LAYOUT_OFFSET, sizeof(layout));
+	table->layout = (LeafLayout)layout;
+	uint32_t dictionary_page;
+	memcpy(&dictionary_page, header + TABLE_DICTIONARY_OFFSET, sizeof(dictionary_page));
+	uint32_t zone_map_page;
+	memcpy(&zone_map_page, header + TABLE_ZONE_MAP_OFFSET, sizeof(zone_map_page));
+	uint32_t company_index_page;
+	memcpy(&company_index_page, header + TABLE_COMPANY_INDEX_OFFSET, sizeof(company_index_page));
+	// all read before anything else is loaded, header may not stay valid
+	table->dictionary = dictionary_page == 0 ? NULL : dictionary_open(table->pager, dictionary_page);
+	table->zones = zone_map_page == 0 ? NULL : zonemap_open(table->pager, zone_map_page);
+	table->company_index = company_index_page == 0
+		? NULL : hashindex_open(table->pager, company_index_page);
+}
+
+/**
+  * @brief: binary search the leaf for key, returns the index of the first
+  *         cell whose key is >= key, which is also where key would be inserted
+  */
+static uint32_t leaf_node_find(void* node, uint32_t key) {
+	uint32_t min_index = 0;
+	uint32_t one_past_max_index = *leaf_node_num_cells(node);
+	while (one_past_max_index != min_index) {
+		uint32_t index = min_index + (one_past_max_index - min_index) / 2;
+		if (key <= leaf_node_key(node, index)) {
+			one_past_max_index = index;
+		}
+		else {
+			min_index = index + 1;
+		}
+	}
+	return min_index;
+}
+
+/**
+  * @brief: binary search the internal node for the child which should
+  *         contain key, first child whose max key is >= key or the right child
+  */
+static uint32_t internal_node_find_child(void* node, uint32_t key) {
+	uint32_t min_index = 0;
+	uint32_t max_index = *internal_node_num_keys(node);  // there's one more child than keys
+	while (min_index != max_index) {
+		uint32_t index = min_index + (max_index - min_index) / 2;
+		if (key <= *internal_node_key(node, index)) {
+			max_index = index;
+		}
+		else {
+			min_index = index + 1;
+		}
+	}
+	return min_index;
+}
+
+/**
+  * @brief: cursor at the first row whose key is >= key, walks down from the
+  *         root, one page read per level
+  */
+Cursor table_find(Table* table, uint32_t key) {
+	uint32_t page_num = table->root_page_num;
+	void* node = get_page(table->pager, page_num);
+	while (get_node_type(node) == NODE_INTERNAL) {
+		page_num = *internal_node_child(node, internal_node_find_child(node, key));
+		node = get_page(table->pager, page_num);
+	}
+
+	Cursor cursor;
+	cursor.table = table;
+	cursor.page_num = page_num;
+	cursor.cell_num = leaf_node_find(node, key);
+	cursor.end_of_table = false;
+	// key is bigger than everything in this leaf, first row >= key is in the next one
+	if (cursor.cell_num == *leaf_node_num_cells(node)) {
+		uint32_t next_leaf = *leaf_node_next_leaf(node);
+		if (next_leaf == 0) {
+			cursor.end_of_table = true;
+		}
+		else {
+			cursor.page_num = next_leaf;
+			cursor.cell_num = 0;
+		}
+	}
+	return cursor;
+}
+
+/**
+  * @brief: cursor at the first row of the table, leftmost leaf holds the
+  *         smallest key
+  */
+Cursor table_start(Table* table) {
+	return table_find(table, 0);
+}
+
+/**
+  * @brief: pointer to the serialized row under the cursor
+  */
+void* cursor_value(Cursor* cursor, void* buffer) {
+	void* page = get_page(cursor->table->pager, cursor->page_num);
+	return leaf_node_row(page, cursor->cell_num, buffer, cursor->table->dictionary);
+}
+
+/**
+  * @brief: key(sl_no) of the row under the cursor
+  */
+uint32_t cursor_key(Cursor* cursor) {
+	void* page = get_page(cursor->table->pager, cursor->page_num);
+	return leaf_node_key(page, cursor->cell_num);
+}
+
+/**
+  * @brief: move cursor to the next row, leaves are linked left to right so
+  *         a scan never goes back up the tree
+  */
+void cursor_advance(Cursor* cursor) {
+	void* node = get_page(cursor->table->pager, cursor->page_num);
+	cursor->cell_num += 1;
+	if (cursor->cell_num >= *leaf_node_num_cells(node)) {
+		uint32_t next_leaf = *leaf_node_next_leaf(node);
+		if (next_leaf == 0) {
+			cursor->end_of_table = true;
+		}
+		else {
+			cursor->page_num = next_leaf;
+			cursor->cell_num = 0;
+		}
+	}
+}
+
+/**
+  * @brief: insert (child, key) into an internal node which has room for it,
+  *         at index, shifting the cells after it
+  */
+static void internal_node_insert_at(void* node, uint32_t index, uint32_t child, uint32_t key) {
+	uint32_t num_keys = *internal_node_num_keys(node);
+	memmove(internal_node_cell(node, index + 1), internal_node_cell(node, index),
+			(num_keys - index) * INTERNAL_NODE_CELL_SIZE);
+	*internal_node_cell(node, index) = child;
+	*internal_node_key(node, index) = key;
+	*internal_node_num_keys(node) = num_keys + 1;
+}
+
+/**
+  * @brief: make a new root above the old root once it has split in two, the
+  *         header page is updated to point to it
+  */
+static void create_new_root(Table* table, uint32_t left_page_num, uint32_t separator,
+		uint32_t right_page_num) {
+	uint32_t root_page_num = pager_allocate_page(table->pager);
+	void* root = get_page_for_write(table->pager, root_page_num);
+	initialize_internal_node(root);
+	*internal_node_num_keys(root) = 1;
+	*internal_node_cell(root, 0) = left_page_num;
+	*internal_node_key(root, 0) = separator;
+	*internal_node_right_child(root) = right_page_num;
+	table->root_page_num = root_page_num;
+}
+
+/**
+  * @brief: child at child_index of the internal node at path[depth] has
+  *         split, left half stayed in place with largest key separator and
+  *         right half moved to right_page_num. Insert the new child into the
+  *         parent, splitting it as well if it's full and repeating up the path.
+  *         append tells that the split happened at the right edge of the tree
+  *         because keys are coming in ascending order
+  */
+static void internal_node_insert_split(Table* table, uint32_t* path, uint32_t* path_index,
+		int depth, uint32_t separator, uint32_t right_page_num, bool append) {
+	Pager* pager = table->pager;
+	while (depth >= 0) {
+		uint32_t page_num = path[depth];
+		uint32_t child_index = path_index[depth];
+		void* node = get_page_for_write(pager, page_num);
+		uint32_t num_keys = *internal_node_num_keys(node);
+		uint32_t left_page_num = *internal_node_child(node, child_index);
+
+		/* left child keeps its slot with the new separator, the right half
+		 * takes over the old key(or the right child pointer) */
+		if (num_keys < INTERNAL_NODE_MAX_KEYS) {
+			if (child_index == num_keys) {
+				internal_node_insert_at(node, num_keys, left_page_num, separator);
+				*internal_node_right_child(node) = right_page_num;
+			}
+			else {
+				uint32_t old_key = *internal_node_key(node, child_index);
+				*internal_node_key(node, child_index) = separator;
+				internal_node_insert_at(node, child_index + 1, right_page_num, old_key);
+			}
+			return;
+		}
+
+		/* node is full, lay out all num_keys + 1 keys and num_keys + 2
+		 * children in order, then split them between this node and a new one.
+		 * Left child's slot gets the separator and the right half goes right
+		 * after it with the key left used to have */
+		uint32_t total_keys = num_keys + 1;
+		uint32_t* children = malloc((total_keys + 1) * sizeof(uint32_t));
+		uint32_t* keys = malloc(total_keys * sizeof(uint32_t));
+		for (uint32_t i = 0; i < child_index; ++i) {
+			children[i] = *internal_node_child(node, i);
+			keys[i] = *internal_node_key(node, i);
+		}
+		children[child_index] = left_page_num;
+		keys[child_index] = separator;
+		children[child_index + 1] = right_page_num;
+		for (uint32_t i = child_index; i < num_keys; ++i) {
+			keys[i + 1] = *internal_node_key(node, i);
+			children[i + 2] = *internal_node_child(node, i + 1);
+		}
+
+		/* left gets keys [0, split) and children [0, split], keys[split] goes up
+		 * as the largest key of left, right gets the rest. Appending at the
+		 * right edge leaves this node full and starts the new one with just
+		 * the new right child, the left half would never be filled again */
+		uint32_t split = total_keys / 2;
+		if (append && child_index == num_keys) {
+			split = total_keys - 1;
+		}
+		uint32_t new_page_num = pager_allocate_page(pager);
+		pager_pin(pager, page_num);
+		void* new_node = pager_pin(pager, new_page_num);
+		node = get_page_for_write(pager, page_num);
+		get_page_for_write(pager, new_page_num);
+
+		initialize_internal_node(node);
+		for (uint32_t i = 0; i < split; ++i) {
+			internal_node_insert_at(node, i, children[i], keys[i]);
+		}
+		*internal_node_right_child(node) = children[split];
+
+		initialize_internal_node(new_node);
+		for (uint32_t i = split + 1; i < total_keys; ++i) {
+			internal_node_insert_at(new_node, i - split - 1, children[i], keys[i]);
+		}
+		*internal_node_right_child(new_node) = children[total_keys];
+
+		pager_unpin(pager, new_page_num);
+		pager_unpin(pager, page_num);
+
+		separator = keys[split];
+		right_page_num = new_page_num;
+		free(children);
+		free(keys);
+
+		if (depth == 0) {
+			create_new_root(table, page_num, separator, right_page_num);
+			return;
+		}
+		--depth;
+	}
+}
+
+/**
+  * @brief: zone map entry of a leaf from its cells
+  */
+static void leaf_node_zone(void* node, ZoneEntry* entry) {
+	zone_entry_init(entry);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	for (uint32_t i = 0; i < num_cells; ++i) {
+		uint32_t year;
+		double power;
+		memcpy(&year, leaf_node_field(node, i, YEAR_OFFSET, YEAR_SIZE), YEAR_SIZE);
+		memcpy(&power, leaf_node_field(node, i, POWER_OFFSET, POWER_SIZE), POWER_SIZE);
+		zone_entry_add(entry, leaf_node_key(node, i), year, power);
+	}
+}
+
+/**
+  * @brief: leaf is full, move the upper half of its cells plus the new row to
+  *         a new leaf linked right after it, then register the new leaf in the
+  *         parent. A row past the end of the last leaf is an append, the old
+  *         leaf stays full and the new one starts with only that row, so
+  *         loading keys in order packs pages instead of leaving them half full
+  */
+static void leaf_node_split_and_insert(Table* table, uint32_t* path, uint32_t* path_index,
+		int depth, uint32_t page_num, uint32_t cell_num, void* row, uint32_t code) {
+	Pager* pager = table->pager;
+	uint32_t new_page_num = pager_allocate_page(pager);
+	void* old_node = pager_pin(pager, page_num);
+	void* new_node = pager_pin(pager, new_page_num);
+	get_page_for_write(pager, page_num);
+	get_page_for_write(pager, new_page_num);
+
+	uint32_t num_cells = *leaf_node_num_cells(old_node);
+	bool append = (cell_num == num_cells && *leaf_node_next_leaf(old_node) == 0);
+	initialize_leaf_node(new_node, leaf_node_layout(old_node));
+	*leaf_node_next_leaf(new_node) = *leaf_node_next_leaf(old_node);
+	*leaf_node_next_leaf(old_node) = new_page_num;
+
+	/* all existing cells plus the new one are divided evenly between old
+	 * (left) and new(right) node. Cells going right are copied out before
+	 * the ones staying are shifted to make room for the new row. Half the
+	 * cells of a slotted leaf always fit in a page with any other record,
+	 * a full one holds at least 22 of the biggest */
+	uint32_t total_cells = num_cells + 1;
+	uint32_t right_count = append ? 1 : total_cells / 2;
+	uint32_t left_count = total_cells - right_count;
+	if (cell_num >= left_count) {
+		uint32_t new_cell_num = cell_num - left_count;
+		leaf_node_move_cells(new_node, 0, old_node, left_count, new_cell_num);
+		leaf_node_write_cell(new_node, new_cell_num, row, code);
+		leaf_node_move_cells(new_node, new_cell_num + 1, old_node, cell_num, num_cells - cell_num);
+		*leaf_node_num_cells(old_node) = left_count;
+		leaf_node_compact(old_node);
+	}
+	else {
+		leaf_node_move_cells(new_node, 0, old_node, left_count - 1, right_count);
+		*leaf_node_num_cells(old_node) = left_count - 1;
+		leaf_node_compact(old_node);
+		leaf_node_move_cells(old_node, cell_num + 1, old_node, cell_num, left_count - 1 - cell_num);
+		leaf_node_write_cell(old_node, cell_num, row, code);
+	}
+	*leaf_node_num_cells(old_node) = left_count;
+	*leaf_node_num_cells(new_node) = right_count;
+	uint32_t separator = leaf_node_key(old_node, left_count - 1);
+	ZoneEntry old_zone;
+	ZoneEntry new_zone;
+	leaf_node_zone(old_node, &old_zone);
+	leaf_node_zone(new_node, &new_zone);
+
+	pager_unpin(pager, new_page_num);
+	pager_unpin(pager, page_num);
+	if (table->zones != NULL) {
+		zonemap_set(table->zones, page_num, &old_zone);
+		zonemap_set(table->zones, new_page_num, &new_zone);
+	}
+
+	if (depth < 0) {
+		create_new_root(table, page_num, separator, new_page_num);
+		return;
+	}
+	internal_node_insert_split(table, path, path_index, depth, separator, new_page_num, append);
+}
+
+/**
+  * @brief: put row at cell_num of the leaf at page_num, the end of path
+  *         down from the root, splitting the leaf if it's full. A company not
+  *         in the dictionary yet is added before the leaf is touched, that
+  *         may write a dictionary page, and so is the row's company index entry
+  */
+static void leaf_node_insert(Table* table, uint32_t* path, uint32_t* path_index, int depth,
+		uint32_t page_num, uint32_t cell_num, void* row) {
+	uint32_t company_length = strnlen(row + COMPANY_OFFSET, COMPANY_SIZE);
+	uint32_t code = DICTIONARY_NONE;
+	if (table->dictionary != NULL) {
+		code = dictionary_encode(table->dictionary, row + COMPANY_OFFSET, company_length);
+	}
+	if (table->company_index != NULL) {
+		uint32_t key;
+		memcpy(&key, row + SLNO_OFFSET, SLNO_SIZE);
+		hashindex_insert(table->company_index, hashindex_hash(row + COMPANY_OFFSET, company_length),
+				key);
+	}
+	void* node = get_page_for_write(table->pager, page_num);
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	if (!leaf_node_has_room(node, row)) {
+		leaf_node_split_and_insert(table, path, path_index, depth, page_num, cell_num, row, code);
+	}
+	else {
+		leaf_node_move_cells(node, cell_num + 1, node, cell_num, num_cells - cell_num);
+		leaf_node_write_cell(node, cell_num, row, code);
+		*leaf_node_num_cells(node) = num_cells + 1;
+		const ZoneEntry* zone = table->zones ? zonemap_get(table->zones, page_num) : NULL;
+		if (zone != NULL) {
+			ZoneEntry widened = *zone;
+			uint32_t key;
+			uint32_t year;
+			double power;
+			memcpy(&key, row + SLNO_OFFSET, SLNO_SIZE);
+			memcpy(&year, row + YEAR_OFFSET, YEAR_SIZE);
+			memcpy(&power, row + POWER_OFFSET, POWER_SIZE);
+			zone_entry_add(&widened, key, year, power);
+			zonemap_set(table->zones, page_num, &widened);
+		}
+	}
+	table->num_rows++;
+	btree_store_header(table);
+}
+
+/**
+  * @brief: insert serialized row into the tree. Walks down from the root
+  *         remembering the path, so splits can be pushed back up without
+  *         storing parent pointers in every node
+  */
+BtreeInsertResult btree_insert(Table* table, uint32_t key, void* row) {
+	Pager* pager = table->pager;
+	uint32_t path[BTREE_MAX_DEPTH];
+	uint32_t path_index[BTREE_MAX_DEPTH];
+	int depth = -1;
+
+	uint32_t page_num = table->root_page_num;
+	void* node = get_page(pager, page_num);
+	while (get_node_type(node) == NODE_INTERNAL) {
+		uint32_t child_index = internal_node_find_child(node, key);
+		++depth;
+		path[depth] = page_num;
+		path_index[depth] = child_index;
+		page_num = *internal_node_child(node, child_index);
+		node = get_page(pager, page_num);
+	}
+
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	uint32_t cell_num = leaf_node_find(node, key);
+	if (cell_num < num_cells && leaf_node_key(node, cell_num) == key) {
+		return BTREE_DUPLICATE_KEY;
+	}
+	leaf_node_insert(table, path, path_index, depth, page_num, cell_num, row);
+	return BTREE_INSERT_SUCCESS;
+}
+
+/**
+  * @brief: insert for rows which mostly come in key order. Goes straight
+  *         down the right edge, no binary searches, and appends to the last
+  *         leaf when key is bigger than every key in the table, otherwise it's
+  *         a normal btree_insert()
+  */
+BtreeInsertResult btree_append(Table* table, uint32_t key, void* row) {
+	Pager* pager = table->pager;
+	uint32_t path[BTREE_MAX_DEPTH];
+	uint32_t path_index[BTREE_MAX_DEPTH];
+	int depth = -1;
+
+	uint32_t page_num = table->root_page_num;
+	void* node = get_page(pager, page_num);
+	while (get_node_type(node) == NODE_INTERNAL) {
+		++depth;
+		path[depth] = page_num;
+		path_index[depth] = *internal_node_num_keys(node);
+		page_num = *internal_node_right_child(node);
+		node = get_page(pager, page_num);
+	}
+
+	uint32_t num_cells = *leaf_node_num_cells(node);
+	if (num_cells > 0 && key <= leaf_node_key(node, num_cells - 1)) {
+		return btree_insert(table, key, row);
+	}
+	leaf_node_insert(table, path, path_index, depth, page_num, num_cells, row);
+	return BTREE_INSERT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+#include "../inc/spdbutil.h"
+
+#define DICTIONARY_INITIAL_SLOTS 64  // doubled at half full
+
+static const uint32_t DICTIONARY_NEXT_PAGE_OFFSET = 0;
+static const uint32_t DICTIONARY_NUM_ENTRIES_OFFSET = 4;
+static const uint32_t DICTIONARY_HEADER_SIZE = 8;
+
+/**
+  * @brief: FNV-1a of the name
+  */
+static uint32_t dictionary_hash(const char* name, uint32_t length) {
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < length; ++i) {
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+  * @brief: entry of a code
+  */
+static DictionaryEntry* dictionary_entry(Dictionary* dictionary, uint32_t code) {
+	return &dictionary->entries[code / DICTIONARY_BLOCK_ENTRIES][code % DICTIONARY_BLOCK_ENTRIES];
+}
+
+/**
+  * @brief: slot holding the code of name, or the empty one it would go to
+  */
+static uint32_t dictionary_slot(Dictionary* dictionary, const char* name, uint32_t length) {
+	uint32_t slot = dictionary_hash(name, length) & (dictionary->num_slots - 1);
+	while (dictionary->slots[slot] != DICTIONARY_NONE) {
+		DictionaryEntry* entry = dictionary_entry(dictionary, dictionary->slots[slot]);
+		if (entry->length == length && memcmp(entry->name, name, length) == 0) {
+			break;
+		}
+		slot = (slot + 1) & (dictionary->num_slots - 1);
+	}
+	return slot;
+}
+
+/**
+  * @brief: twice as many slots, every code hashed again
+  */
+static void dictionary_grow(Dictionary* dictionary) {
+	free(dictionary->slots);
+	dictionary->num_slots = dictionary->num_slots ? dictionary->num_slots * 2 : DICTIONARY_INITIAL_SLOTS;
+	dictionary->slots = malloc(dictionary->num_slots * sizeof(uint32_t));
+	for (uint32_t i = 0; i < dictionary->num_slots; ++i) {
+		dictionary->slots[i] = DICTIONARY_NONE;
+	}
+	for (uint32_t code = 0; code < dictionary->num_entries; ++code) {
+		DictionaryEntry* entry = dictionary_entry(dictionary, code);
+		uint32_t slot = dictionary_slot(dictionary, entry->name, entry->length);
+		dictionary->slots[slot] = code;
+	}
+}
+
+/**
+  * @brief: add name to the in memory copy only, a block is started once the
+  *         last one is full instead of moving what's there
+  */
+static uint32_t dictionary_add(Dictionary* dictionary, const char* name, uint32_t length) {
+	uint32_t code = dictionary->num_entries;
+	if (code % DICTIONARY_BLOCK_ENTRIES == 0) {
+		dictionary->entries[code / DICTIONARY_BLOCK_ENTRIES] =
+			malloc(DICTIONARY_BLOCK_ENTRIES * sizeof(DictionaryEntry));
+	}
+	if (dictionary->num_name_blocks == 0 || dictionary->names_used + length + 1 > DICTIONARY_NAMES_BLOCK) {
+		dictionary->name_blocks = realloc(dictionary->name_blocks,
+				(dictionary->num_name_blocks + 1) * sizeof(char*));
+		dictionary->name_blocks[dictionary->num_name_blocks++] = malloc(DICTIONARY_NAMES_BLOCK);
+		dictionary->names_used = 0;
+	}
+	char* copy = dictionary->name_blocks[dictionary->num_name_blocks - 1] + dictionary->names_used;
+	memcpy(copy, name, length);
+	copy[length] = '\0';
+	dictionary->names_used += length + 1;
+	DictionaryEntry* entry = dictionary_entry(dictionary, code);
+	entry->name = copy;
+	entry->length = length;
+	dictionary->num_entries++;
+
+	if (dictionary->num_entries * 2 > dictionary->num_slots) {
+		dictionary_grow(dictionary);
+	}
+	else {
+		dictionary->slots[dictionary_slot(dictionary, name, length)] = code;
+	}
+	return code;
+}
+
+static Dictionary* dictionary_new(Pager* pager, uint32_t first_page) {
+	Dictionary* dictionary = malloc(sizeof(Dictionary));
+	dictionary->pager = pager;
+	dictionary->first_page = first_page;
+	dictionary->last_page = first_page;
+	dictionary->last_page_used = DICTIONARY_HEADER_SIZE;
+	dictionary->num_entries = 0;
+	dictionary->name_blocks = NULL;
+	dictionary->num_name_blocks = 0;
+	dictionary->names_used = 0;
+	dictionary->slots = NULL;
+	dictionary->num_slots = 0;
+	dictionary_grow(dictionary);
+	return dictionary;
+}
+
+/**
+  * @brief: empty page of a dictionary
+  */
+static void dictionary_initialize_page(void* page) {
+	memset(page, 0, PAGE_SIZE);
+}
+
+/**
+  * @brief: new empty dictionary with its first page allocated
+  */
+Dictionary* dictionary_create(Pager* pager) {
+	uint32_t first_page = pager_allocate_page(pager);
+	dictionary_initialize_page(get_page_for_write(pager, first_page));
+	return dictionary_new(pager, first_page);
+}
+
+/**
+  * @brief: load a dictionary written before, following its pages
+  */
+Dictionary* dictionary_open(Pager* pager, uint32_t first_page) {
+	Dictionary* dictionary = dictionary_new(pager, first_page);
+	uint32_t page_num = first_page;
+	while (page_num != 0) {
+		void* page = get_page(pager, page_num);
+		uint32_t num_entries;
+		memcpy(&num_entries, page + DICTIONARY_NUM_ENTRIES_OFFSET, sizeof(uint32_t));
+		uint32_t used = DICTIONARY_HEADER_SIZE;
+		for (uint32_t i = 0; i < num_entries; ++i) {
+			uint8_t length = *((uint8_t*)(page + used));
+			dictionary_add(dictionary, page + used + 1, length);
+			used += 1 + length;
+		}
+		dictionary->last_page = page_num;
+		dictionary->last_page_used = used;
+		memcpy(&page_num, page + DICTIONARY_NEXT_PAGE_OFFSET, sizeof(uint32_t));
+	}
+	return dictionary;
+}
+
+/**
+  * @brief: code of a name, DICTIONARY_NONE if no row has it
+  */
+uint32_t dictionary_lookup(Dictionary* dictionary, const char* name, uint32_t length) {
+	return dictionary->slots[dictionary_slot(dictionary, name, length)];
+}
+
+/**
+  * @brief: code of a name, a new name is added at the end of the last page,
+  *         or of a new page linked after it once it's full
+  */
+uint32_t dictionary_encode(Dictionary* dictionary, const char* name, uint32_t length) {
+	uint32_t code = dictionary_lookup(dictionary, name, length);
+	if (code != DICTIONARY_NONE) {
+		return code;
+	}
+	if (dictionary->num_entries == DICTIONARY_MAX_ENTRIES) {
+		printf("Company dictionary is full.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Pager* pager = dictionary->pager;
+	if (dictionary->last_page_used + 1 + length > PAGE_SIZE) {
+		uint32_t new_page_num = pager_allocate_page(pager);
+		dictionary_initialize_page(get_page_for_write(pager, new_page_num));
+		void* last = get_page_for_write(pager, dictionary->last_page);
+		memcpy(last + DICTIONARY_NEXT_PAGE_OFFSET, &new_page_num, sizeof(uint32_t));
+		dictionary->last_page = new_page_num;
+		dictionary->last_page_used = DICTIONARY_HEADER_SIZE;
+	}
+	void* page = get_page_for_write(pager, dictionary->last_page);
+	uint32_t num_entries;
+	memcpy(&num_entries, page + DICTIONARY_NUM_ENTRIES_OFFSET, sizeof(uint32_t));
+	num_entries++;
+	memcpy(page + DICTIONARY_NUM_ENTRIES_OFFSET, &num_entries, sizeof(uint32_t));
+	*((uint8_t*)(page + dictionary->last_page_used)) = (uint8_t)length;
+	memcpy(page + dictionary->last_page_used + 1, name, length);
+	dictionary->last_page_used += 1 + length;
+
+	return dictionary_add(dictionary, name, length);
+}
+
+/**
+  * @brief: name of a code
+  */
+const char* dictionary_name(Dictionary* dictionary, uint32_t code) {
+	return dictionary_entry(dictionary, code)->name;
+}
+
+/**
+  * @brief: free the in memory copy
+  */
+void dictionary_close(Dictionary* dictionary) {
+	for (uint32_t code = 0; code < dictionary->num_entries; code += DICTIONARY_BLOCK_ENTRIES) {
+		free(dictionary->entries[code / DICTIONARY_BLOCK_ENTRIES]);
+	}
+	for (uint32_t i = 0; i < dictionary->num_name_blocks; ++i) {
+		free(dictionary->name_blocks[i]);
+	}
+	free(dictionary->name_blocks);
+	free(dictionary->slots);
+	free(dictionary);
+}
@@ -0,0 +1,319 @@
+#include "../inc/spdbutil.h"
+
+static const uint32_t HASH_INDEX_NEXT_PAGE_OFFSET = 0;
+static const uint32_t HASH_INDEX_NUM_BUCKETS_OFFSET = 4;
+static const uint32_t HASH_INDEX_NUM_ENTRIES_OFFSET = 4;
+static const uint32_t HASH_INDEX_HEADER_SIZE = 8;
+
+/* an entry of a bucket page */
+typedef struct {
+	uint32_t hash;
+	uint32_t key;
+} HashIndexEntry;
+
+/**
+  * @brief: FNV-1a of the name
+  */
+uint32_t hashindex_hash(const char* name, uint32_t length) {
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < length; ++i) {
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+  * @brief: largest power of two not above the number of buckets, buckets
+  *         below the split one use twice as many bits of the hash
+  */
+static uint32_t hashindex_level_size(HashIndex* index) {
+	uint32_t size = 1;
+	while (size * 2 <= index->num_buckets) {
+		size *= 2;
+	}
+	return size;
+}
+
+/**
+  * @brief: bucket a hash belongs to
+  */
+static uint32_t hashindex_bucket(HashIndex* index, uint32_t hash) {
+	uint32_t size = hashindex_level_size(index);
+	uint32_t bucket = hash & (size * 2 - 1);
+	if (bucket >= index->num_buckets) {
+		bucket = hash & (size - 1);
+	}
+	return bucket;
+}
+
+/**
+  * @brief: empty bucket page
+  */
+static void hashindex_initialize_bucket(void* page) {
+	memset(page, 0, PAGE_SIZE);
+}
+
+/**
+  * @brief: add a bucket at the end, writing its page number to the
+  *         directory, which gets a new page once the last one is full
+  */
+static void hashindex_add_bucket(HashIndex* index, uint32_t bucket_page) {
+	Pager* pager = index->pager;
+	if (index->num_buckets == index->buckets_capacity) {
+		index->buckets_capacity = index->buckets_capacity ? index->buckets_capacity * 2 : 64;
+		index->buckets = realloc(index->buckets, index->buckets_capacity * sizeof(uint32_t));
+	}
+	if (index->num_buckets == index->num_directory_pages * HASH_INDEX_BUCKETS_PER_PAGE) {
+		uint32_t page_num = pager_allocate_page(pager);
+		memset(get_page_for_write(pager, page_num), 0, PAGE_SIZE);
+		if (index->num_directory_pages > 0) {
+			void* last = get_page_for_write(pager, index->directory[index->num_directory_pages - 1]);
+			memcpy(last + HASH_INDEX_NEXT_PAGE_OFFSET, &page_num, sizeof(uint32_t));
+		}
+		index->directory = realloc(index->directory,
+				(index->num_directory_pages + 1) * sizeof(uint32_t));
+		index->directory[index->num_directory_pages++] = page_num;
+	}
+	uint32_t bucket = index->num_buckets++;
+	index->buckets[bucket] = bucket_page;
+
+	void* page = get_page_for_write(pager, index->directory[bucket / HASH_INDEX_BUCKETS_PER_PAGE]);
+	memcpy(page + HASH_INDEX_HEADER_SIZE + (bucket % HASH_INDEX_BUCKETS_PER_PAGE) * sizeof(uint32_t),
+			&bucket_page, sizeof(uint32_t));
+	page = get_page_for_write(pager, index->directory[0]);
+	memcpy(page + HASH_INDEX_NUM_BUCKETS_OFFSET, &index->num_buckets, sizeof(uint32_t));
+}
+
+static HashIndex* hashindex_new(Pager* pager, uint32_t first_page) {
+	HashIndex* index = malloc(sizeof(HashIndex));
+	index->pager = pager;
+	index->first_page = first_page;
+	index->directory = NULL;
+	index->num_directory_pages = 0;
+	index->buckets = NULL;
+	index->num_buckets = 0;
+	index->buckets_capacity = 0;
+	return index;
+}
+
+/**
+  * @brief: new index with one empty bucket
+  */
+HashIndex* hashindex_create(Pager* pager) {
+	HashIndex* index = hashindex_new(pager, 0);
+	uint32_t bucket_page = pager_allocate_page(pager);
+	hashindex_initialize_bucket(get_page_for_write(pager, bucket_page));
+	hashindex_add_bucket(index, bucket_page);
+	index->first_page = index->directory[0];
+	return index;
+}
+
+/**
+  * @brief: load an index written before, following its directory pages
+  */
+HashIndex* hashindex_open(Pager* pager, uint32_t first_page) {
+	HashIndex* index = hashindex_new(pager, first_page);
+	void* page = get_page(pager, first_page);
+	uint32_t num_buckets;
+	memcpy(&num_buckets, page + HASH_INDEX_NUM_BUCKETS_OFFSET, sizeof(uint32_t));
+	index->buckets_capacity = num_buckets;
+	index->buckets = malloc(num_buckets * sizeof(uint32_t));
+
+	uint32_t page_num = first_page;
+	while (page_num != 0) {
+		index->directory = realloc(index->directory,
+				(index->num_directory_pages + 1) * sizeof(uint32_t));
+		index->directory[index->num_directory_pages++] = page_num;
+		page = get_page(pager, page_num);
+		uint32_t count = num_buckets - index->num_buckets;
+		if (count > HASH_INDEX_BUCKETS_PER_PAGE) {
+			count = HASH_INDEX_BUCKETS_PER_PAGE;
+		}
+		memcpy(index->buckets + index->num_buckets, page + HASH_INDEX_HEADER_SIZE,
+				count * sizeof(uint32_t));
+		index->num_buckets += count;
+		memcpy(&page_num, page + HASH_INDEX_NEXT_PAGE_OFFSET, sizeof(uint32_t));
+	}
+	return index;
+}
+
+/**
+  * @brief: every entry and page of the bucket starting at page_num, arrays
+  *         are malloc'd for the caller to free
+  */
+static uint32_t hashindex_read_bucket(HashIndex* index, uint32_t page_num,
+		HashIndexEntry** entries, uint32_t** pages, uint32_t* num_pages) {
+	uint32_t num_entries = 0;
+	uint32_t entries_capacity = HASH_INDEX_ENTRIES_PER_PAGE;
+	*entries = malloc(entries_capacity * sizeof(HashIndexEntry));
+	*num_pages = 0;
+	uint32_t pages_capacity = 4;
+	*pages = malloc(pages_capacity * sizeof(uint32_t));
+	while (page_num != 0) {
+		if (*num_pages == pages_capacity) {
+			pages_capacity *= 2;
+			*pages = realloc(*pages, pages_capacity * sizeof(uint32_t));
+		}
+		(*pages)[(*num_pages)++] = page_num;
+		void* page = get_page(index->pager, page_num);
+		uint32_t count;
+		memcpy(&count, page + HASH_INDEX_NUM_ENTRIES_OFFSET, sizeof(uint32_t));
+		if (num_entries + count > entries_capacity) {
+			entries_capacity = (num_entries + count) * 2;
+			*entries = realloc(*entries, entries_capacity * sizeof(HashIndexEntry));
+		}
+		memcpy(*entries + num_entries, page + HASH_INDEX_HEADER_SIZE, count * sizeof(HashIndexEntry));
+		num_entries += count;
+		memcpy(&page_num, page + HASH_INDEX_NEXT_PAGE_OFFSET, sizeof(uint32_t));
+	}
+	return num_entries;
+}
+
+/**
+  * @brief: write entries as a new chain of pages, taking them from spare
+  *         first and allocating the rest
+  * @return: first page of the chain
+  */
+static uint32_t hashindex_write_bucket(HashIndex* index, HashIndexEntry* entries,
+		uint32_t num_entries, uint32_t* spare, uint32_t num_spare, uint32_t* spare_used) {
+	uint32_t num_pages = (num_entries + HASH_INDEX_ENTRIES_PER_PAGE - 1) / HASH_INDEX_ENTRIES_PER_PAGE;
+	if (num_pages == 0) {
+		num_pages = 1;
+	}
+	uint32_t* pages = malloc(num_pages * sizeof(uint32_t));
+	for (uint32_t i = 0; i < num_pages; ++i) {
+		pages[i] = *spare_used < num_spare ? spare[(*spare_used)++] : pager_allocate_page(index->pager);
+	}
+	for (uint32_t i = 0; i < num_pages; ++i) {
+		void* page = get_page_for_write(index->pager, pages[i]);
+		hashindex_initialize_bucket(page);
+		uint32_t next_page = i + 1 < num_pages ? pages[i + 1] : 0;
+		uint32_t count = num_entries - i * HASH_INDEX_ENTRIES_PER_PAGE;
+		if (count > HASH_INDEX_ENTRIES_PER_PAGE) {
+			count = HASH_INDEX_ENTRIES_PER_PAGE;
+		}
+		memcpy(page + HASH_INDEX_NEXT_PAGE_OFFSET, &next_page, sizeof(uint32_t));
+		memcpy(page + HASH_INDEX_NUM_ENTRIES_OFFSET, &count, sizeof(uint32_t));
+		memcpy(page + HASH_INDEX_HEADER_SIZE, entries + i * HASH_INDEX_ENTRIES_PER_PAGE,
+				count * sizeof(HashIndexEntry));
+	}
+	uint32_t first_page = pages[0];
+	free(pages);
+	return first_page;
+}
+
+/**
+  * @brief: split the next bucket in turn into itself and a new bucket, by
+  *         one more bit of the hash. The pages of the old chain are reused
+  *         for both, the two never need more than one page besides them
+  */
+static void hashindex_split(HashIndex* index) {
+	uint32_t size = hashindex_level_size(index);
+	uint32_t bucket = index->num_buckets - size;
+
+	HashIndexEntry* entries;
+	uint32_t* pages;
+	uint32_t num_pages;
+	uint32_t num_entries = hashindex_read_bucket(index, index->buckets[bucket], &entries, &pages,
+			&num_pages);
+	// entries staying go to the front, the ones moving to the back
+	HashIndexEntry* moving = malloc((num_entries ? num_entries : 1) * sizeof(HashIndexEntry));
+	uint32_t num_staying = 0;
+	uint32_t num_moving = 0;
+	for (uint32_t i = 0; i < num_entries; ++i) {
+		if (entries[i].hash & size) {
+			moving[num_moving++] = entries[i];
+		}
+		else {
+			entries[num_staying++] = entries[i];
+		}
+	}
+
+	uint32_t spare_used = 0;
+	index->buckets[bucket] = hashindex_write_bucket(index, entries, num_staying, pages, num_pages,
+			&spare_used);
+	uint32_t new_page = hashindex_write_bucket(index, moving, num_moving, pages, num_pages,
+			&spare_used);
+	// the first page of a chain is read first and always reused as the first
+	// page again, the directory only changes for the new bucket
+	hashindex_add_bucket(index, new_page);
+
+	free(entries);
+	free(moving);
+	free(pages);
+}
+
+/**
+  * @brief: add the key of a row to the first page of its bucket, a full
+  *         first page is moved out to a new overflow page behind it, which
+  *         splits the next bucket in turn
+  */
+void hashindex_insert(HashIndex* index, uint32_t hash, uint32_t key) {
+	Pager* pager = index->pager;
+	uint32_t page_num = index->buckets[hashindex_bucket(index, hash)];
+	void* page = get_page_for_write(pager, page_num);
+	uint32_t num_entries;
+	memcpy(&num_entries, page + HASH_INDEX_NUM_ENTRIES_OFFSET, sizeof(uint32_t));
+
+	bool overflowed = false;
+	if (num_entries == HASH_INDEX_ENTRIES_PER_PAGE) {
+		uint8_t full[PAGE_SIZE];
+		memcpy(full, page, PAGE_SIZE);
+		uint32_t overflow_page = pager_allocate_page(pager);
+		memcpy(get_page_for_write(pager, overflow_page), full, PAGE_SIZE);
+		page = get_page_for_write(pager, page_num);
+		hashindex_initialize_bucket(page);
+		memcpy(page + HASH_INDEX_NEXT_PAGE_OFFSET, &overflow_page, sizeof(uint32_t));
+		num_entries = 0;
+		overflowed = true;
+	}
+	HashIndexEntry entry = {hash, key};
+	memcpy(page + HASH_INDEX_HEADER_SIZE + num_entries * sizeof(HashIndexEntry), &entry,
+			sizeof(HashIndexEntry));
+	num_entries++;
+	memcpy(page + HASH_INDEX_NUM_ENTRIES_OFFSET, &num_entries, sizeof(uint32_t));
+
+	if (overflowed) {
+		hashindex_split(index);
+	}
+}
+
+/**
+  * @brief: keys stored with a hash, read from the pages of its bucket
+  */
+uint32_t hashindex_find(HashIndex* index, uint32_t hash, uint32_t** keys) {
+	uint32_t num_keys = 0;
+	uint32_t keys_capacity = 16;
+	*keys = malloc(keys_capacity * sizeof(uint32_t));
+	uint32_t page_num = index->buckets[hashindex_bucket(index, hash)];
+	while (page_num != 0) {
+		void* page = get_page(index->pager, page_num);
+		uint32_t num_entries;
+		memcpy(&num_entries, page + HASH_INDEX_NUM_ENTRIES_OFFSET, sizeof(uint32_t));
+		for (uint32_t i = 0; i < num_entries; ++i) {
+			HashIndexEntry entry;
+			memcpy(&entry, page + HASH_INDEX_HEADER_SIZE + i * sizeof(HashIndexEntry),
+					sizeof(HashIndexEntry));
+			if (entry.hash != hash) {
+				continue;
+			}
+			if (num_keys == keys_capacity) {
+				keys_capacity *= 2;
+				*keys = realloc(*keys, keys_capacity * sizeof(uint32_t));
+			}
+			(*keys)[num_keys++] = entry.key;
+		}
+		memcpy(&page_num, page + HASH_INDEX_NEXT_PAGE_OFFSET, sizeof(uint32_t));
+	}
+	return num_keys;
+}
+
+/**
+  * @brief: free the in memory copy
+  */
+void hashindex_close(HashIndex* index) {
+	free(index->directory);
+	free(index->buckets);
+	free(index);
+}
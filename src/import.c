@@ -0,0 +1,237 @@
+#include <time.h>
+
+#include "../inc/spdbutil.h"
+#include "../inc/import.h"
+
+/* state carried from one line to the next while importing */
+typedef struct {
+	Table* table;
+	ImportStats* stats;
+	uint64_t line_num;
+	char delimiter;  // 0 until the first line is seen
+	uint8_t* cell;  // row being built, LEAF_NODE_CELL_SIZE bytes
+} Importer;
+
+/**
+  * @brief: parse a whole field as unsigned number, by hand as this runs for
+  *         every field of every row and doesn't need strtoul()'s generality
+  */
+static bool import_parse_uint32(const char* field, uint32_t* value) {
+	if (*field == '\0') {
+		return false;
+	}
+	uint64_t parsed = 0;
+	for (; *field != '\0'; ++field) {
+		if (*field < '0' || *field > '9') {
+			return false;
+		}
+		parsed = parsed * 10 + (uint64_t)(*field - '0');
+		if (parsed > UINT32_MAX) {
+			return false;
+		}
+	}
+	*value = (uint32_t)parsed;
+	return true;
+}
+
+/**
+  * @brief: cut the next field off line in place and NUL terminate it. A field
+  *         starting with a double quote runs to the closing quote, "" inside
+  *         it is a literal quote and is unescaped in place
+  * @return: start of field, NULL if line has no more fields
+  */
+static char* import_next_field(char** line, char delimiter) {
+	char* field = *line;
+	if (field == NULL) {
+		return NULL;
+	}
+	if (*field != '"') {
+		char* end = strchr(field, delimiter);
+		if (end == NULL) {
+			*line = NULL;
+		}
+		else {
+			*end = '\0';
+			*line = end + 1;
+		}
+		return field;
+	}
+
+	char* read = field + 1;
+	char* write = field;
+	while (*read != '\0') {
+		if (*read == '"') {
+			if (read[1] == '"') {
+				*write++ = '"';
+				read += 2;
+				continue;
+			}
+			++read;  // closing quote
+			break;
+		}
+		*write++ = *read++;
+	}
+	*write = '\0';
+	if (*read == delimiter) {
+		*line = read + 1;
+	}
+	else {
+		*line = NULL;  // end of line, or junk after closing quote which is dropped
+	}
+	return field;
+}
+
+static void import_bad_line(Importer* importer, const char* reason) {
+	importer->stats->bad_lines++;
+	if (importer->stats->bad_lines <= IMPORT_MAX_ERRORS_SHOWN) {
+		printf("Line %lu: %s, skipped.\n", (unsigned long)importer->line_num, reason);
+	}
+}
+
+/**
+  * @brief: parse one line(NUL terminated, no newline) straight into the
+  *         serialized layout serialize_row() would produce, and append it
+  */
+static void import_line(Importer* importer, char* line) {
+	importer->line_num++;
+	size_t length = strlen(line);
+	if (length > 0 && line[length - 1] == '\r') {
+		line[--length] = '\0';
+	}
+	if (length == 0) {
+		return;
+	}
+	if (importer->delimiter == 0) {
+		importer->delimiter = strchr(line, '\t') ? '\t' : ',';
+	}
+
+	char* sl_no = import_next_field(&line, importer->delimiter);
+	char* year = import_next_field(&line, importer->delimiter);
+	char* company = import_next_field(&line, importer->delimiter);
+	char* model = import_next_field(&line, importer->delimiter);
+	char* power = import_next_field(&line, importer->delimiter);
+
+	uint32_t key;
+	if (!import_parse_uint32(sl_no, &key)) {
+		// a first line with words in it is a header
+		if (importer->line_num == 1) {
+			return;
+		}
+		import_bad_line(importer, "sl_no is not a number");
+		return;
+	}
+	if (power == NULL || line != NULL) {
+		import_bad_line(importer, "expected 5 fields");
+		return;
+	}
+	uint32_t year_value;
+	char* power_end;
+	double power_value = strtod(power, &power_end);
+	if (!import_parse_uint32(year, &year_value) || *power == '\0' || *power_end != '\0') {
+		import_bad_line(importer, "year or power is not a number");
+		return;
+	}
+	size_t company_length = strlen(company);
+	size_t model_length = strlen(model);
+	if (company_length > COLUMN_COMPANY_NAME || model_length > COLUMN_MODEL_NAME) {
+		import_bad_line(importer, "string is too long");
+		return;
+	}
+
+	uint8_t* cell = importer->cell;
+	memset(cell, 0, LEAF_NODE_CELL_SIZE);
+	memcpy(cell + SLNO_OFFSET, &key, SLNO_SIZE);
+	memcpy(cell + YEAR_OFFSET, &year_value, YEAR_SIZE);
+	memcpy(cell + COMPANY_OFFSET, company, company_length);
+	memcpy(cell + MODEL_OFFSET, model, model_length);
+	memcpy(cell + POWER_OFFSET, &power_value, POWER_SIZE);
+
+	if (btree_append(importer->table, key, cell) == BTREE_DUPLICATE_KEY) {
+		importer->stats->duplicates++;
+		return;
+	}
+	importer->stats->imported++;
+}
+
+/**
+  * @brief: bulk load rows from a CSV or tab separated file. File is read in
+  *         IMPORT_CHUNK_SIZE chunks with plain read(), every complete line in
+  *         the chunk is parsed in place and what's left of the last line is
+  *         moved to the front for the next read. A line longer than a whole
+  *         chunk is skipped
+  */
+int import_file(Table* table, const char* filename, ImportStats* stats) {
+	int file_desc = open(filename, O_RDONLY);
+	if (file_desc == -1) {
+		return -1;
+	}
+	memset(stats, 0, sizeof(ImportStats));
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	Importer importer;
+	importer.table = table;
+	importer.stats = stats;
+	importer.line_num = 0;
+	importer.delimiter = 0;
+	importer.cell = malloc(LEAF_NODE_CELL_SIZE);
+
+	char* buffer = malloc(IMPORT_CHUNK_SIZE + 1);
+	size_t carry = 0;  // bytes of an unfinished line at the front of buffer
+	bool skipping = false;  // in the middle of a line too long for the buffer
+	while (true) {
+		ssize_t bytes_read = read(file_desc, buffer + carry, IMPORT_CHUNK_SIZE - carry);
+		if (bytes_read == -1) {
+			free(buffer);
+			free(importer.cell);
+			close(file_desc);
+			return -1;
+		}
+		size_t length = carry + bytes_read;
+		// rows of a chunk are one write, readers see the whole chunk or none of it
+		pager_begin_write(table->pager);
+		if (bytes_read == 0) {
+			// last line without a newline
+			if (length > 0 && !skipping) {
+				buffer[length] = '\0';
+				import_line(&importer, buffer);
+			}
+			break;
+		}
+
+		char* line = buffer;
+		char* end = buffer + length;
+		char* newline;
+		while ((newline = memchr(line, '\n', end - line)) != NULL) {
+			*newline = '\0';
+			if (skipping) {
+				skipping = false;
+				importer.line_num++;
+				import_bad_line(&importer, "line is too long");
+			}
+			else {
+				import_line(&importer, line);
+			}
+			line = newline + 1;
+		}
+		carry = end - line;
+		if (carry == IMPORT_CHUNK_SIZE) {
+			skipping = true;
+			carry = 0;
+		}
+		memmove(buffer, line, carry);
+		pager_commit(table->pager);
+		pager_end_write(table->pager);
+	}
+	pager_commit(table->pager);
+	pager_end_write(table->pager);
+
+	struct timespec finish;
+	clock_gettime(CLOCK_MONOTONIC, &finish);
+	stats->seconds = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9;
+
+	free(buffer);
+	free(importer.cell);
+	close(file_desc);
+	return 0;
+}
@@ -0,0 +1,230 @@
+#include "../inc/spdbutil.h"
+
+#ifdef __linux__
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/**
+ * Structure of IoRing
+ *
+ * the submission and completion rings shared with the kernel. The kernel
+ * moves the submission head and the completion tail, this side the other
+ * two, so either side reads what the other moved with acquire and
+ * publishes its own move with release
+ */
+struct IoRing {
+	int file_descriptor;
+	uint32_t entries;
+	uint32_t to_submit;  // queued since the last ioring_submit()
+
+	uint32_t* sq_head;
+	uint32_t* sq_tail;
+	uint32_t* sq_mask;
+	uint32_t* sq_array;
+	struct io_uring_sqe* sqes;
+
+	uint32_t* cq_head;
+	uint32_t* cq_tail;
+	uint32_t* cq_mask;
+	struct io_uring_cqe* cqes;
+
+	void* sq_ring;
+	size_t sq_ring_size;
+	void* cq_ring;  // same as sq_ring when the kernel maps both at once
+	size_t cq_ring_size;
+	size_t sqes_size;
+};
+
+/**
+  * @brief: map the rings of a ring just set up, false if it can't be
+  */
+static bool ioring_map(IoRing* ring, const struct io_uring_params* params) {
+	ring->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(uint32_t);
+	ring->cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+	bool single = params->features & IORING_FEAT_SINGLE_MMAP;
+	if (single && ring->cq_ring_size > ring->sq_ring_size) {
+		ring->sq_ring_size = ring->cq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->file_descriptor, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		return false;
+	}
+	ring->cq_ring = ring->sq_ring;
+	if (!single) {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->file_descriptor, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			munmap(ring->sq_ring, ring->sq_ring_size);
+			return false;
+		}
+	}
+	ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->file_descriptor, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		if (!single) {
+			munmap(ring->cq_ring, ring->cq_ring_size);
+		}
+		munmap(ring->sq_ring, ring->sq_ring_size);
+		return false;
+	}
+
+	uint8_t* sq = ring->sq_ring;
+	ring->sq_head = (uint32_t*)(sq + params->sq_off.head);
+	ring->sq_tail = (uint32_t*)(sq + params->sq_off.tail);
+	ring->sq_mask = (uint32_t*)(sq + params->sq_off.ring_mask);
+	ring->sq_array = (uint32_t*)(sq + params->sq_off.array);
+	uint8_t* cq = ring->cq_ring;
+	ring->cq_head = (uint32_t*)(cq + params->cq_off.head);
+	ring->cq_tail = (uint32_t*)(cq + params->cq_off.tail);
+	ring->cq_mask = (uint32_t*)(cq + params->cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+	return true;
+}
+
+/**
+  * @brief: whether the kernel has IORING_OP_READ. Rings can be set up from
+  *         5.1 but plain reads only came in 5.6, along with the probe, so a
+  *         kernel which can't be probed can't read either
+  */
+static bool ioring_supports_read(int file_descriptor) {
+	size_t size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe* probe = calloc(1, size);
+	bool supported = syscall(__NR_io_uring_register, file_descriptor, IORING_REGISTER_PROBE, probe,
+			IORING_OP_LAST) == 0
+		&& probe->last_op >= IORING_OP_READ
+		&& (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	return supported;
+}
+
+IoRing* ioring_open(uint32_t entries) {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int file_descriptor = syscall(__NR_io_uring_setup, entries, &params);
+	if (file_descriptor == -1) {
+		return NULL;
+	}
+	if (!ioring_supports_read(file_descriptor)) {
+		close(file_descriptor);
+		return NULL;
+	}
+	IoRing* ring = malloc(sizeof(IoRing));
+	ring->file_descriptor = file_descriptor;
+	ring->entries = params.sq_entries;
+	ring->to_submit = 0;
+	if (!ioring_map(ring, &params)) {
+		close(file_descriptor);
+		free(ring);
+		return NULL;
+	}
+	return ring;
+}
+
+uint32_t ioring_entries(const IoRing* ring) {
+	return ring->entries;
+}
+
+bool ioring_queue_read(IoRing* ring, int file_descriptor, void* buffer, uint32_t length,
+		off_t offset, uint64_t user_data) {
+	uint32_t tail = *ring->sq_tail;
+	if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries) {
+		return false;
+	}
+	uint32_t index = tail & *ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = file_descriptor;
+	sqe->addr = (uint64_t)(uintptr_t)buffer;
+	sqe->len = length;
+	sqe->off = offset;
+	sqe->user_data = user_data;
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->to_submit++;
+	return true;
+}
+
+/**
+  * @brief: hand queued reads to the kernel and wait for min_complete
+  *         completions, a call cut short by a signal is made again
+  */
+static void ioring_enter(IoRing* ring, uint32_t min_complete) {
+	uint32_t flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+	while (ring->to_submit > 0 || min_complete > 0) {
+		int submitted = syscall(__NR_io_uring_enter, ring->file_descriptor, ring->to_submit,
+				min_complete, flags, NULL, 0);
+		if (submitted == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			printf("Error submitting reads: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		ring->to_submit -= submitted;
+		min_complete = 0;
+		flags = 0;
+	}
+}
+
+void ioring_submit(IoRing* ring) {
+	ioring_enter(ring, 0);
+}
+
+bool ioring_complete(IoRing* ring, bool wait, uint64_t* user_data, int32_t* result) {
+	uint32_t head = *ring->cq_head;
+	while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		if (!wait) {
+			return false;
+		}
+		ioring_enter(ring, 1);
+	}
+	struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+	*user_data = cqe->user_data;
+	*result = cqe->res;
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+void ioring_close(IoRing* ring) {
+	munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != ring->sq_ring) {
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	}
+	munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->file_descriptor);
+	free(ring);
+}
+
+#else
+
+/* no io_uring, the pager reads ahead with fadvise */
+
+IoRing* ioring_open(uint32_t entries) {
+	return NULL;
+}
+
+uint32_t ioring_entries(const IoRing* ring) {
+	return 0;
+}
+
+bool ioring_queue_read(IoRing* ring, int file_descriptor, void* buffer, uint32_t length,
+		off_t offset, uint64_t user_data) {
+	return false;
+}
+
+void ioring_submit(IoRing* ring) {
+}
+
+bool ioring_complete(IoRing* ring, bool wait, uint64_t* user_data, int32_t* result) {
+	return false;
+}
+
+void ioring_close(IoRing* ring) {
+}
+
+#endif
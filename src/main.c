@@ -1,81 +1,380 @@
 #include <stdio.h>
 #include "../inc/spdbutil.h"
+#include "../inc/prepared.h"
+#include "../inc/server.h"
+
+#define SCRIPT_MAX_DEPTH 16  // .read inside scripts nested deeper than this is refused
+
+/**
+ * Structure of Session
+ *
+ * what every statement is run against, set up from the command line
+ */
+typedef struct {
+	Table* table;
+	Output* output;  // select results
+	bool batch;  // no prompt or "Executed.", errors go to stderr
+	StatementCache* statements;  // lines run before, not parsed again
+	char parameters[MAX_PARAMETERS][TOKEN_MAX_LENGTH + 1];  // set by .param for every ?
+	bool parameter_set[MAX_PARAMETERS];
+	uint32_t script_depth;  // .read scripts running, each from the one before
+} Session;
 
 /**
   * @brief: handle the execution of meta commands(queries starting with '.'(dot))
   * @param: created input buffer
+  * @param: session to run .read scripts in
   * @return: status as 0 or 1, whether entered query is meta command or not
   */
-int handle_meta_commands(InputBuffer* input_buffer, Table* table);
+int handle_meta_commands(InputBuffer* input_buffer, Session* session);
+
+/**
+  * @brief: prepare and execute one line of input, meta command or statement
+  * @param: input buffer holding the line
+  * @param: session to run it in
+  */
+void run_line(InputBuffer* input_buffer, Session* session);
+
+/**
+  * @brief: run every line of a file as if typed, without prompts
+  * @param: session to run it in
+  * @param: path of the script
+  */
+void run_script(Session* session, const char* filename);
+
+/**
+  * @brief: set or clear the values given to every ? by the REPL
+  * @param: session the values are for
+  * @param: what follows .param
+  */
+void set_parameter(Session* session, const char* arguments);
+
+/**
+  * @brief: print how to invoke spdb and exit
+  * @param: name of the program, argv[0]
+  */
+void usage(const char* program);
 
 int main(int argc, char **argv) {
-	/* create new input buffer */
-	InputBuffer* input_buffer = new_input_buffer();
-	if (argc < 2) {
+	PagerOptions options;
+	pager_options_init(&options);
+
+	Session session;
+	session.batch = false;
+	session.script_depth = 0;
+	OutputFormat format = OUTPUT_TABLE;
+	LeafLayout layout = LEAF_LAYOUT_SLOTTED;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char* socket_path = NULL;
+	long port = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "bDHj:l:m:Mo:p:s:S:w")) != -1) {
+		switch (opt) {
+			case 'b':
+				// reading a script from stdin, only results are printed
+				session.batch = true;
+				break;
+			case 'D':
+				// read and write the db file around the OS cache, pages are cached in the pool only
+				options.direct_io = true;
+				break;
+			case 'H':
+				// buffer pool on huge pages
+				options.huge_pages = true;
+				break;
+			case 'j':
+				// threads for big scans, 1 scans on the main thread only
+				num_threads = atol(optarg);
+				if (num_threads < 1) {
+					usage(argv[0]);
+				}
+				break;
+			case 'l':
+				// leaf layout of a new file, an existing one keeps its own
+				if (strcmp(optarg, "rows") == 0) {
+					layout = LEAF_LAYOUT_ROWS;
+				}
+				else if (strcmp(optarg, "columns") == 0) {
+					layout = LEAF_LAYOUT_COLUMNS;
+				}
+				else if (strcmp(optarg, "slotted") == 0) {
+					layout = LEAF_LAYOUT_SLOTTED;
+				}
+				else if (strcmp(optarg, "dictionary") == 0) {
+					layout = LEAF_LAYOUT_DICTIONARY;
+				}
+				else {
+					usage(argv[0]);
+				}
+				break;
+			case 'm':
+				// page cache budget in MB
+				options.pool_size = (size_t)atol(optarg) * 1024 * 1024;
+				break;
+			case 'M':
+				// map the file instead of reading pages into the pool
+				options.backend = PAGER_BACKEND_MMAP;
+				break;
+			case 'o':
+				// how select prints rows
+				if (!output_parse_format(optarg, &format)) {
+					usage(argv[0]);
+				}
+				break;
+			case 'p':
+				// also serve TCP clients on localhost, with -S
+				port = atol(optarg);
+				if (port < 1 || port > 65535) {
+					usage(argv[0]);
+				}
+				break;
+			case 'S':
+				// serve clients on a Unix domain socket instead of reading stdin
+				socket_path = optarg;
+				break;
+			case 's':
+				// when commits are synced to the log
+				if (strcmp(optarg, "off") == 0) {
+					options.sync = WAL_SYNC_OFF;
+				}
+				else if (strcmp(optarg, "normal") == 0) {
+					options.sync = WAL_SYNC_NORMAL;
+				}
+				else if (strcmp(optarg, "full") == 0) {
+					options.sync = WAL_SYNC_FULL;
+				}
+				else {
+					usage(argv[0]);
+				}
+				break;
+			case 'w':
+				// no write-ahead log, pages go to db file on eviction and .exit
+				options.use_wal = false;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind >= argc) {
 		printf("Must supply the name of db file.\n");
-		exit(EXIT_FAILURE);
+		usage(argv[0]);
+	}
+	if (port != 0 && socket_path == NULL) {
+		usage(argv[0]);
 	}
 
-	char* filename = *(argv + 1);
-	Table* table = db_open(filename);
+	/* create new input buffer */
+	InputBuffer* input_buffer = new_input_buffer();
+	char* filename = argv[optind];
+	if (session.batch) {
+		// rows are handed over a buffer at a time, let stdio pass them straight on
+		setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+	}
+	session.table = db_open(filename, &options, layout);
+	// every scan thread pins a page at a time, leave the pool room for the rest
+	Pager* pager = session.table->pager;
+	if (pager->backend == PAGER_BACKEND_POOL && num_threads > pager->num_frames / 2) {
+		num_threads = pager->num_frames / 2;
+	}
+	if (num_threads > 1) {
+		// calling thread works too, it's one of the threads
+		session.table->pool = threadpool_open(num_threads - 1);
+	}
+	if (socket_path != NULL) {
+		server_run(session.table, format, socket_path, port);
+		close_input_buffer(input_buffer);
+		db_close(session.table);
+		return 0;
+	}
+	session.output = output_open(stdout, format);
+	session.statements = statement_cache_open(STATEMENT_CACHE_SIZE);
+	for (uint32_t i = 0; i < MAX_PARAMETERS; ++i) {
+		session.parameter_set[i] = false;
+	}
 	while (true) {
 		// read prompt input
-		print_prompt();  // prompt: spdb >
-		read_input(input_buffer);  // take input with InputBuffer
-
-		if (handle_meta_commands(input_buffer, table)) {
-			continue;
+		if (!session.batch) {
+			print_prompt();  // prompt: spdb >
+		}
+		if (!read_input(input_buffer, stdin)) {  // take input with InputBuffer
+			if (!session.batch) {
+				printf("Error reading input\n");
+				/* EXIT_FAILURE -> same as exit(1), representing failure
+				 * EXIT_SUCCESS -> same as exit(0), representing success
+				 * EXIT_SUCCESS, EXIT_FAILURE is std. way as some system actually use 0, 1
+				 * for opposite as said above
+				 * */
+				exit(EXIT_FAILURE);
+			}
+			// end of a script is the same as .exit
+			statement_cache_close(session.statements);
+			output_close(session.output);
+			close_input_buffer(input_buffer);
+			db_close(session.table);
+			break;
 		}
+		run_line(input_buffer, &session);
+	}
+	return 0;
+}
 
-		Statement statement;
-		/* convert input into internal representation of statement, consider it as front-end */
-		switch (prepare_statement(input_buffer, &statement)) {
-			/* compiler may complain if switch statement doesn't handle
-			 * every member of enum, so handling every member */
-			case (PREPARE_SUCCESS):
-				break;
-			case (PREPARE_STRING_TOO_LONG):
-				printf("Entered string is too long.\n");
-				break;
-			case (PREPARE_SYNTAX_ERROR):
-				printf("Syntax Error. Couldn't parse the statement.\n");
+/**
+  * @brief: prepare and execute one line of input, meta command or statement
+  */
+void run_line(InputBuffer* input_buffer, Session* session) {
+	FILE* messages = session->batch ? stderr : stdout;
+	if (handle_meta_commands(input_buffer, session)) {
+		return;
+	}
+
+	/* convert input into internal representation of statement, consider it as front-end,
+	 * a line seen before is taken from the cache instead */
+	PrepareResult result;
+	PreparedStatement* prepared = statement_cache_prepare(session->statements,
+			input_buffer->buffer, &result);
+	for (uint32_t i = 0; prepared != NULL && i < prepared->parsed.num_parameters; ++i) {
+		if (session->parameter_set[i]) {
+			result = statement_bind_text(prepared, i + 1, session->parameters[i]);
+			if (result != PREPARE_SUCCESS) {
 				break;
-			case (PREPARE_UNRECOGNIZED_STATEMENT):
-				printf("Unrecognized keyword at start of '%s'\n",
-						input_buffer->buffer);
-				continue;
+			}
 		}
-		/* executing the prepared statement, consider this as a simple VM */
-		switch (execute_statement(table, &statement)) {
-			case (EXECUTE_SUCCESS):
+	}
+	switch (result) {
+		/* compiler may complain if switch statement doesn't handle
+		 * every member of enum, so handling every member */
+		case (PREPARE_SUCCESS):
+			break;
+		case (PREPARE_STRING_TOO_LONG):
+			fprintf(messages, "Entered string is too long.\n");
+			return;
+		case (PREPARE_SYNTAX_ERROR):
+			fprintf(messages, "Syntax Error. Couldn't parse the statement.\n");
+			return;
+		case (PREPARE_UNRECOGNIZED_STATEMENT):
+			fprintf(messages, "Unrecognized keyword at start of '%s'\n",
+					input_buffer->buffer);
+			return;
+	}
+	/* executing the prepared statement, consider this as a simple VM */
+	switch (statement_step(session->table, prepared, session->output)) {
+		case (EXECUTE_SUCCESS):
+			if (!session->batch) {
 				printf("Executed.\n");
-				break;
-			case (EXECUTE_TABLE_FULL):
-				printf("Error: Table full.\n");
-				break;
-		}
+			}
+			break;
+		case (EXECUTE_DUPLICATE_KEY):
+			fprintf(messages, "Error: Duplicate key.\n");
+			break;
+		case (EXECUTE_TABLE_FULL):
+			fprintf(messages, "Error: Table full.\n");
+			break;
+		case (EXECUTE_UNBOUND_PARAMETER):
+			fprintf(messages, "Error: No value for a ?, set one with .param set.\n");
+			break;
+		case (EXECUTE_NOT_A_QUERY):
+			fprintf(messages, "Error: Statement returns no rows.\n");
+			break;
 	}
-	return 0;
 }
 
 /**
-  * @brief: handle the execution of meta commands(queries starting with '.'(dot))
+  * @brief: run every line of a file as if typed, without prompts. A script
+  *         may .read others, up to SCRIPT_MAX_DEPTH deep, so one reading
+  *         itself ends with an error instead of the stack running out
   */
-int handle_meta_commands(InputBuffer* input_buffer, Table* table) {
+void run_script(Session* session, const char* filename) {
+	FILE* messages = session->batch ? stderr : stdout;
+	if (session->script_depth >= SCRIPT_MAX_DEPTH) {
+		fprintf(messages, "Error: .read nested more than %d deep, not reading '%s'.\n",
+				SCRIPT_MAX_DEPTH, filename);
+		return;
+	}
+	FILE* script = fopen(filename, "r");
+	if (script == NULL) {
+		fprintf(messages, "Unable to read '%s'.\n", filename);
+		return;
+	}
+	session->script_depth++;
+	InputBuffer* input_buffer = new_input_buffer();
+	while (read_input(input_buffer, script)) {
+		run_line(input_buffer, session);
+	}
+	close_input_buffer(input_buffer);
+	fclose(script);
+	session->script_depth--;
+}
+
+/**
+  * @brief: handle the execution of meta commands(queries starting with '.'(dot)),
+  *         .read is handled here as it runs lines like the main loop does
+  */
+int handle_meta_commands(InputBuffer* input_buffer, Session* session) {
 	/* Non-SQL statements like ".exit" are called meta command, so
 	 * handling them with seperate function
 
 	 * Using enum result codes wherever possible cause exceptions
 	 are bad(and C doesn't support them)
 	 */
+	if (strncmp(input_buffer->buffer, ".read ", 6) == 0) {
+		char* filename = input_buffer->buffer + 6;
+		while (*filename == ' ') {
+			++filename;
+		}
+		run_script(session, filename);
+		return 1;
+	}
+	if (strncmp(input_buffer->buffer, ".param ", 7) == 0) {
+		set_parameter(session, input_buffer->buffer + 7);
+		return 1;
+	}
 	if (input_buffer->buffer[0] == '.') {
-		switch(do_meta_command(input_buffer, table)) {
+		switch(do_meta_command(input_buffer, session->table)) {
 			case (META_COMMAND_SUCCESS):
 				return 1;
 			case (META_COMMAND_UNRECOGNIZED):
-				printf("Unrecognized command '%s'\n", input_buffer->buffer);
+				fprintf(session->batch ? stderr : stdout,
+						"Unrecognized command '%s'\n", input_buffer->buffer);
 				return 1;
 		}
 	}
 	return 0;
 }
+
+/**
+  * @brief: .param set N value gives the N-th ? of the statements run after
+  *         it a value, .param clear takes them all away
+  */
+void set_parameter(Session* session, const char* arguments) {
+	FILE* messages = session->batch ? stderr : stdout;
+	uint32_t index;
+	int length = 0;
+	if (strcmp(arguments, "clear") == 0) {
+		for (uint32_t i = 0; i < MAX_PARAMETERS; ++i) {
+			session->parameter_set[i] = false;
+		}
+		return;
+	}
+	if (sscanf(arguments, "set %u %n", &index, &length) != 1 || length == 0
+			|| index < 1 || index > MAX_PARAMETERS) {
+		fprintf(messages, "Usage: .param set N value, N from 1 to %d, or .param clear\n",
+				MAX_PARAMETERS);
+		return;
+	}
+	if (strlen(arguments + length) > TOKEN_MAX_LENGTH) {
+		fprintf(messages, "Entered string is too long.\n");
+		return;
+	}
+	strcpy(session->parameters[index - 1], arguments + length);
+	session->parameter_set[index - 1] = true;
+}
+
+/**
+  * @brief: print how to invoke spdb and exit
+  */
+void usage(const char* program) {
+	printf("Usage: %s [-b] [-D] [-H] [-j threads] [-l rows|columns|slotted|dictionary] [-m cache_mb] [-M] [-o table|csv|tsv|binary] [-s off|normal|full] [-S socket [-p port]] [-w] <db file>\n",
+			program);
+	exit(EXIT_FAILURE);
+}
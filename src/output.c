@@ -0,0 +1,409 @@
+#include <math.h>
+
+#include "../inc/spdbutil.h"
+
+/* room kept free in the buffer before formatting a row, a row can't need more:
+   two numbers, strings escaped to twice their size and a %f of any double */
+#define OUTPUT_ROW_MAX 1024
+
+/**
+  * @brief: create output writing to stream
+  */
+Output* output_open(FILE* stream, OutputFormat format) {
+	Output* output = malloc(sizeof(Output));
+	output->stream = stream;
+	output->sink = NULL;
+	output->sink_context = NULL;
+	output->format = format;
+	output->buffer = malloc(OUTPUT_BUFFER_SIZE);
+	output->length = 0;
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	return output;
+}
+
+/**
+  * @brief: create output handing its buffer to sink each time it fills
+  */
+Output* output_open_sink(OutputSink sink, void* context, OutputFormat format) {
+	Output* output = output_open(NULL, format);
+	output->sink = sink;
+	output->sink_context = context;
+	return output;
+}
+
+/**
+  * @brief: hand formatted rows to the stream or the sink
+  */
+static void output_write(Output* output, const char* data, size_t length) {
+	if (output->stream == NULL) {
+		output->sink(output->sink_context, data, length);
+		return;
+	}
+	if (fwrite(data, 1, length, output->stream) != length) {
+		printf("Error writing output: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+  * @brief: empty the buffer into the stream or the sink, false if the output
+  *         has neither and keeps everything
+  */
+static bool output_drain(Output* output) {
+	if (output->stream == NULL && output->sink == NULL) {
+		return false;
+	}
+	if (output->length > 0) {
+		output_write(output, output->buffer, output->length);
+		output->length = 0;
+	}
+	return true;
+}
+
+/**
+  * @brief: make room for a row at the end of the buffer, by handing the
+  *         buffer to the stream or the sink or, without either, growing it
+  */
+static void output_reserve(Output* output) {
+	if (output->capacity - output->length >= OUTPUT_ROW_MAX) {
+		return;
+	}
+	if (output_drain(output)) {
+		return;
+	}
+	output->capacity *= 2;
+	output->buffer = realloc(output->buffer, output->capacity);
+}
+
+/**
+  * @brief: parse format name as given to -o
+  */
+bool output_parse_format(const char* name, OutputFormat* format) {
+	if (strcmp(name, "table") == 0) {
+		*format = OUTPUT_TABLE;
+	}
+	else if (strcmp(name, "csv") == 0) {
+		*format = OUTPUT_CSV;
+	}
+	else if (strcmp(name, "tsv") == 0) {
+		*format = OUTPUT_TSV;
+	}
+	else if (strcmp(name, "binary") == 0) {
+		*format = OUTPUT_BINARY;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/**
+  * @brief: write value in decimal at out
+  * @return: position after the last digit
+  */
+static char* output_uint32(char* out, uint32_t value) {
+	char digits[10];
+	int count = 0;
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	while (count > 0) {
+		*out++ = digits[--count];
+	}
+	return out;
+}
+
+/**
+  * @brief: write value the way printf("%f") does, 6 decimals. Values whose
+  *         scaled fraction sits too close to a rounding tie, or that are too
+  *         big to scale into an integer, go through snprintf() so the digits
+  *         always match it exactly
+  * @return: position after the last digit
+  */
+static char* output_double(char* out, double value) {
+	bool negative = value < 0 || (value == 0 && 1 / value < 0);  // -0.0 prints a sign too
+	double magnitude = negative ? -value : value;
+	if (!(magnitude < 1e7)) {
+		return out + snprintf(out, OUTPUT_ROW_MAX / 2, "%f", value);  // also NaN and inf
+	}
+	double scaled = magnitude * 1e6;
+	uint64_t whole = (uint64_t)scaled;
+	double fraction = scaled - (double)whole;
+	// scaled is off by at most half an ulp, under 0.001 below 1e13, so 0.01 is safe
+	if (fraction > 0.49 && fraction < 0.51) {
+		return out + snprintf(out, OUTPUT_ROW_MAX / 2, "%f", value);
+	}
+	if (fraction > 0.5) {
+		++whole;
+	}
+
+	if (negative) {
+		*out++ = '-';
+	}
+	uint64_t integer = whole / 1000000;
+	uint32_t decimals = whole % 1000000;
+	char digits[20];
+	int count = 0;
+	do {
+		digits[count++] = '0' + integer % 10;
+		integer /= 10;
+	} while (integer != 0);
+	while (count > 0) {
+		*out++ = digits[--count];
+	}
+	*out++ = '.';
+	for (int i = 5; i >= 0; --i) {
+		out[i] = '0' + decimals % 10;
+		decimals /= 10;
+	}
+	return out + 6;
+}
+
+/**
+  * @brief: copy a NUL padded string column, quoted for CSV if it has a
+  *         delimiter, quote or line break in it
+  */
+static char* output_csv_string(char* out, const char* text, size_t length) {
+	if (strcspn(text, ",\"\r\n") >= length) {
+		memcpy(out, text, length);
+		return out + length;
+	}
+	*out++ = '"';
+	for (size_t i = 0; i < length; ++i) {
+		if (text[i] == '"') {
+			*out++ = '"';
+		}
+		*out++ = text[i];
+	}
+	*out++ = '"';
+	return out;
+}
+
+/**
+  * @brief: copy a NUL padded string column, escaping what would break a TSV line
+  */
+static char* output_tsv_string(char* out, const char* text, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		switch (text[i]) {
+			case '\t':
+				*out++ = '\\';
+				*out++ = 't';
+				break;
+			case '\n':
+				*out++ = '\\';
+				*out++ = 'n';
+				break;
+			case '\\':
+				*out++ = '\\';
+				*out++ = '\\';
+				break;
+			default:
+				*out++ = text[i];
+		}
+	}
+	return out;
+}
+
+/**
+  * @brief: format a serialized row into the buffer, columns are read straight
+  *         from the row without deserializing it first
+  */
+void output_row(Output* output, void* row) {
+	output_reserve(output);
+	char* out = output->buffer + output->length;
+	if (output->format == OUTPUT_BINARY) {
+		memcpy(out, row, ROW_SIZE);
+		output->length += ROW_SIZE;
+		return;
+	}
+
+	uint32_t sl_no;
+	uint32_t year;
+	double power;
+	memcpy(&sl_no, row + SLNO_OFFSET, SLNO_SIZE);
+	memcpy(&year, row + YEAR_OFFSET, YEAR_SIZE);
+	memcpy(&power, row + POWER_OFFSET, POWER_SIZE);
+	const char* company = row + COMPANY_OFFSET;
+	const char* model = row + MODEL_OFFSET;
+	size_t company_length = strnlen(company, COMPANY_SIZE);
+	size_t model_length = strnlen(model, MODEL_SIZE);
+
+	switch (output->format) {
+		case (OUTPUT_TABLE):
+			*out++ = '(';
+			out = output_uint32(out, sl_no);
+			*out++ = ',';
+			*out++ = ' ';
+			out = output_uint32(out, year);
+			*out++ = ',';
+			*out++ = ' ';
+			memcpy(out, company, company_length);
+			out += company_length;
+			*out++ = ',';
+			*out++ = ' ';
+			memcpy(out, model, model_length);
+			out += model_length;
+			*out++ = ',';
+			*out++ = ' ';
+			out = output_double(out, power);
+			*out++ = ')';
+			break;
+		case (OUTPUT_CSV):
+			out = output_uint32(out, sl_no);
+			*out++ = ',';
+			out = output_uint32(out, year);
+			*out++ = ',';
+			out = output_csv_string(out, company, company_length);
+			*out++ = ',';
+			out = output_csv_string(out, model, model_length);
+			*out++ = ',';
+			out = output_double(out, power);
+			break;
+		case (OUTPUT_TSV):
+			out = output_uint32(out, sl_no);
+			*out++ = '\t';
+			out = output_uint32(out, year);
+			*out++ = '\t';
+			out = output_tsv_string(out, company, company_length);
+			*out++ = '\t';
+			out = output_tsv_string(out, model, model_length);
+			*out++ = '\t';
+			out = output_double(out, power);
+			break;
+		case (OUTPUT_BINARY):
+			break;
+	}
+	*out++ = '\n';
+	output->length = out - output->buffer;
+}
+
+/**
+  * @brief: format a computed row, values are separated the same way as the
+  *         columns of output_row(). Only company comes out as text so no value
+  *         is longer than a row's
+  */
+void output_values(Output* output, Value* values, uint32_t count) {
+	for (uint32_t i = 0; i < count; ++i) {
+		output_reserve(output);
+		char* out = output->buffer + output->length;
+		Value* value = &values[i];
+		if (output->format == OUTPUT_BINARY) {
+			double null_real = NAN;
+			switch (value->type) {
+				case (VALUE_NULL):
+					memcpy(out, &null_real, sizeof(double));
+					out += sizeof(double);
+					break;
+				case (VALUE_INTEGER):
+					memcpy(out, &value->integer, sizeof(uint64_t));
+					out += sizeof(uint64_t);
+					break;
+				case (VALUE_REAL):
+					memcpy(out, &value->real, sizeof(double));
+					out += sizeof(double);
+					break;
+				case (VALUE_TEXT):
+					memset(out, 0, COMPANY_SIZE);
+					memcpy(out, value->text, value->text_length);
+					out += COMPANY_SIZE;
+					break;
+			}
+			output->length = out - output->buffer;
+			continue;
+		}
+
+		if (i == 0 && output->format == OUTPUT_TABLE) {
+			*out++ = '(';
+		}
+		switch (value->type) {
+			case (VALUE_NULL):
+				memcpy(out, "NULL", 4);
+				out += 4;
+				break;
+			case (VALUE_INTEGER):
+				out += sprintf(out, "%llu", (unsigned long long)value->integer);
+				break;
+			case (VALUE_REAL):
+				out = output_double(out, value->real);
+				break;
+			case (VALUE_TEXT):
+				if (output->format == OUTPUT_CSV) {
+					out = output_csv_string(out, value->text, value->text_length);
+				}
+				else if (output->format == OUTPUT_TSV) {
+					out = output_tsv_string(out, value->text, value->text_length);
+				}
+				else {
+					memcpy(out, value->text, value->text_length);
+					out += value->text_length;
+				}
+				break;
+		}
+		if (i + 1 < count) {
+			switch (output->format) {
+				case (OUTPUT_TABLE):
+					*out++ = ',';
+					*out++ = ' ';
+					break;
+				case (OUTPUT_CSV):
+					*out++ = ',';
+					break;
+				case (OUTPUT_TSV):
+				case (OUTPUT_BINARY):
+					*out++ = '\t';
+					break;
+			}
+		}
+		else {
+			if (output->format == OUTPUT_TABLE) {
+				*out++ = ')';
+			}
+			*out++ = '\n';
+		}
+		output->length = out - output->buffer;
+	}
+}
+
+/**
+  * @brief: append what another output has buffered, a big part goes to the
+  *         stream or the sink as it is instead of through the buffer
+  */
+void output_append(Output* output, Output* other) {
+	if (output->capacity - output->length < other->length) {
+		output_drain(output);
+	}
+	if ((output->stream != NULL || output->sink != NULL) && other->length >= output->capacity) {
+		output_write(output, other->buffer, other->length);
+	}
+	else {
+		while (output->capacity - output->length < other->length) {
+			output->capacity *= 2;
+			output->buffer = realloc(output->buffer, output->capacity);
+		}
+		memcpy(output->buffer + output->length, other->buffer, other->length);
+		output->length += other->length;
+	}
+	other->length = 0;
+}
+
+/**
+  * @brief: hand buffered rows to the stream, nothing to do for an output
+  *         without one
+  */
+void output_flush(Output* output) {
+	if (output->length == 0 || output->stream == NULL) {
+		return;
+	}
+	output_write(output, output->buffer, output->length);
+	output->length = 0;
+}
+
+/**
+  * @brief: flush and free output, stream is left open
+  */
+void output_close(Output* output) {
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
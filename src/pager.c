@@ -0,0 +1,1097 @@
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "../inc/spdbutil.h"
+
+#define FRAME_NONE UINT32_MAX  // page_table entry for a page not in the pool
+#define PAGER_WRITE_BATCH 64  // pages checkpoint stages in memory per round of writes
+
+/**
+  * @brief: fill options with default values
+  */
+void pager_options_init(PagerOptions* options) {
+	options->backend = PAGER_BACKEND_POOL;
+	options->pool_size = PAGER_DEFAULT_POOL_SIZE;
+	options->mmap_size = PAGER_DEFAULT_MMAP_SIZE;
+	options->use_wal = true;
+	options->sync = WAL_SYNC_NORMAL;
+	options->checkpoint_frames = WAL_DEFAULT_CHECKPOINT_FRAMES;
+	options->read_ahead = true;
+	options->direct_io = false;
+	options->huge_pages = false;
+}
+
+/**
+  * @brief: page_num's memory if it's resident(in a frame of the pool or
+  *         mapped), NULL otherwise
+  */
+static void* pager_resident_page(Pager* pager, uint32_t page_num) {
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		if (pager->map == NULL || page_num >= pager->file_pages) {
+			return NULL;
+		}
+		return pager->map + (size_t)page_num * PAGE_SIZE;
+	}
+	if (page_num >= pager->page_table_length || pager->page_table[page_num] == FRAME_NONE) {
+		return NULL;
+	}
+	return pager->frames[pager->page_table[page_num]].data;
+}
+
+/**
+  * @brief: sync the database file, skipped with WAL_SYNC_OFF like the log
+  */
+static void pager_sync(Pager* pager) {
+	if (pager->wal->sync == WAL_SYNC_OFF) {
+		return;
+	}
+	if (fdatasync(pager->file_descriptor) == -1) {
+		printf("Error syncing db file: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	stats_add(STAT_SYNC_CALLS, 1);
+}
+
+/**
+  * @brief: write pages to the db file at page_num * PAGE_SIZE, page_nums
+  *         must be sorted. A run of consecutive page numbers is one
+  *         pwritev() of that many iovecs(up to IOV_MAX), so writing back n
+  *         adjacent pages costs one syscall instead of n seeks and writes
+  */
+static void pager_write_runs(Pager* pager, uint32_t* page_nums, void** pages, uint32_t count) {
+	struct iovec iov[IOV_MAX];
+	uint32_t i = 0;
+	while (i < count) {
+		uint32_t run = 1;
+		while (i + run < count && run < IOV_MAX && page_nums[i + run] == page_nums[i] + run) {
+			++run;
+		}
+		for (uint32_t j = 0; j < run; ++j) {
+			iov[j].iov_base = pages[i + j];
+			iov[j].iov_len = PAGE_SIZE;
+		}
+		ssize_t expected = (ssize_t)run * PAGE_SIZE;
+		if (pwritev(pager->file_descriptor, iov, run, (off_t)page_nums[i] * PAGE_SIZE) != expected) {
+			printf("Error writing: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		stats_add(STAT_WRITE_CALLS, 1);
+		stats_add(STAT_BYTES_WRITTEN, expected);
+		if (page_nums[i] + run > pager->file_pages) {
+			pager->file_pages = page_nums[i] + run;
+		}
+		i += run;
+	}
+}
+
+/**
+  * @brief: copy the latest version of every page in the log into the
+  *         database file, sync it and empty the log. The log is synced first
+  *         so a crash half way through checkpoint can be recovered by doing
+  *         it again. Pages in the log are sorted and written in batches with
+  *         adjacent pages coalesced, resident pages are written from memory
+  *         as they're the same as their latest frame once everything is
+  *         committed, others are staged from the log
+  */
+void pager_checkpoint(Pager* pager) {
+	Wal* wal = pager->wal;
+	if (wal->num_frames == 0) {
+		return;
+	}
+	wal_sync(wal);
+
+	qsort(wal->pages, wal->num_pages, sizeof(uint32_t), compare_uint32);
+	// aligned like the frames, the db file may be open with O_DIRECT
+	void* staging;
+	if (posix_memalign(&staging, PAGE_SIZE, PAGER_WRITE_BATCH * PAGE_SIZE) != 0) {
+		printf("Error allocating checkpoint buffer\n");
+		exit(EXIT_FAILURE);
+	}
+	void* pages[PAGER_WRITE_BATCH];
+	for (uint32_t done = 0; done < wal->num_pages; done += PAGER_WRITE_BATCH) {
+		uint32_t batch = wal->num_pages - done;
+		if (batch > PAGER_WRITE_BATCH) {
+			batch = PAGER_WRITE_BATCH;
+		}
+		for (uint32_t i = 0; i < batch; ++i) {
+			uint32_t page_num = wal->pages[done + i];
+			pages[i] = pager_resident_page(pager, page_num);
+			if (pages[i] == NULL) {
+				pages[i] = staging + i * PAGE_SIZE;
+				wal_read_page(wal, wal_find(wal, page_num), pages[i]);
+			}
+		}
+		pager_write_runs(pager, wal->pages + done, pages, batch);
+	}
+	free(staging);
+	pager_sync(pager);
+	wal_reset(wal);
+}
+
+/**
+  * @brief: open the log and bring the database file up to date with
+  *         whatever an earlier session committed to it but didn't get to
+  *         checkpoint. A leftover log is recovered even if this session runs
+  *         without one, it's deleted afterwards in that case
+  */
+static void pager_recover(Pager* pager, const char* filename, const PagerOptions* options) {
+	char* wal_filename = malloc(strlen(filename) + sizeof("-wal"));
+	strcpy(wal_filename, filename);
+	strcat(wal_filename, "-wal");
+	bool wal_exists = access(wal_filename, F_OK) == 0;
+	free(wal_filename);
+
+	pager->wal = NULL;
+	if (!options->use_wal && !wal_exists) {
+		return;
+	}
+	pager->wal = wal_open(filename, options->sync);
+	pager->wal->checkpoint_frames = options->checkpoint_frames;
+	uint32_t commit_pages = wal_recover(pager->wal);
+	if (commit_pages > pager->num_pages) {
+		pager->num_pages = commit_pages;
+	}
+	pager_checkpoint(pager);
+	pager->file_length = lseek(pager->file_descriptor, 0, SEEK_END);
+
+	if (!options->use_wal) {
+		wal_close(pager->wal, true);
+		pager->wal = NULL;
+	}
+}
+
+static bool pager_is_dirty(Pager* pager, uint32_t page_num);
+
+/**
+  * @brief: remember that page_num went from clean to dirty, so commit finds
+  *         changed pages without looking at every page
+  */
+static void pager_note_dirty(Pager* pager, uint32_t page_num) {
+	if (pager->dirty_count == pager->dirty_capacity) {
+		// without a log nothing drains the list until close, drop pages
+		// eviction already wrote back before growing it
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < pager->dirty_count; ++i) {
+			if (pager_is_dirty(pager, pager->dirty_list[i])) {
+				pager->dirty_list[count++] = pager->dirty_list[i];
+			}
+		}
+		pager->dirty_count = count;
+		if (count * 2 >= pager->dirty_capacity) {
+			pager->dirty_capacity = pager->dirty_capacity ? pager->dirty_capacity * 2 : 64;
+			pager->dirty_list = realloc(pager->dirty_list, pager->dirty_capacity * sizeof(uint32_t));
+		}
+	}
+	pager->dirty_list[pager->dirty_count++] = page_num;
+}
+
+/**
+  * @brief: map the file for PAGER_BACKEND_MMAP. A large range of address
+  *         space is reserved up front, past the end of file, so growing the
+  *         file with ftruncate() makes new pages show up in place and page
+  *         pointers stay put. Mapping is private so changed pages reach the
+  *         file only through pager_flush(), just like with the buffer pool
+  */
+static void mmap_open(Pager* pager, const PagerOptions* options) {
+	pager->file_pages = pager->num_pages;
+	// partial page at the end of file is rounded up so whole pages are mapped
+	if ((off_t)pager->file_pages * PAGE_SIZE != pager->file_length) {
+		if (ftruncate(pager->file_descriptor, (off_t)pager->file_pages * PAGE_SIZE) == -1) {
+			printf("Error growing db file: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	size_t map_length = options->mmap_size;
+	if (map_length < (size_t)pager->file_pages * PAGE_SIZE) {
+		map_length = (size_t)pager->file_pages * PAGE_SIZE;
+	}
+	void* map = mmap(NULL, map_length, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_NORESERVE, pager->file_descriptor, 0);
+	if (map == MAP_FAILED) {
+		printf("Error mapping db file: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	pager->map = map;
+	pager->map_length = map_length;
+	pager->dirty_pages = NULL;
+	pager->dirty_pages_length = 0;
+	pager->pinned = 0;
+}
+
+/**
+  * @brief: make the file big enough to back page_num, touching the mapping
+  *         past end of file is a SIGBUS. File grows by a quarter(or at least
+  *         PAGER_MMAP_GROW_PAGES) at a time so ftruncate() isn't called for
+  *         every new page. Running out of reserved address space remaps,
+  *         which may move the mapping, so it's only allowed with no pins held
+  */
+static void mmap_grow(Pager* pager, uint32_t page_num) {
+	uint32_t new_pages = pager->file_pages + pager->file_pages / 4;
+	if (new_pages < pager->file_pages + PAGER_MMAP_GROW_PAGES) {
+		new_pages = pager->file_pages + PAGER_MMAP_GROW_PAGES;
+	}
+	if (new_pages <= page_num) {
+		new_pages = page_num + 1;
+	}
+	size_t new_length = (size_t)new_pages * PAGE_SIZE;
+
+	if (new_length > pager->map_length) {
+		if (pager->pinned > 0) {
+			printf("Mapping is full and pages are pinned, reopen with a larger mapping\n");
+			exit(EXIT_FAILURE);
+		}
+		size_t map_length = pager->map_length;
+		while (map_length < new_length) {
+			map_length *= 2;
+		}
+		void* map = mremap(pager->map, pager->map_length, map_length, MREMAP_MAYMOVE);
+		if (map == MAP_FAILED) {
+			printf("Error remapping db file: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		pager->map = map;
+		pager->map_length = map_length;
+	}
+
+	if (ftruncate(pager->file_descriptor, new_length) == -1) {
+		printf("Error growing db file: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	pager->file_pages = new_pages;
+}
+
+/**
+  * @brief: page of the mapping, growing the file if page_num is past its end
+  */
+static void* mmap_get_page(Pager* pager, uint32_t page_num) {
+	// the OS reads the page in on a fault, every page counts as a hit
+	stats_add(STAT_PAGE_HITS, 1);
+	if (page_num >= pager->file_pages) {
+		mmap_grow(pager, page_num);
+	}
+	if (page_num >= pager->num_pages) {
+		pager->num_pages = page_num + 1;
+	}
+	return pager->map + (size_t)page_num * PAGE_SIZE;
+}
+
+/**
+  * @brief: remember page_num as changed, dirty_pages grows by doubling like
+  *         the page_table does
+  */
+static void mmap_mark_dirty(Pager* pager, uint32_t page_num) {
+	if (page_num >= pager->dirty_pages_length) {
+		uint32_t length = pager->dirty_pages_length ? pager->dirty_pages_length : 64;
+		while (length <= page_num) {
+			length *= 2;
+		}
+		pager->dirty_pages = realloc(pager->dirty_pages, length * sizeof(bool));
+		memset(pager->dirty_pages + pager->dirty_pages_length, 0,
+				(length - pager->dirty_pages_length) * sizeof(bool));
+		pager->dirty_pages_length = length;
+	}
+	if (!pager->dirty_pages[page_num]) {
+		pager->dirty_pages[page_num] = true;
+		pager_note_dirty(pager, page_num);
+	}
+}
+
+/**
+  * @brief: reserve the memory of every frame at once, PAGE_SIZE aligned as
+  *         mmap() hands it out. With huge pages the arena is rounded up to
+  *         a whole huge page and the extra memory becomes frames too, if
+  *         none are reserved the kernel is asked for transparent ones instead
+  */
+static void pager_open_arena(Pager* pager, uint32_t num_frames, bool huge_pages) {
+	size_t length = (size_t)num_frames * PAGE_SIZE;
+	void* arena = MAP_FAILED;
+	if (huge_pages) {
+		size_t huge_length = (length + PAGER_HUGE_PAGE_SIZE - 1) & ~((size_t)PAGER_HUGE_PAGE_SIZE - 1);
+		arena = mmap(NULL, huge_length, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (arena != MAP_FAILED) {
+			length = huge_length;
+		}
+	}
+	if (arena == MAP_FAILED) {
+		arena = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (arena == MAP_FAILED) {
+			printf("Error allocating buffer pool: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		if (huge_pages) {
+			madvise(arena, length, MADV_HUGEPAGE);
+		}
+	}
+	pager->arena = arena;
+	pager->arena_length = length;
+	pager->num_frames = length / PAGE_SIZE;
+	pager->frames = calloc(pager->num_frames, sizeof(Frame));
+	for (uint32_t i = 0; i < pager->num_frames; ++i) {
+		pager->frames[i].data = (uint8_t*)arena + (size_t)i * PAGE_SIZE;
+	}
+}
+
+/**
+  * @brief: opens/creates the database file and keeps track of its length
+  *         opens file with read/write access mode and read and write permission
+  *         bits, and check if its successful, it then gets the file length with lseek()
+  *         with the help of SEEK_END constant as it makes the file offset to length of
+  *         file + offset(which is 0 here) and then it declares and initializes the Pager
+  *         object and its buffer pool. Frame memory is reserved up front in
+  *         one arena but only backed by the OS as frames are first used, so
+  *         a small database never uses the whole memory budget
+  */
+Pager* pager_open(const char* filename, const PagerOptions* options) {
+	PagerOptions defaults;
+	if (options == NULL) {
+		pager_options_init(&defaults);
+		options = &defaults;
+	}
+
+	// pages bypass the OS cache, frames are the only copy in memory. A
+	// file system without O_DIRECT gets the file opened as usual
+	bool direct_io = options->direct_io && options->backend == PAGER_BACKEND_POOL;
+	/* int open(const char* filename, int flags[, mode_t mode]); */
+	int file_desc = open(filename,
+			// access modes
+			O_RDWR  // open the file for both reading and writing
+			// open-time flag
+			| O_CREAT  // the file will be created if not already exist
+			| (direct_io ? O_DIRECT : 0),  // reads and writes go straight to the device
+			// permission bits
+			S_IWUSR  // read permission for owner of file(0400)
+			| S_IRUSR); // write permission for owner(0200)
+	// Refer here for more details:
+	// https://www.gnu.org/software/libc/manual/html_node/Opening-and-Closing-Files.html
+	if (file_desc == -1 && direct_io && errno == EINVAL) {
+		direct_io = false;
+		file_desc = open(filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+	}
+
+	if (file_desc == -1) {
+		printf("Unable to open file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// refer to 'man lseek' for more info
+	off_t file_length = lseek(file_desc, 0, SEEK_END);
+
+	Pager* pager = malloc(sizeof(Pager));
+	pager->backend = options->backend;
+	pager->file_descriptor = file_desc;
+	pager->file_length = file_length;
+	pager->num_pages = file_length / PAGE_SIZE;
+	// if any partial page at the end of file
+	if (file_length % PAGE_SIZE) {
+		pager->num_pages++;
+	}
+	pager->file_pages = pager->num_pages;
+	pager->map = NULL;
+	pager->page_table_length = 0;
+	pager->page_table = NULL;
+	pager->wal_uncommitted = false;
+	pager->dirty_list = NULL;
+	pager->dirty_count = 0;
+	pager->dirty_capacity = 0;
+	pthread_mutex_init(&pager->lock, NULL);
+	// readers come back for every page, a steady stream of them mustn't keep the writer out
+	pthread_rwlockattr_t latch_attributes;
+	pthread_rwlockattr_init(&latch_attributes);
+	pthread_rwlockattr_setkind_np(&latch_attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&pager->latch, &latch_attributes);
+	pthread_rwlockattr_destroy(&latch_attributes);
+	pager->epoch = 0;
+	pager->snapshots = NULL;
+	pager->newest_snapshot = 0;
+	pager->versions = NULL;
+	pager->versions_length = 0;
+	pager->num_versions = 0;
+	pager->read_ahead = options->read_ahead;
+	pager->direct_io = direct_io;
+	pager->frames = NULL;
+	pager->arena = NULL;
+	pager->num_frames = 0;
+	pager->ring = NULL;
+	pager->num_loading = 0;
+	pager_recover(pager, filename, options);
+
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		mmap_open(pager, options);
+		return pager;
+	}
+
+	uint32_t num_frames = options->pool_size / PAGE_SIZE;
+	if (num_frames < PAGER_MIN_FRAMES) {
+		num_frames = PAGER_MIN_FRAMES;
+	}
+	pager_open_arena(pager, num_frames, options->huge_pages);
+	pager->clock_hand = 0;
+	if (pager->read_ahead) {
+		pager->ring = ioring_open(PAGER_READ_AHEAD_DEPTH);
+	}
+	return pager;
+}
+
+/**
+  * @brief: grow page_table so that page_num can be looked up, doubling its
+  *         length every time so growth is amortized
+  */
+static void pager_reserve_page_table(Pager* pager, uint32_t page_num) {
+	if (page_num < pager->page_table_length) {
+		return;
+	}
+	uint32_t length = pager->page_table_length ? pager->page_table_length : 64;
+	while (length <= page_num) {
+		length *= 2;
+	}
+	pager->page_table = realloc(pager->page_table, length * sizeof(uint32_t));
+	for (uint32_t i = pager->page_table_length; i < length; ++i) {
+		pager->page_table[i] = FRAME_NONE;
+	}
+	pager->page_table_length = length;
+}
+
+/**
+  * @brief: pick a frame to reuse with CLOCK(second chance) replacement
+  *         the hand skips pinned frames and clears reference bits as it goes,
+  *         first frame found unused or unreferenced is the victim. Two sweeps
+  *         are enough to find one unless every frame is pinned
+  */
+static uint32_t pager_find_victim(Pager* pager) {
+	for (uint32_t i = 0; i < 2 * pager->num_frames; ++i) {
+		uint32_t frame_index = pager->clock_hand;
+		Frame* frame = &pager->frames[frame_index];
+		pager->clock_hand = (pager->clock_hand + 1) % pager->num_frames;
+
+		if (!frame->in_use) {
+			return frame_index;
+		}
+		if (frame->pin_count > 0) {
+			continue;
+		}
+		if (frame->referenced) {
+			frame->referenced = false;
+			continue;
+		}
+		return frame_index;
+	}
+	printf("Buffer pool exhausted, all %d frames are pinned\n", pager->num_frames);
+	exit(EXIT_FAILURE);
+}
+
+/**
+  * @brief: find a frame for page_num, writing back whatever dirty page was
+  *         in it, the caller fills it
+  */
+static uint32_t pager_claim_frame(Pager* pager, uint32_t page_num) {
+	uint32_t frame_index = pager_find_victim(pager);
+	Frame* frame = &pager->frames[frame_index];
+
+	if (frame->in_use) {
+		if (frame->dirty) {
+			pager_flush(pager, frame->page_num);
+		}
+		pager->page_table[frame->page_num] = FRAME_NONE;
+	}
+	frame->page_num = page_num;
+	frame->pin_count = 0;
+	frame->in_use = true;
+	frame->dirty = false;
+	frame->loading = false;
+	pager->page_table[page_num] = frame_index;
+	return frame_index;
+}
+
+/**
+  * @brief: cache miss, load the page from file into a frame of its own.
+  *         Pages past the end of file are new and start zeroed without
+  *         asking the file for them
+  */
+static uint32_t pager_load(Pager* pager, uint32_t page_num) {
+	uint32_t frame_index = pager_claim_frame(pager, page_num);
+	Frame* frame = &pager->frames[frame_index];
+
+	ssize_t bytes_read = 0;
+	off_t wal_offset = pager->wal ? wal_find(pager->wal, page_num) : 0;
+	if (wal_offset != 0) {
+		// latest version of the page is in the log, not checkpointed yet
+		wal_read_page(pager->wal, wal_offset, frame->data);
+		bytes_read = PAGE_SIZE;
+	}
+	else if (page_num < pager->file_pages) {
+		bytes_read = pread(pager->file_descriptor, frame->data, PAGE_SIZE,
+				(off_t)page_num * PAGE_SIZE);
+		if (bytes_read == -1) {
+			printf("Error reading file: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		stats_add(STAT_READ_CALLS, 1);
+		stats_add(STAT_BYTES_READ, bytes_read);
+	}
+	// new page or partial page at end of file, rest of it is empty
+	if (bytes_read < PAGE_SIZE) {
+		memset(frame->data + bytes_read, 0, PAGE_SIZE - bytes_read);
+	}
+	if (page_num >= pager->num_pages) {
+		pager->num_pages = page_num + 1;
+	}
+	return frame_index;
+}
+
+/**
+  * @brief: take the reads ahead which have completed, waiting for one if
+  *         wait is set. A frame's pin is let go once its page is in. A read
+  *         which failed gives its frame back, the page is read the usual
+  *         way when it's fetched, so an error is only reported by pread()
+  */
+static void pager_complete_reads(Pager* pager, bool wait) {
+	uint64_t frame_index;
+	int32_t result;
+	while (ioring_complete(pager->ring, wait, &frame_index, &result)) {
+		Frame* frame = &pager->frames[frame_index];
+		frame->loading = false;
+		frame->pin_count--;
+		pager->num_loading--;
+		wait = false;
+		if (result < 0) {
+			pager->page_table[frame->page_num] = FRAME_NONE;
+			frame->in_use = false;
+			continue;
+		}
+		// partial page at end of file, rest of it is empty
+		if (result < (int32_t)PAGE_SIZE) {
+			memset(frame->data + result, 0, PAGE_SIZE - result);
+		}
+		stats_add(STAT_BYTES_READ, result);
+	}
+}
+
+/**
+  * @brief: find the frame holding page_num, loading it on a miss or waiting
+  *         for it if it's being read ahead
+  */
+static Frame* pager_fetch(Pager* pager, uint32_t page_num) {
+	pager_reserve_page_table(pager, page_num);
+	uint32_t frame_index = pager->page_table[page_num];
+	while (frame_index != FRAME_NONE && pager->frames[frame_index].loading) {
+		pager_complete_reads(pager, true);
+		// a read ahead which failed left the page out of the pool
+		frame_index = pager->page_table[page_num];
+	}
+	if (frame_index == FRAME_NONE) {
+		stats_add(STAT_PAGE_MISSES, 1);
+		frame_index = pager_load(pager, page_num);
+	}
+	else {
+		stats_add(STAT_PAGE_HITS, 1);
+	}
+	Frame* frame = &pager->frames[frame_index];
+	frame->referenced = true;
+	return frame;
+}
+
+/**
+  * @brief: fetches the required page and contains the logic of handling cache
+  *         miss. Assuming pages are saved one after one and every offset is of
+  *         PAGE_SIZE. If the requested page lies outside the bound of file it
+  *         should be empty so we'll create a empty page and return it else
+  *         simply return the page of required page_num
+  */
+void* get_page(Pager* pager, uint32_t page_num) {
+	if (page_num == FRAME_NONE) {
+		printf("Trying to access page out of bound\n");
+		exit(EXIT_FAILURE);
+	}
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		return mmap_get_page(pager, page_num);
+	}
+	return pager_fetch(pager, page_num)->data;
+}
+
+/**
+  * @brief: hand out a new page number at the end of the file, the page is
+  *         zeroed when it's first fetched as it's not in the file yet. With
+  *         mmap backend the file is grown right away, callers allocate before
+  *         pinning anything so a remap can't pull pages from under them
+  */
+uint32_t pager_allocate_page(Pager* pager) {
+	uint32_t page_num = pager->num_pages;
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		mmap_get_page(pager, page_num);
+		return page_num;
+	}
+	pager->num_pages++;
+	return page_num;
+}
+
+/**
+  * @brief: save the image of a page the writer is about to change, unless
+  *         no open snapshot needs it. A snapshot reads the oldest version
+  *         saved at or after its epoch, so one is only needed if none was
+  *         saved since the newest snapshot was taken. The writer holds the
+  *         latch, nothing else touches the versions meanwhile
+  */
+static void pager_save_version(Pager* pager, uint32_t page_num, const void* page) {
+	if (pager->snapshots == NULL) {
+		return;
+	}
+	if (page_num >= pager->versions_length) {
+		uint32_t length = pager->versions_length ? pager->versions_length : 64;
+		while (length <= page_num) {
+			length *= 2;
+		}
+		pager->versions = realloc(pager->versions, length * sizeof(PageVersion*));
+		for (uint32_t i = pager->versions_length; i < length; ++i) {
+			pager->versions[i] = NULL;
+		}
+		pager->versions_length = length;
+	}
+	PageVersion* newest = pager->versions[page_num];
+	if (newest != NULL && newest->epoch >= pager->newest_snapshot) {
+		return;
+	}
+	PageVersion* version = malloc(sizeof(PageVersion) + PAGE_SIZE);
+	version->epoch = pager->epoch;
+	version->next = newest;
+	memcpy(version->data, page, PAGE_SIZE);
+	pager->versions[page_num] = version;
+	pager->num_versions++;
+}
+
+/**
+  * @brief: fetch the page and mark it dirty, use before modifying a page
+  */
+void* get_page_for_write(Pager* pager, uint32_t page_num) {
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		void* page = mmap_get_page(pager, page_num);
+		pager_save_version(pager, page_num, page);
+		mmap_mark_dirty(pager, page_num);
+		return page;
+	}
+	Frame* frame = pager_fetch(pager, page_num);
+	pager_save_version(pager, page_num, frame->data);
+	if (!frame->dirty) {
+		frame->dirty = true;
+		pager_note_dirty(pager, page_num);
+	}
+	return frame->data;
+}
+
+/**
+  * @brief: fetch the page and keep it from being evicted until pager_unpin()
+  */
+void* pager_pin(Pager* pager, uint32_t page_num) {
+	void* page;
+	pthread_mutex_lock(&pager->lock);
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		page = mmap_get_page(pager, page_num);
+		pager->pinned++;
+	}
+	else {
+		Frame* frame = pager_fetch(pager, page_num);
+		frame->pin_count++;
+		page = frame->data;
+	}
+	pthread_mutex_unlock(&pager->lock);
+	return page;
+}
+
+/**
+  * @brief: release a pin taken by pager_pin()
+  */
+void pager_unpin(Pager* pager, uint32_t page_num) {
+	pthread_mutex_lock(&pager->lock);
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		pager->pinned--;
+		pthread_mutex_unlock(&pager->lock);
+		return;
+	}
+	uint32_t frame_index = pager->page_table[page_num];
+	if (frame_index == FRAME_NONE || pager->frames[frame_index].pin_count == 0) {
+		printf("Tried to unpin page %d which is not pinned.\n", page_num);
+		exit(EXIT_FAILURE);
+	}
+	pager->frames[frame_index].pin_count--;
+	pthread_mutex_unlock(&pager->lock);
+}
+
+/**
+  * @brief: hint the OS to read pages ahead, a run of consecutive pages at a
+  *         time. The pool reads them into its frames from the OS cache when
+  *         they're fetched, the mapping faults them in from there
+  */
+static void pager_advise(Pager* pager, const uint32_t* page_nums, uint32_t count) {
+	uint32_t i = 0;
+	while (i < count) {
+		uint32_t run = 1;
+		while (i + run < count && page_nums[i + run] == page_nums[i] + run) {
+			++run;
+		}
+		if (page_nums[i] < pager->file_pages) {
+			off_t offset = (off_t)page_nums[i] * PAGE_SIZE;
+			if (pager->backend == PAGER_BACKEND_MMAP) {
+				madvise(pager->map + offset, (size_t)run * PAGE_SIZE, MADV_WILLNEED);
+			}
+			else {
+				posix_fadvise(pager->file_descriptor, offset, (off_t)run * PAGE_SIZE,
+						POSIX_FADV_WILLNEED);
+			}
+		}
+		i += run;
+	}
+}
+
+/**
+  * @brief: queue a read of every page not in the pool or the log into a
+  *         frame of its own, and start them all with one call. A frame is
+  *         pinned while its read is in flight, and no more than a quarter of
+  *         the pool is, so the rest is left for pages being worked on
+  */
+void pager_read_ahead(Pager* pager, const uint32_t* page_nums, uint32_t count) {
+	if (!pager->read_ahead) {
+		return;
+	}
+	pager_begin_read(pager);
+	pthread_mutex_lock(&pager->lock);
+	if (pager->ring == NULL) {
+		// with O_DIRECT there's no OS cache to read them into
+		if (!pager->direct_io) {
+			pager_advise(pager, page_nums, count);
+		}
+		pthread_mutex_unlock(&pager->lock);
+		pager_end_read(pager);
+		return;
+	}
+
+	pager_complete_reads(pager, false);
+	uint32_t limit = ioring_entries(pager->ring);
+	if (limit > pager->num_frames / 4) {
+		limit = pager->num_frames / 4;
+	}
+	uint32_t queued = 0;
+	for (uint32_t i = 0; i < count && pager->num_loading < limit; ++i) {
+		uint32_t page_num = page_nums[i];
+		if (page_num >= pager->file_pages) {
+			continue;
+		}
+		pager_reserve_page_table(pager, page_num);
+		if (pager->page_table[page_num] != FRAME_NONE
+				|| (pager->wal != NULL && wal_find(pager->wal, page_num) != 0)) {
+			continue;
+		}
+		uint32_t frame_index = pager_claim_frame(pager, page_num);
+		Frame* frame = &pager->frames[frame_index];
+		if (!ioring_queue_read(pager->ring, pager->file_descriptor, frame->data, PAGE_SIZE,
+				(off_t)page_num * PAGE_SIZE, frame_index)) {
+			frame->in_use = false;
+			pager->page_table[page_num] = FRAME_NONE;
+			break;
+		}
+		frame->loading = true;
+		frame->pin_count = 1;
+		frame->referenced = true;
+		pager->num_loading++;
+		++queued;
+	}
+	if (queued > 0) {
+		ioring_submit(pager->ring);
+		stats_add(STAT_READ_CALLS, 1);
+		stats_add(STAT_READ_AHEAD, queued);
+	}
+	pthread_mutex_unlock(&pager->lock);
+	pager_end_read(pager);
+}
+
+/**
+  * @brief: start a statement changing the file
+  */
+void pager_begin_write(Pager* pager) {
+	pthread_rwlock_wrlock(&pager->latch);
+}
+
+/**
+  * @brief: end a statement, it's one more epoch for snapshots taken after it
+  */
+void pager_end_write(Pager* pager) {
+	pager->epoch++;
+	pthread_rwlock_unlock(&pager->latch);
+}
+
+void pager_begin_read(Pager* pager) {
+	pthread_rwlock_rdlock(&pager->latch);
+}
+
+void pager_end_read(Pager* pager) {
+	pthread_rwlock_unlock(&pager->latch);
+}
+
+/**
+  * @brief: take a snapshot at the current epoch, no write is half done
+  *         while the caller holds the latch
+  */
+Snapshot* pager_snapshot_open(Pager* pager) {
+	Snapshot* snapshot = malloc(sizeof(Snapshot));
+	pthread_mutex_lock(&pager->lock);
+	snapshot->epoch = pager->epoch;
+	snapshot->next = pager->snapshots;
+	pager->snapshots = snapshot;
+	pager->newest_snapshot = pager->epoch;
+	pthread_mutex_unlock(&pager->lock);
+	return snapshot;
+}
+
+/**
+  * @brief: copy a page as of the snapshot, the oldest version saved at or
+  *         after its epoch, or the page itself if it hasn't changed since.
+  *         The latch keeps the writer from changing the page mid copy, it's
+  *         let go right after so a scan holds it only a page at a time. A
+  *         version found stays until this snapshot is closed, so it's copied
+  *         without the lock
+  */
+void pager_snapshot_read(Pager* pager, const Snapshot* snapshot, uint32_t page_num,
+		void* buffer) {
+	pager_begin_read(pager);
+	pthread_mutex_lock(&pager->lock);
+	const PageVersion* found = NULL;
+	if (page_num < pager->versions_length) {
+		for (const PageVersion* version = pager->versions[page_num];
+				version != NULL && version->epoch >= snapshot->epoch; version = version->next) {
+			found = version;
+		}
+	}
+	pthread_mutex_unlock(&pager->lock);
+	if (found != NULL) {
+		memcpy(buffer, found->data, PAGE_SIZE);
+	}
+	else {
+		memcpy(buffer, pager_pin(pager, page_num), PAGE_SIZE);
+		pager_unpin(pager, page_num);
+	}
+	pager_end_read(pager);
+}
+
+/**
+  * @brief: done with a snapshot. A version is only read by snapshots no
+  *         older than it, so those older than every open snapshot are freed,
+  *         all of them once none is open
+  */
+void pager_snapshot_close(Pager* pager, Snapshot* snapshot) {
+	pager_begin_read(pager);
+	pthread_mutex_lock(&pager->lock);
+	Snapshot** link = &pager->snapshots;
+	while (*link != snapshot) {
+		link = &(*link)->next;
+	}
+	*link = snapshot->next;
+	free(snapshot);
+
+	uint64_t oldest = UINT64_MAX;
+	pager->newest_snapshot = 0;
+	for (Snapshot* open = pager->snapshots; open != NULL; open = open->next) {
+		if (open->epoch < oldest) {
+			oldest = open->epoch;
+		}
+		if (open->epoch > pager->newest_snapshot) {
+			pager->newest_snapshot = open->epoch;
+		}
+	}
+	for (uint32_t i = 0; i < pager->versions_length && pager->num_versions > 0; ++i) {
+		PageVersion** version = &pager->versions[i];
+		while (*version != NULL && (*version)->epoch >= oldest) {
+			version = &(*version)->next;
+		}
+		while (*version != NULL) {
+			PageVersion* stale = *version;
+			*version = stale->next;
+			free(stale);
+			pager->num_versions--;
+		}
+	}
+	pthread_mutex_unlock(&pager->lock);
+	pager_end_read(pager);
+}
+
+/**
+  * @brief: mark page_num clean, it's about to be written by the caller
+  */
+static void pager_clear_dirty(Pager* pager, uint32_t page_num) {
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		pager->dirty_pages[page_num] = false;
+	}
+	else {
+		pager->frames[pager->page_table[page_num]].dirty = false;
+	}
+}
+
+/**
+  * @brief: writes to disk from the frame(or mapping) holding page_num,
+  *         always a whole page. Without a log it goes to the db file at offset
+  *         page_num * PAGE_SIZE, with one it's appended to the log as part of
+  *         the transaction in progress and the db file is left alone until
+  *         checkpoint
+  */
+void pager_flush(Pager* pager, uint32_t page_num) {
+	void* page = pager_resident_page(pager, page_num);
+	if (page == NULL) {
+		printf("Tried to flush page %d which is not cached.\n", page_num);
+		exit(EXIT_FAILURE);
+	}
+	if (pager->wal != NULL) {
+		wal_append(pager->wal, page_num, page, 0);
+		pager->wal_uncommitted = true;
+	}
+	else {
+		ssize_t bytes_written = pwrite(pager->file_descriptor, page, PAGE_SIZE,
+				(off_t)page_num * PAGE_SIZE);
+		if (bytes_written == -1) {
+			printf("Error writing: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		stats_add(STAT_WRITE_CALLS, 1);
+		stats_add(STAT_BYTES_WRITTEN, bytes_written);
+		if (page_num >= pager->file_pages) {
+			pager->file_pages = page_num + 1;
+		}
+	}
+	pager_clear_dirty(pager, page_num);
+}
+
+/**
+  * @brief: whether page_num has changes not written anywhere yet
+  */
+static bool pager_is_dirty(Pager* pager, uint32_t page_num) {
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		return page_num < pager->dirty_pages_length && pager->dirty_pages[page_num];
+	}
+	if (page_num >= pager->page_table_length || pager->page_table[page_num] == FRAME_NONE) {
+		return false;  // evicted, so already written back
+	}
+	return pager->frames[pager->page_table[page_num]].dirty;
+}
+
+/**
+  * @brief: narrow dirty_list down to pages which are still dirty(it can
+  *         have pages which were evicted or are listed twice) and mark them
+  *         clean, the caller writes them out right after
+  * @return: number of pages left at the front of dirty_list
+  */
+static uint32_t pager_take_dirty(Pager* pager) {
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < pager->dirty_count; ++i) {
+		uint32_t page_num = pager->dirty_list[i];
+		if (pager_is_dirty(pager, page_num)) {
+			pager_clear_dirty(pager, page_num);
+			pager->dirty_list[count++] = page_num;
+		}
+	}
+	pager->dirty_count = 0;
+	return count;
+}
+
+/**
+  * @brief: end of a transaction, changed pages go to the log in one
+  *         vectored write with the last frame carrying the commit mark.
+  *         If the transaction's pages all went to the log through eviction
+  *         the header page is logged again just to mark the commit
+  */
+void pager_commit(Pager* pager) {
+	Wal* wal = pager->wal;
+	if (wal == NULL) {
+		return;
+	}
+	uint32_t count = pager_take_dirty(pager);
+	if (count == 0) {
+		if (!pager->wal_uncommitted) {
+			return;
+		}
+		pager->dirty_list[count++] = 0;
+		get_page(pager, 0);
+	}
+
+	void** pages = malloc(count * sizeof(void*));
+	for (uint32_t i = 0; i < count; ++i) {
+		pages[i] = pager_resident_page(pager, pager->dirty_list[i]);
+	}
+	wal_append_pages(wal, pager->dirty_list, pages, count, pager->num_pages);
+	free(pages);
+
+	pager->wal_uncommitted = false;
+	wal_commit(wal);
+	if (wal_needs_checkpoint(wal)) {
+		pager_checkpoint(pager);
+	}
+}
+
+/**
+  * @brief: write back every dirty page, with a log that's a commit.
+  *         Without one only pages which changed are written, sorted so
+  *         adjacent ones go out together
+  */
+void pager_flush_all(Pager* pager) {
+	if (pager->wal != NULL) {
+		pager_commit(pager);
+		return;
+	}
+	uint32_t count = pager_take_dirty(pager);
+	qsort(pager->dirty_list, count, sizeof(uint32_t), compare_uint32);
+	void** pages = malloc(count * sizeof(void*));
+	for (uint32_t i = 0; i < count; ++i) {
+		pages[i] = pager_resident_page(pager, pager->dirty_list[i]);
+	}
+	pager_write_runs(pager, pager->dirty_list, pages, count);
+	free(pages);
+}
+
+/**
+  * @brief: does following tasks:
+  *         writes back dirty pages still in the pool(or mapping)
+  *         gives back the space mmap backend grew the file by ahead of time
+  *         closes the database file
+  *         frees the pool and the Pager
+  */
+void pager_close(Pager* pager) {
+	while (pager->num_loading > 0) {
+		pager_complete_reads(pager, true);
+	}
+	pager_flush_all(pager);
+	if (pager->wal != NULL) {
+		pager_checkpoint(pager);
+		wal_close(pager->wal, true);
+	}
+	if (pager->backend == PAGER_BACKEND_MMAP) {
+		munmap(pager->map, pager->map_length);
+		free(pager->dirty_pages);
+		if (ftruncate(pager->file_descriptor, (off_t)pager->num_pages * PAGE_SIZE) == -1) {
+			printf("Error truncating db file: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+	}
+	int close_result = close(pager->file_descriptor);
+	if (close_result == -1) {
+		printf("Error closing in db file.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (pager->arena != NULL) {
+		munmap(pager->arena, pager->arena_length);
+	}
+	free(pager->frames);
+	free(pager->page_table);
+	free(pager->dirty_list);
+	for (uint32_t i = 0; i < pager->versions_length; ++i) {
+		while (pager->versions[i] != NULL) {
+			PageVersion* version = pager->versions[i];
+			pager->versions[i] = version->next;
+			free(version);
+		}
+	}
+	free(pager->versions);
+	if (pager->ring != NULL) {
+		ioring_close(pager->ring);
+	}
+	pthread_rwlock_destroy(&pager->latch);
+	pthread_mutex_destroy(&pager->lock);
+	free(pager);
+}
@@ -0,0 +1,578 @@
+#include <ctype.h>
+
+#include "../inc/spdbutil.h"
+#include "../inc/parser.h"
+
+/**
+  * @brief: whether c ends a word, it's a symbol or a quote
+  */
+static bool is_delimiter(char c) {
+	return c == '\0' || isspace((unsigned char)c) || strchr("(),*?=!<>'", c) != NULL;
+}
+
+/**
+  * @brief: start splitting input
+  */
+void tokenizer_init(Tokenizer* tokenizer, const char* input) {
+	tokenizer->position = input;
+	tokenizer_advance(tokenizer);
+}
+
+/**
+  * @brief: read the token at position into current, skipping spaces before it
+  */
+void tokenizer_advance(Tokenizer* tokenizer) {
+	const char* position = tokenizer->position;
+	while (isspace((unsigned char)*position)) {
+		++position;
+	}
+	Token* token = &tokenizer->current;
+	token->start = position;
+	token->length = 0;
+
+	if (*position == '\0') {
+		token->type = TOKEN_END;
+	}
+	else if (*position == '\'') {
+		const char* close = strchr(position + 1, '\'');
+		if (close == NULL) {
+			token->type = TOKEN_INVALID;
+			position += strlen(position);
+		}
+		else {
+			token->type = TOKEN_STRING;
+			token->start = position + 1;
+			token->length = close - token->start;
+			position = close + 1;
+		}
+	}
+	else if (strchr("(),*?", *position) != NULL) {
+		token->type = TOKEN_SYMBOL;
+		token->length = 1;
+		++position;
+	}
+	else if (strchr("=!<>", *position) != NULL) {
+		// =, !=, <, <=, >, >=, a lone ! is no operator
+		token->type = *position == '!' && position[1] != '=' ? TOKEN_INVALID : TOKEN_SYMBOL;
+		token->length = *position != '=' && position[1] == '=' ? 2 : 1;
+		position += token->length;
+	}
+	else {
+		token->type = TOKEN_WORD;
+		while (!is_delimiter(*position)) {
+			++position;
+		}
+		token->length = position - token->start;
+	}
+	tokenizer->position = position;
+}
+
+/**
+  * @brief: whether a token is a word or symbol spelled text, a quoted string
+  *         is never a keyword
+  */
+bool token_is(const Token* token, const char* text) {
+	return (token->type == TOKEN_WORD || token->type == TOKEN_SYMBOL)
+		&& strlen(text) == token->length && strncmp(token->start, text, token->length) == 0;
+}
+
+/**
+  * @brief: skip over the current token if it's spelled text
+  */
+static bool accept(Tokenizer* tokenizer, const char* text) {
+	if (!token_is(&tokenizer->current, text)) {
+		return false;
+	}
+	tokenizer_advance(tokenizer);
+	return true;
+}
+
+/**
+  * @brief: copy the current token to value as a NUL terminated string and
+  *         move past it, it has to be a word, a quoted string, or a ? which
+  *         leaves value empty
+  */
+static PrepareResult parse_value(Tokenizer* tokenizer, char value[TOKEN_MAX_LENGTH + 1],
+		bool* parameter) {
+	Token* token = &tokenizer->current;
+	*parameter = accept(tokenizer, "?");
+	if (*parameter) {
+		value[0] = '\0';
+		return PREPARE_SUCCESS;
+	}
+	if (token->type != TOKEN_WORD && token->type != TOKEN_STRING) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	if (token->length > TOKEN_MAX_LENGTH) {
+		return PREPARE_STRING_TOO_LONG;
+	}
+	memcpy(value, token->start, token->length);
+	value[token->length] = '\0';
+	tokenizer_advance(tokenizer);
+	return PREPARE_SUCCESS;
+}
+
+/**
+ * @brief: parse a whole token as unsigned number, fails on trailing garbage
+ *         unlike atoi()
+ */
+bool parse_uint32(const char* token, uint32_t* value) {
+	if (token == NULL || *token == '\0') {
+		return false;
+	}
+	char* end;
+	errno = 0;
+	unsigned long parsed = strtoul(token, &end, 10);
+	if (*end != '\0' || errno != 0 || parsed > UINT32_MAX) {
+		return false;
+	}
+	*value = (uint32_t)parsed;
+	return true;
+}
+
+/**
+ * @brief: parse a whole token as double, fails on trailing garbage unlike atof()
+ */
+bool parse_double(const char* token, double* value) {
+	if (token == NULL || *token == '\0') {
+		return false;
+	}
+	char* end;
+	*value = strtod(token, &end);
+	return *end == '\0';
+}
+
+/**
+ * @brief: column named by the current token, moved past if it's one
+ */
+static bool parse_column(Tokenizer* tokenizer, Column* column) {
+	if (accept(tokenizer, "sl_no")) {
+		*column = COLUMN_SLNO;
+	}
+	else if (accept(tokenizer, "year")) {
+		*column = COLUMN_YEAR;
+	}
+	else if (accept(tokenizer, "company")) {
+		*column = COLUMN_COMPANY;
+	}
+	else if (accept(tokenizer, "power")) {
+		*column = COLUMN_POWER;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief: comparison operator of a where clause, moved past if it's one
+ */
+static bool parse_compare_op(Tokenizer* tokenizer, CompareOp* op) {
+	if (accept(tokenizer, "=")) {
+		*op = COMPARE_EQUAL;
+	}
+	else if (accept(tokenizer, "!=")) {
+		*op = COMPARE_NOT_EQUAL;
+	}
+	else if (accept(tokenizer, "<")) {
+		*op = COMPARE_LESS;
+	}
+	else if (accept(tokenizer, "<=")) {
+		*op = COMPARE_LESS_EQUAL;
+	}
+	else if (accept(tokenizer, ">")) {
+		*op = COMPARE_GREATER;
+	}
+	else if (accept(tokenizer, ">=")) {
+		*op = COMPARE_GREATER_EQUAL;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief: narrow the key range by a condition on sl_no, an impossible
+ *         condition leaves low > high which selects nothing
+ */
+static void narrow_key_range(KeyRange* range, CompareOp op, uint32_t key) {
+	uint32_t low = 0;
+	uint32_t high = UINT32_MAX;
+	switch (op) {
+		case (COMPARE_EQUAL):
+			low = high = key;
+			break;
+		case (COMPARE_LESS):
+			if (key == 0) {
+				low = 1;
+				high = 0;
+			}
+			else {
+				high = key - 1;
+			}
+			break;
+		case (COMPARE_LESS_EQUAL):
+			high = key;
+			break;
+		case (COMPARE_GREATER):
+			if (key == UINT32_MAX) {
+				low = 1;
+				high = 0;
+			}
+			else {
+				low = key + 1;
+			}
+			break;
+		case (COMPARE_GREATER_EQUAL):
+			low = key;
+			break;
+		case (COMPARE_NOT_EQUAL):
+			break;
+	}
+	if (low > range->low) {
+		range->low = low;
+	}
+	if (high < range->high) {
+		range->high = high;
+	}
+}
+
+/**
+ * @brief: add a condition with a value known to fit its column, conditions
+ *         on sl_no become the key range to seek to, the rest are tested on
+ *         every row in that range
+ */
+static void add_condition(Statement* statement, Column column, CompareOp op,
+		const ParameterValue* value) {
+	if (column == COLUMN_SLNO && op != COMPARE_NOT_EQUAL) {
+		narrow_key_range(&(statement->key_range), op, value->number);
+		return;
+	}
+	Predicate* predicate = &(statement->predicates[statement->num_predicates++]);
+	predicate->column = column;
+	predicate->op = op;
+	predicate->number = value->number;
+	predicate->real = value->real;
+	if (column == COLUMN_COMPANY) {
+		strcpy(predicate->text, value->text);
+		predicate->text_length = strlen(value->text);
+	}
+}
+
+/**
+ * @brief: record a ? of the statement
+ */
+static PrepareResult add_parameter(Statement* statement, bool condition, uint32_t field,
+		Column column, CompareOp op) {
+	if (statement->num_parameters == MAX_PARAMETERS) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	Parameter* parameter = &(statement->parameters[statement->num_parameters++]);
+	parameter->condition = condition;
+	parameter->field = field;
+	parameter->column = column;
+	parameter->op = op;
+	return PREPARE_SUCCESS;
+}
+
+/**
+ * @brief: add condition "column op value" to the select, a ? is only
+ *         recorded and added once a value is bound to it. Every ? may become
+ *         a predicate, so they take room among them
+ */
+static PrepareResult prepare_condition(Statement* statement, Column column, CompareOp op,
+		const char* text, bool parameter) {
+	if (column == COLUMN_COMPANY && op != COMPARE_EQUAL && op != COMPARE_NOT_EQUAL) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	bool is_key_range = column == COLUMN_SLNO && op != COMPARE_NOT_EQUAL;
+	if ((parameter || !is_key_range)
+			&& statement->num_predicates + statement->num_parameters == MAX_PREDICATES) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	if (parameter) {
+		return add_parameter(statement, true, 0, column, op);
+	}
+
+	ParameterValue value = {0, 0.0, ""};
+	switch (column) {
+		case (COLUMN_SLNO):
+		case (COLUMN_YEAR):
+			if (!parse_uint32(text, &value.number)) {
+				return PREPARE_SYNTAX_ERROR;
+			}
+			break;
+		case (COLUMN_POWER):
+			if (!parse_double(text, &value.real)) {
+				return PREPARE_SYNTAX_ERROR;
+			}
+			break;
+		case (COLUMN_COMPANY):
+			if (strlen(text) > COLUMN_COMPANY_NAME) {
+				return PREPARE_STRING_TOO_LONG;
+			}
+			strcpy(value.text, text);
+			break;
+	}
+	add_condition(statement, column, op, &value);
+	return PREPARE_SUCCESS;
+}
+
+/**
+ * @brief: put the value bound to a ? where it goes in statement
+ */
+void apply_parameter(Statement* statement, const Parameter* parameter, const ParameterValue* value) {
+	if (parameter->condition) {
+		add_condition(statement, parameter->column, parameter->op, value);
+		return;
+	}
+	Row* row = &(statement->row_to_insert);
+	switch (parameter->field) {
+		case (0):
+			row->sl_no = value->number;
+			break;
+		case (1):
+			row->year = value->number;
+			break;
+		case (2):
+			strcpy(row->company, value->text);
+			break;
+		case (3):
+			strcpy(row->model, value->text);
+			break;
+		case (4):
+			row->power = value->real;
+			break;
+	}
+}
+
+/**
+ * @brief: condition of a where clause, "between A and B" is two of them
+ */
+static PrepareResult parse_condition(Tokenizer* tokenizer, Statement* statement) {
+	Column column;
+	if (!parse_column(tokenizer, &column)) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	char value[TOKEN_MAX_LENGTH + 1];
+	bool parameter;
+	PrepareResult result;
+	CompareOp op;
+	if (accept(tokenizer, "between")) {
+		char high[TOKEN_MAX_LENGTH + 1];
+		bool high_parameter;
+		if (column == COLUMN_COMPANY) {
+			return PREPARE_SYNTAX_ERROR;
+		}
+		if ((result = parse_value(tokenizer, value, &parameter)) != PREPARE_SUCCESS) {
+			return result;
+		}
+		if (!accept(tokenizer, "and")) {
+			return PREPARE_SYNTAX_ERROR;
+		}
+		if ((result = parse_value(tokenizer, high, &high_parameter)) != PREPARE_SUCCESS) {
+			return result;
+		}
+		result = prepare_condition(statement, column, COMPARE_GREATER_EQUAL, value, parameter);
+		if (result == PREPARE_SUCCESS) {
+			result = prepare_condition(statement, column, COMPARE_LESS_EQUAL, high, high_parameter);
+		}
+		return result;
+	}
+	if (!parse_compare_op(tokenizer, &op)) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	if ((result = parse_value(tokenizer, value, &parameter)) != PREPARE_SUCCESS) {
+		return result;
+	}
+	return prepare_condition(statement, column, op, value, parameter);
+}
+
+/**
+ * @brief: one aggregate of the select list, like avg(power), or company for
+ *         the group of a group by
+ */
+static PrepareResult parse_aggregate(Tokenizer* tokenizer, Statement* statement) {
+	if (statement->num_aggregates == MAX_AGGREGATES) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	Aggregate* aggregate = &(statement->aggregates[statement->num_aggregates++]);
+	aggregate->column = COLUMN_SLNO;
+	if (accept(tokenizer, "company")) {
+		aggregate->func = AGGREGATE_GROUP;
+		return PREPARE_SUCCESS;
+	}
+
+	if (accept(tokenizer, "count")) {
+		aggregate->func = AGGREGATE_COUNT;
+	}
+	else if (accept(tokenizer, "sum")) {
+		aggregate->func = AGGREGATE_SUM;
+	}
+	else if (accept(tokenizer, "avg")) {
+		aggregate->func = AGGREGATE_AVG;
+	}
+	else if (accept(tokenizer, "min")) {
+		aggregate->func = AGGREGATE_MIN;
+	}
+	else if (accept(tokenizer, "max")) {
+		aggregate->func = AGGREGATE_MAX;
+	}
+	else {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	if (!accept(tokenizer, "(")) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	// count(*) and count(column) are the same, no column is ever empty
+	if (aggregate->func != AGGREGATE_COUNT || !accept(tokenizer, "*")) {
+		if (!parse_column(tokenizer, &aggregate->column)) {
+			return PREPARE_SYNTAX_ERROR;
+		}
+		if (aggregate->func != AGGREGATE_COUNT && aggregate->column == COLUMN_COMPANY) {
+			return PREPARE_SYNTAX_ERROR;
+		}
+	}
+	return accept(tokenizer, ")") ? PREPARE_SUCCESS : PREPARE_SYNTAX_ERROR;
+}
+
+/**
+ * @brief: parse insert, sl_no, year, company, model and power in that order,
+ *         any of them may be a ? bound later
+ *         insert 1 2015 honda city 119.3
+ *         insert 2 2016 'land rover' 'range rover' 250
+ *         insert ? ? ? ? ?
+ */
+static PrepareResult parse_insert(Tokenizer* tokenizer, Statement* statement) {
+	statement->type = STATEMENT_INSERT;
+	Row* row = &(statement->row_to_insert);
+	memset(row, 0, sizeof(Row));
+	char values[5][TOKEN_MAX_LENGTH + 1];
+	bool parameters[5];
+	for (uint32_t i = 0; i < 5; ++i) {
+		PrepareResult result = parse_value(tokenizer, values[i], &parameters[i]);
+		if (result != PREPARE_SUCCESS) {
+			return result;
+		}
+		if (parameters[i]) {
+			add_parameter(statement, false, i, COLUMN_SLNO, COMPARE_EQUAL);
+		}
+	}
+	if (tokenizer->current.type != TOKEN_END) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+
+	if ((!parameters[0] && !parse_uint32(values[0], &row->sl_no))
+			|| (!parameters[1] && !parse_uint32(values[1], &row->year))
+			|| (!parameters[4] && !parse_double(values[4], &row->power))) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	if ((strlen(values[2]) > COLUMN_COMPANY_NAME)
+			|| (strlen(values[3]) > COLUMN_MODEL_NAME)) {
+		return PREPARE_STRING_TOO_LONG;
+	}
+	strcpy(row->company, values[2]);
+	strcpy(row->model, values[3]);
+	return PREPARE_SUCCESS;
+}
+
+/**
+ * @brief: parse select, an optional list of aggregates, then an optional
+ *         where clause of conditions joined by and, then an optional group
+ *         by, then an optional limit on the rows returned
+ *         select
+ *         select where sl_no = N
+ *         select where sl_no between A and B and year > 2015
+ *         select where company = honda and power >= 100.5
+ *         select where company = 'land rover'
+ *         select count(*), avg(power), min(year), max(year) where year > 2015
+ *         select company, count(*), max(power) group by company
+ *         select where year > 2015 limit 10
+ *         sl_no, year and power take = != < <= > >= and between, company
+ *         takes = and !=
+ */
+static PrepareResult parse_select(Tokenizer* tokenizer, Statement* statement) {
+	statement->type = STATEMENT_SELECT;
+	statement->key_range.low = 0;
+	statement->key_range.high = UINT32_MAX;
+	statement->num_predicates = 0;
+	statement->num_aggregates = 0;
+	statement->group_by_company = false;
+	statement->limit = SELECT_NO_LIMIT;
+
+	PrepareResult result;
+	while (tokenizer->current.type != TOKEN_END && !token_is(&tokenizer->current, "where")
+			&& !token_is(&tokenizer->current, "group") && !token_is(&tokenizer->current, "limit")) {
+		if ((result = parse_aggregate(tokenizer, statement)) != PREPARE_SUCCESS) {
+			return result;
+		}
+		accept(tokenizer, ",");
+	}
+
+	if (accept(tokenizer, "where")) {
+		do {
+			if ((result = parse_condition(tokenizer, statement)) != PREPARE_SUCCESS) {
+				return result;
+			}
+		} while (accept(tokenizer, "and"));
+	}
+
+	if (accept(tokenizer, "group")) {
+		if (!accept(tokenizer, "by") || !accept(tokenizer, "company")) {
+			return PREPARE_SYNTAX_ERROR;
+		}
+		statement->group_by_company = true;
+	}
+	if (accept(tokenizer, "limit")) {
+		char value[TOKEN_MAX_LENGTH + 1];
+		bool parameter;
+		if ((result = parse_value(tokenizer, value, &parameter)) != PREPARE_SUCCESS) {
+			return result;
+		}
+		if (parameter || !parse_uint32(value, &statement->limit)) {
+			return PREPARE_SYNTAX_ERROR;
+		}
+	}
+	if (tokenizer->current.type != TOKEN_END) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+
+	// company in the select list only makes sense per group
+	bool has_group_column = false;
+	for (uint32_t i = 0; i < statement->num_aggregates; ++i) {
+		if (statement->aggregates[i].func == AGGREGATE_GROUP) {
+			has_group_column = true;
+		}
+	}
+	if (has_group_column && !statement->group_by_company) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	if (statement->group_by_company && statement->num_aggregates == 0) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	return PREPARE_SUCCESS;
+}
+
+/**
+ * @brief: tokenize and parse a statement, the first word says which kind it is
+ */
+PrepareResult parse_statement(const char* input, Statement* statement) {
+	Tokenizer tokenizer;
+	tokenizer_init(&tokenizer, input);
+	statement->num_parameters = 0;
+	if (accept(&tokenizer, "insert")) {
+		return parse_insert(&tokenizer, statement);
+	}
+	if (accept(&tokenizer, "select")) {
+		return parse_select(&tokenizer, statement);
+	}
+	return PREPARE_UNRECOGNIZED_STATEMENT;
+}
+
+/**
+ * @brief: Prepare Statement, parse the input buffer into statement
+ */
+PrepareResult prepare_statement(InputBuffer* input_buffer, Statement* statement) {
+	return parse_statement(input_buffer->buffer, statement);
+}
@@ -0,0 +1,248 @@
+#include "../inc/spdbutil.h"
+#include "../inc/prepared.h"
+
+/* which member of ParameterValue a ? is bound through */
+typedef enum {
+	PARAMETER_NUMBER,
+	PARAMETER_REAL,
+	PARAMETER_TEXT
+} ParameterKind;
+
+/**
+  * @brief: kind of value a ? takes, and the longest text for a string one
+  */
+static ParameterKind parameter_kind(const Parameter* parameter, uint32_t* max_length) {
+	if (parameter->condition) {
+		*max_length = COLUMN_COMPANY_NAME;
+		switch (parameter->column) {
+			case (COLUMN_SLNO):
+			case (COLUMN_YEAR):
+				return PARAMETER_NUMBER;
+			case (COLUMN_POWER):
+				return PARAMETER_REAL;
+			case (COLUMN_COMPANY):
+				return PARAMETER_TEXT;
+		}
+	}
+	// sl_no, year, company, model, power
+	*max_length = parameter->field == 3 ? COLUMN_MODEL_NAME : COLUMN_COMPANY_NAME;
+	if (parameter->field == 4) {
+		return PARAMETER_REAL;
+	}
+	return parameter->field < 2 ? PARAMETER_NUMBER : PARAMETER_TEXT;
+}
+
+/**
+  * @brief: parameter at index, NULL if the statement has no such ?
+  */
+static const Parameter* statement_parameter(PreparedStatement* prepared, uint32_t index) {
+	if (index < 1 || index > prepared->parsed.num_parameters) {
+		return NULL;
+	}
+	return &(prepared->parsed.parameters[index - 1]);
+}
+
+/**
+  * @brief: parse a statement to run later, one without a ? runs as it is
+  */
+PrepareResult statement_prepare(PreparedStatement* prepared, const char* text) {
+	PrepareResult result = parse_statement(text, &prepared->parsed);
+	if (result != PREPARE_SUCCESS) {
+		return result;
+	}
+	prepared->statement = prepared->parsed;
+	statement_reset(prepared);
+	return PREPARE_SUCCESS;
+}
+
+/**
+  * @brief: bind a number to a ? of sl_no, year or power
+  */
+PrepareResult statement_bind_uint32(PreparedStatement* prepared, uint32_t index, uint32_t value) {
+	const Parameter* parameter = statement_parameter(prepared, index);
+	uint32_t max_length;
+	if (parameter == NULL) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	switch (parameter_kind(parameter, &max_length)) {
+		case (PARAMETER_NUMBER):
+			prepared->values[index - 1].number = value;
+			break;
+		case (PARAMETER_REAL):
+			prepared->values[index - 1].real = value;
+			break;
+		case (PARAMETER_TEXT):
+			return PREPARE_SYNTAX_ERROR;
+	}
+	prepared->bound[index - 1] = true;
+	return PREPARE_SUCCESS;
+}
+
+/**
+  * @brief: bind a number to a ? of power
+  */
+PrepareResult statement_bind_double(PreparedStatement* prepared, uint32_t index, double value) {
+	const Parameter* parameter = statement_parameter(prepared, index);
+	uint32_t max_length;
+	if (parameter == NULL || parameter_kind(parameter, &max_length) != PARAMETER_REAL) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	prepared->values[index - 1].real = value;
+	prepared->bound[index - 1] = true;
+	return PREPARE_SUCCESS;
+}
+
+/**
+  * @brief: bind text to a ?, parsed like it was written in the statement
+  *         for a ? of a number
+  */
+PrepareResult statement_bind_text(PreparedStatement* prepared, uint32_t index, const char* value) {
+	const Parameter* parameter = statement_parameter(prepared, index);
+	uint32_t max_length;
+	if (parameter == NULL) {
+		return PREPARE_SYNTAX_ERROR;
+	}
+	ParameterValue* bound = &(prepared->values[index - 1]);
+	switch (parameter_kind(parameter, &max_length)) {
+		case (PARAMETER_NUMBER):
+			if (!parse_uint32(value, &bound->number)) {
+				return PREPARE_SYNTAX_ERROR;
+			}
+			break;
+		case (PARAMETER_REAL):
+			if (!parse_double(value, &bound->real)) {
+				return PREPARE_SYNTAX_ERROR;
+			}
+			break;
+		case (PARAMETER_TEXT):
+			if (strlen(value) > max_length) {
+				return PREPARE_STRING_TOO_LONG;
+			}
+			strcpy(bound->text, value);
+			break;
+	}
+	prepared->bound[index - 1] = true;
+	return PREPARE_SUCCESS;
+}
+
+/**
+  * @brief: put the bound values into a fresh copy of the parsed statement,
+  *         as conditions add up. An insert only has values replaced, so it's
+  *         done in place
+  */
+ExecuteResult statement_apply(PreparedStatement* prepared) {
+	uint32_t num_parameters = prepared->parsed.num_parameters;
+	for (uint32_t i = 0; i < num_parameters; ++i) {
+		if (!prepared->bound[i]) {
+			return EXECUTE_UNBOUND_PARAMETER;
+		}
+	}
+	if (num_parameters > 0 && prepared->parsed.type == STATEMENT_SELECT) {
+		prepared->statement = prepared->parsed;
+	}
+	for (uint32_t i = 0; i < num_parameters; ++i) {
+		apply_parameter(&prepared->statement, &prepared->parsed.parameters[i], &prepared->values[i]);
+	}
+	return EXECUTE_SUCCESS;
+}
+
+/**
+  * @brief: run a prepared statement with the values bound to it
+  */
+ExecuteResult statement_step(Table* table, PreparedStatement* prepared, Output* output) {
+	ExecuteResult result = statement_apply(prepared);
+	if (result != EXECUTE_SUCCESS) {
+		return result;
+	}
+	return execute_statement(table, &prepared->statement, output);
+}
+
+/**
+  * @brief: forget the values bound
+  */
+void statement_reset(PreparedStatement* prepared) {
+	for (uint32_t i = 0; i < MAX_PARAMETERS; ++i) {
+		prepared->bound[i] = false;
+	}
+}
+
+/**
+  * @brief: empty cache
+  */
+StatementCache* statement_cache_open(uint32_t num_entries) {
+	StatementCache* cache = malloc(sizeof(StatementCache));
+	cache->entries = calloc(num_entries, sizeof(StatementCacheEntry));
+	for (uint32_t i = 0; i < num_entries; ++i) {
+		cache->entries[i].prepared = malloc(sizeof(PreparedStatement));
+	}
+	cache->num_entries = num_entries;
+	cache->clock = 0;
+	cache->spare = malloc(sizeof(PreparedStatement));
+	return cache;
+}
+
+/**
+  * @brief: FNV-1a of the statement text
+  */
+static uint32_t statement_hash(const char* text) {
+	uint32_t hash = 2166136261u;
+	for (; *text != '\0'; ++text) {
+		hash ^= (uint8_t)*text;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+  * @brief: prepared statement for text, a miss replaces the least recently
+  *         used entry once it's parsed, a statement that fails to parse or
+  *         can't be run twice leaves the cache as it was
+  */
+PreparedStatement* statement_cache_prepare(StatementCache* cache, const char* text,
+		PrepareResult* result) {
+	uint32_t hash = statement_hash(text);
+	StatementCacheEntry* victim = &cache->entries[0];
+	cache->clock++;
+	for (uint32_t i = 0; i < cache->num_entries; ++i) {
+		StatementCacheEntry* entry = &cache->entries[i];
+		if (entry->text != NULL && entry->hash == hash && strcmp(entry->text, text) == 0) {
+			entry->last_used = cache->clock;
+			statement_reset(entry->prepared);
+			*result = PREPARE_SUCCESS;
+			return entry->prepared;
+		}
+		if (entry->last_used < victim->last_used) {
+			victim = entry;
+		}
+	}
+
+	*result = statement_prepare(cache->spare, text);
+	if (*result != PREPARE_SUCCESS) {
+		return NULL;
+	}
+	// an insert of literal values only ever runs once, it's not kept
+	if (cache->spare->parsed.type == STATEMENT_INSERT && cache->spare->parsed.num_parameters == 0) {
+		return cache->spare;
+	}
+	PreparedStatement* prepared = cache->spare;
+	cache->spare = victim->prepared;
+	free(victim->text);
+	victim->text = strdup(text);
+	victim->hash = hash;
+	victim->last_used = cache->clock;
+	victim->prepared = prepared;
+	return prepared;
+}
+
+/**
+  * @brief: free the cache and its statements
+  */
+void statement_cache_close(StatementCache* cache) {
+	for (uint32_t i = 0; i < cache->num_entries; ++i) {
+		free(cache->entries[i].text);
+		free(cache->entries[i].prepared);
+	}
+	free(cache->entries);
+	free(cache->spare);
+	free(cache);
+}
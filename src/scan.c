@@ -0,0 +1,185 @@
+#include "../inc/spdbutil.h"
+
+/**
+  * @brief: number of internal levels above the leaves, every leaf is as far
+  *         down from the root so the leftmost path tells
+  */
+static uint32_t scan_tree_height(Table* table) {
+	Pager* pager = table->pager;
+	uint32_t height = 0;
+	uint32_t page_num = table->root_page_num;
+	while (true) {
+		void* node = pager_pin(pager, page_num);
+		if (get_node_type(node) == NODE_LEAF) {
+			pager_unpin(pager, page_num);
+			return height;
+		}
+		uint32_t child = *internal_node_child(node, 0);
+		pager_unpin(pager, page_num);
+		page_num = child;
+		++height;
+	}
+}
+
+/**
+  * @brief: add the leaves under page_num which may hold keys in range, left to
+  *         right. Child i of an internal node holds keys in (key[i-1], key[i]]
+  *         so children outside the range are skipped without reading them.
+  *         Leaves are known by their level and never read here, one the zone
+  *         filter rules out is left out altogether
+  */
+static void scan_collect(Scan* scan, uint32_t page_num, uint32_t level) {
+	if (level == 0) {
+		ZoneMap* zones = scan->table->zones;
+		const ZoneEntry* zone = zones ? zonemap_get(zones, page_num) : NULL;
+		if (scan->filter != NULL && zone != NULL && !scan->filter(scan->filter_context, zone)) {
+			return;
+		}
+		if (scan->num_leaves == scan->leaves_capacity) {
+			scan->leaves_capacity = scan->leaves_capacity ? scan->leaves_capacity * 2 : 64;
+			scan->leaves = realloc(scan->leaves, scan->leaves_capacity * sizeof(uint32_t));
+		}
+		scan->leaves[scan->num_leaves++] = page_num;
+		return;
+	}
+
+	Pager* pager = scan->table->pager;
+	void* node = pager_pin(pager, page_num);
+
+	uint32_t num_keys = *internal_node_num_keys(node);
+	for (uint32_t i = 0; i <= num_keys; ++i) {
+		if (i > 0 && *internal_node_key(node, i - 1) >= scan->high) {
+			break;
+		}
+		if (i < num_keys && *internal_node_key(node, i) < scan->low) {
+			continue;
+		}
+		scan_collect(scan, *internal_node_child(node, i), level - 1);
+	}
+	pager_unpin(pager, page_num);
+}
+
+/**
+  * @brief: list the leaves holding keys in [low, high] which filter lets
+  *         through. The writer is kept out by the caller, so the internal
+  *         nodes and zone map are read in place and agree with the snapshot
+  */
+void scan_open(Scan* scan, Table* table, uint32_t low, uint32_t high, ZoneFilter filter,
+		void* filter_context) {
+	scan->table = table;
+	scan->low = low;
+	scan->high = high;
+	scan->filter = filter;
+	scan->filter_context = filter_context;
+	scan->leaves = NULL;
+	scan->num_leaves = 0;
+	scan->leaves_capacity = 0;
+	if (low <= high) {
+		scan_collect(scan, table->root_page_num, scan_tree_height(table));
+	}
+	scan->num_tasks = (scan->num_leaves + SCAN_TASK_LEAVES - 1) / SCAN_TASK_LEAVES;
+	scan->parallel = table->pool != NULL && scan->num_leaves >= SCAN_MIN_PARALLEL_LEAVES;
+	scan->snapshot = pager_snapshot_open(table->pager);
+}
+
+/**
+  * @brief: index of the first cell of the leaf whose key is >= key
+  */
+static uint32_t scan_lower_bound(void* node, uint32_t key) {
+	uint32_t min_index = 0;
+	uint32_t max_index = *leaf_node_num_cells(node);
+	while (min_index != max_index) {
+		uint32_t index = min_index + (max_index - min_index) / 2;
+		if (key <= leaf_node_key(node, index)) {
+			max_index = index;
+		}
+		else {
+			min_index = index + 1;
+		}
+	}
+	return min_index;
+}
+
+/**
+  * @brief: cells of a leaf in the key range, only the first and last leaf of
+  *         the range can have cells outside it
+  */
+void scan_leaf_cells(Scan* scan, void* node, uint32_t* start, uint32_t* end) {
+	*start = 0;
+	*end = *leaf_node_num_cells(node);
+	if (*end > 0 && leaf_node_key(node, 0) < scan->low) {
+		*start = scan_lower_bound(node, scan->low);
+	}
+	if (*end > 0 && leaf_node_key(node, *end - 1) > scan->high) {
+		*end = scan_lower_bound(node, scan->high + 1);  // high < key so no overflow
+	}
+}
+
+/**
+  * @brief: read ahead the leaves from first on, those already in the pool
+  *         or in flight are skipped by the pager
+  */
+void scan_read_ahead(Scan* scan, uint32_t first) {
+	if (first >= scan->num_leaves) {
+		return;
+	}
+	uint32_t count = scan->num_leaves - first;
+	if (count > SCAN_READ_AHEAD_LEAVES) {
+		count = SCAN_READ_AHEAD_LEAVES;
+	}
+	pager_read_ahead(scan->table->pager, scan->leaves + first, count);
+}
+
+/**
+  * @brief: scan the leaves of one task, each copied out of the pager first.
+  *         Its own leaves and those of the next task are read ahead, so a
+  *         task usually finds its leaves in the pool already
+  */
+static void scan_task(void* context, uint32_t task) {
+	Scan* scan = context;
+	Pager* pager = scan->table->pager;
+	uint32_t first = (scan->first_task + task) * SCAN_TASK_LEAVES;
+	uint32_t last = first + SCAN_TASK_LEAVES;
+	if (last > scan->num_leaves) {
+		last = scan->num_leaves;
+	}
+	scan_read_ahead(scan, first);
+	void* node = malloc(PAGE_SIZE);
+	for (uint32_t i = first; i < last; ++i) {
+		pager_snapshot_read(pager, scan->snapshot, scan->leaves[i], node);
+		uint32_t start;
+		uint32_t end;
+		scan_leaf_cells(scan, node, &start, &end);
+		if (start < end) {
+			stats_add(STAT_ROWS_SCANNED, end - start);
+			scan->function(scan->context, task, node, start, end);
+		}
+	}
+	free(node);
+}
+
+/**
+  * @brief: run tasks [first_task, first_task + num_tasks)
+  */
+void scan_run(Scan* scan, uint32_t first_task, uint32_t num_tasks, LeafFunction function,
+		void* context) {
+	scan->first_task = first_task;
+	scan->function = function;
+	scan->context = context;
+	if (scan->parallel) {
+		threadpool_run(scan->table->pool, scan_task, scan, num_tasks);
+		return;
+	}
+	for (uint32_t task = 0; task < num_tasks; ++task) {
+		scan_task(scan, task);
+	}
+}
+
+/**
+  * @brief: free the leaf list and close the snapshot
+  */
+void scan_close(Scan* scan) {
+	free(scan->leaves);
+	scan->leaves = NULL;
+	pager_snapshot_close(scan->table->pager, scan->snapshot);
+}
@@ -0,0 +1,570 @@
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "../inc/server.h"
+
+#define SERVER_READ_SIZE (64 * 1024)  // read from a client at a time
+#define SERVER_MAX_EVENTS 64
+
+/**
+ * Structure of Connection
+ *
+ * a client or a socket taking them, with the requests read but not yet run
+ * and the responses not yet written
+ */
+typedef struct Connection {
+	int fd;
+	bool listening;  // accepts clients instead
+	bool tcp;  // accepted by or accepting on the TCP socket
+	bool closing;  // client is done sending, closed once every request is answered
+	uint32_t events;  // what epoll watches it for
+	char* input;
+	size_t input_length;
+	size_t input_capacity;
+	char* pending;
+	size_t pending_start;  // written up to here
+	size_t pending_length;
+	size_t pending_capacity;
+	struct Connection* prev;
+	struct Connection* next;
+} Connection;
+
+/**
+ * Structure of Server
+ */
+typedef struct {
+	Table* table;
+	int epoll_fd;
+	Output* output;  // rows of the statement being run, before they're framed
+	Connection* responding;  // whose statement is being run, parts of its result go to it
+	StatementCache* statements;  // shared by every connection
+	char* statement;  // NUL terminated copy of the statement being run
+	Connection* connections;  // every socket, to close them when the server stops
+} Server;
+
+/**
+  * @brief: what a failed preparation is reported as, as the REPL words it
+  */
+static const char* prepare_message(PrepareResult result) {
+	switch (result) {
+		case (PREPARE_SUCCESS):
+			break;
+		case (PREPARE_STRING_TOO_LONG):
+			return "Entered string is too long.";
+		case (PREPARE_SYNTAX_ERROR):
+			return "Syntax Error. Couldn't parse the statement.";
+		case (PREPARE_UNRECOGNIZED_STATEMENT):
+			return "Unrecognized keyword at start of statement.";
+	}
+	return NULL;
+}
+
+/**
+  * @brief: what a failed statement is reported as, as the REPL words it
+  */
+static const char* execute_message(ExecuteResult result) {
+	switch (result) {
+		case (EXECUTE_SUCCESS):
+			break;
+		case (EXECUTE_DUPLICATE_KEY):
+			return "Error: Duplicate key.";
+		case (EXECUTE_TABLE_FULL):
+			return "Error: Table full.";
+		case (EXECUTE_UNBOUND_PARAMETER):
+			return "Error: No value for a ?.";
+		case (EXECUTE_NOT_A_QUERY):
+			return "Error: Statement returns no rows.";
+	}
+	return NULL;
+}
+
+/**
+  * @brief: frame a request, see server.h for its layout
+  */
+size_t protocol_encode_request(char* buffer, size_t capacity, const char* statement,
+		const char** values, uint32_t num_values) {
+	size_t length = 1 + strlen(statement);
+	for (uint32_t i = 0; i < num_values; ++i) {
+		length += sizeof(uint16_t) + strlen(values[i]);
+	}
+	if (num_values > MAX_PARAMETERS || length > SERVER_MAX_REQUEST
+			|| PROTOCOL_HEADER_SIZE + length > capacity) {
+		return 0;
+	}
+	uint32_t body_length = length;
+	memcpy(buffer, &body_length, sizeof(body_length));
+	buffer[4] = REQUEST_STATEMENT;
+	char* position = buffer + PROTOCOL_HEADER_SIZE;
+	*position++ = num_values;
+	for (uint32_t i = 0; i < num_values; ++i) {
+		uint16_t size = strlen(values[i]);
+		memcpy(position, &size, sizeof(size));
+		memcpy(position + sizeof(size), values[i], size);
+		position += sizeof(size) + size;
+	}
+	memcpy(position, statement, strlen(statement));
+	return PROTOCOL_HEADER_SIZE + length;
+}
+
+/**
+  * @brief: read a frame header
+  */
+void protocol_decode_header(const char* buffer, uint32_t* length, uint8_t* kind) {
+	memcpy(length, buffer, sizeof(*length));
+	*kind = buffer[4];
+}
+
+/**
+  * @brief: queue bytes to be written to a client, what was already written
+  *         is dropped first if there's no room
+  */
+static void connection_append(Connection* connection, const void* data, size_t length) {
+	if (connection->pending_capacity - connection->pending_length < length
+			&& connection->pending_start > 0) {
+		connection->pending_length -= connection->pending_start;
+		memmove(connection->pending, connection->pending + connection->pending_start,
+				connection->pending_length);
+		connection->pending_start = 0;
+	}
+	while (connection->pending_capacity - connection->pending_length < length) {
+		connection->pending_capacity *= 2;
+		connection->pending = realloc(connection->pending, connection->pending_capacity);
+	}
+	memcpy(connection->pending + connection->pending_length, data, length);
+	connection->pending_length += length;
+}
+
+/**
+  * @brief: queue a response frame
+  */
+static void connection_respond(Connection* connection, FrameKind kind, const char* body,
+		size_t length) {
+	char header[PROTOCOL_HEADER_SIZE];
+	uint32_t body_length = length;
+	memcpy(header, &body_length, sizeof(body_length));
+	header[4] = kind;
+	connection_append(connection, header, sizeof(header));
+	connection_append(connection, body, length);
+}
+
+static void connection_error(Connection* connection, const char* message) {
+	connection_respond(connection, RESPONSE_ERROR, message, strlen(message));
+}
+
+/**
+  * @brief: write queued responses until the socket is full
+  * @return: false if the client is gone
+  */
+static bool connection_write(Connection* connection) {
+	while (connection->pending_start < connection->pending_length) {
+		ssize_t written = send(connection->fd, connection->pending + connection->pending_start,
+				connection->pending_length - connection->pending_start, MSG_NOSIGNAL);
+		if (written > 0) {
+			connection->pending_start += written;
+		}
+		else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return true;
+		}
+		else if (errno != EINTR) {
+			return false;
+		}
+	}
+	connection->pending_start = 0;
+	connection->pending_length = 0;
+	return true;
+}
+
+/**
+  * @brief: a full buffer of rows of the statement being run, sent as a part
+  *         of its response so the result is never held whole or framed
+  *         past what a frame's length can say. It's written out right away
+  *         if the client is keeping up, a client gone is noticed after the
+  *         statement when the rest is written
+  */
+static void server_send_part(void* context, const char* data, size_t length) {
+	Server* server = context;
+	while (length > 0) {
+		size_t part = length < UINT32_MAX ? length : UINT32_MAX;
+		connection_respond(server->responding, RESPONSE_MORE, data, part);
+		connection_write(server->responding);
+		data += part;
+		length -= part;
+	}
+}
+
+/**
+  * @brief: run the statement of a request and queue its response. The
+  *         values are checked before anything is run, a request that doesn't
+  *         hold together gets an error like a bad statement does
+  */
+static void server_handle(Server* server, Connection* connection, const char* body,
+		uint32_t length) {
+	char values[MAX_PARAMETERS][TOKEN_MAX_LENGTH + 1];
+	PrepareResult result = PREPARE_SUCCESS;
+	uint32_t position = 1;
+	uint32_t num_values = length > 0 ? (uint8_t)body[0] : 0;
+	if (length == 0 || num_values > MAX_PARAMETERS) {
+		connection_error(connection, "Malformed request.");
+		return;
+	}
+	for (uint32_t i = 0; i < num_values; ++i) {
+		uint16_t size;
+		if (length - position < sizeof(size)) {
+			connection_error(connection, "Malformed request.");
+			return;
+		}
+		memcpy(&size, body + position, sizeof(size));
+		position += sizeof(size);
+		if (length - position < size) {
+			connection_error(connection, "Malformed request.");
+			return;
+		}
+		if (size > TOKEN_MAX_LENGTH) {
+			result = PREPARE_STRING_TOO_LONG;
+		}
+		else {
+			memcpy(values[i], body + position, size);
+			values[i][size] = '\0';
+		}
+		position += size;
+	}
+	memcpy(server->statement, body + position, length - position);
+	server->statement[length - position] = '\0';
+
+	PreparedStatement* prepared = NULL;
+	if (result == PREPARE_SUCCESS) {
+		prepared = statement_cache_prepare(server->statements, server->statement, &result);
+	}
+	for (uint32_t i = 0; result == PREPARE_SUCCESS && i < num_values; ++i) {
+		result = statement_bind_text(prepared, i + 1, values[i]);
+	}
+	if (result != PREPARE_SUCCESS) {
+		connection_error(connection, prepare_message(result));
+		return;
+	}
+	server->responding = connection;
+	ExecuteResult executed = statement_step(server->table, prepared, server->output);
+	if (executed != EXECUTE_SUCCESS) {
+		server->output->length = 0;
+		connection_error(connection, execute_message(executed));
+		return;
+	}
+	connection_respond(connection, RESPONSE_OK, server->output->buffer, server->output->length);
+	server->output->length = 0;
+}
+
+/**
+  * @brief: answer the whole requests read so far, until the client falls
+  *         SERVER_MAX_PENDING behind on reading the responses
+  * @return: false if a request is too long to be one
+  */
+static bool connection_process(Server* server, Connection* connection) {
+	size_t start = 0;
+	while (connection->pending_length - connection->pending_start < SERVER_MAX_PENDING
+			&& connection->input_length - start >= PROTOCOL_HEADER_SIZE) {
+		uint32_t length;
+		uint8_t kind;
+		protocol_decode_header(connection->input + start, &length, &kind);
+		if (length > SERVER_MAX_REQUEST) {
+			return false;
+		}
+		if (connection->input_length - start < PROTOCOL_HEADER_SIZE + length) {
+			break;
+		}
+		if (kind == REQUEST_STATEMENT) {
+			server_handle(server, connection, connection->input + start + PROTOCOL_HEADER_SIZE,
+					length);
+		}
+		else {
+			connection_error(connection, "Unknown request.");
+		}
+		start += PROTOCOL_HEADER_SIZE + length;
+	}
+	connection->input_length -= start;
+	memmove(connection->input, connection->input + start, connection->input_length);
+	return true;
+}
+
+/**
+  * @brief: whether a whole request is waiting to be answered
+  */
+static bool connection_has_request(Connection* connection) {
+	if (connection->input_length < PROTOCOL_HEADER_SIZE) {
+		return false;
+	}
+	uint32_t length;
+	uint8_t kind;
+	protocol_decode_header(connection->input, &length, &kind);
+	return connection->input_length >= PROTOCOL_HEADER_SIZE + length;
+}
+
+/**
+  * @brief: read what a client sent, once per event so one busy client can't
+  *         keep the others waiting
+  * @return: false once the client is done sending or gone
+  */
+static bool connection_read(Connection* connection) {
+	if (connection->input_capacity - connection->input_length < SERVER_READ_SIZE) {
+		connection->input_capacity += SERVER_READ_SIZE;
+		connection->input = realloc(connection->input, connection->input_capacity);
+	}
+	for (;;) {
+		ssize_t count = recv(connection->fd, connection->input + connection->input_length,
+				connection->input_capacity - connection->input_length, 0);
+		if (count > 0) {
+			connection->input_length += count;
+			return true;
+		}
+		if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return true;
+		}
+		if (count == 0 || errno != EINTR) {
+			return false;
+		}
+	}
+}
+
+static void server_watch(Server* server, Connection* connection, int op, uint32_t events) {
+	struct epoll_event event;
+	event.events = events;
+	event.data.ptr = connection;
+	if (epoll_ctl(server->epoll_fd, op, connection->fd, &event) == -1) {
+		printf("Error watching connection: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	connection->events = events;
+}
+
+/**
+  * @brief: new connection on fd, watched for requests
+  */
+static Connection* server_add(Server* server, int fd, bool listening, bool tcp) {
+	Connection* connection = malloc(sizeof(Connection));
+	connection->fd = fd;
+	connection->listening = listening;
+	connection->tcp = tcp;
+	connection->closing = false;
+	connection->input = NULL;
+	connection->input_length = 0;
+	connection->input_capacity = 0;
+	connection->pending_capacity = listening ? 0 : SERVER_READ_SIZE;
+	connection->pending = listening ? NULL : malloc(connection->pending_capacity);
+	connection->pending_start = 0;
+	connection->pending_length = 0;
+	connection->prev = NULL;
+	connection->next = server->connections;
+	if (server->connections != NULL) {
+		server->connections->prev = connection;
+	}
+	server->connections = connection;
+	server_watch(server, connection, EPOLL_CTL_ADD, EPOLLIN);
+	return connection;
+}
+
+static void server_remove(Server* server, Connection* connection) {
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+	close(connection->fd);
+	if (connection->prev != NULL) {
+		connection->prev->next = connection->next;
+	}
+	else {
+		server->connections = connection->next;
+	}
+	if (connection->next != NULL) {
+		connection->next->prev = connection->prev;
+	}
+	free(connection->input);
+	free(connection->pending);
+	free(connection);
+}
+
+/**
+  * @brief: answer, write and rewatch a client after it was readable or
+  *         writable. It's watched for reading only while it's keeping up with
+  *         the responses, and closed once it's done and every request it sent
+  *         is answered
+  */
+static void server_service(Server* server, Connection* connection) {
+	for (;;) {
+		if (!connection_process(server, connection) || !connection_write(connection)) {
+			server_remove(server, connection);
+			return;
+		}
+		if (connection->pending_length > 0) {
+			break;  // the rest is answered once the socket takes what's queued
+		}
+		if (!connection_has_request(connection)) {
+			if (connection->closing) {
+				server_remove(server, connection);
+				return;
+			}
+			break;
+		}
+	}
+	uint32_t events = 0;
+	if (!connection->closing
+			&& connection->pending_length - connection->pending_start < SERVER_MAX_PENDING) {
+		events |= EPOLLIN;
+	}
+	if (connection->pending_length > 0) {
+		events |= EPOLLOUT;
+	}
+	if (events != connection->events) {
+		server_watch(server, connection, EPOLL_CTL_MOD, events);
+	}
+}
+
+/**
+  * @brief: take every client waiting on a listening socket
+  */
+static void server_accept(Server* server, Connection* listener) {
+	for (;;) {
+		int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				printf("Error accepting connection: %d\n", errno);
+			}
+			if (errno != EINTR) {
+				return;
+			}
+			continue;
+		}
+		if (listener->tcp) {
+			// responses are written whole, don't hold the last bit of one back
+			int on = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		}
+		server_add(server, fd, false, listener->tcp);
+	}
+}
+
+/**
+  * @brief: listen on a bound socket
+  */
+static void server_listen(Server* server, int fd, const char* name, bool tcp) {
+	if (listen(fd, SOMAXCONN) == -1) {
+		printf("Unable to listen on '%s': %d\n", name, errno);
+		exit(EXIT_FAILURE);
+	}
+	server_add(server, fd, true, tcp);
+	printf("Listening on %s\n", name);
+}
+
+static void server_listen_unix(Server* server, const char* path) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		printf("Socket path '%s' is too long.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink(path);
+	if (fd == -1 || bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+		printf("Unable to listen on '%s': %d\n", path, errno);
+		exit(EXIT_FAILURE);
+	}
+	server_listen(server, fd, path, false);
+}
+
+static void server_listen_tcp(Server* server, uint16_t port) {
+	struct sockaddr_in address;
+	char name[32];
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	snprintf(name, sizeof(name), "127.0.0.1:%u", port);
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	int on = 1;
+	if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1
+			|| bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+		printf("Unable to listen on '%s': %d\n", name, errno);
+		exit(EXIT_FAILURE);
+	}
+	server_listen(server, fd, name, true);
+}
+
+static void server_stop(int signal) {
+	(void)signal;
+}
+
+/**
+  * @brief: serve clients until SIGINT or SIGTERM. The signals are blocked
+  *         except while waiting, so one arriving mid-statement ends the wait
+  *         after it instead of being missed
+  */
+void server_run(Table* table, OutputFormat format, const char* socket_path, uint16_t port) {
+	Server server;
+	server.table = table;
+	server.output = output_open_sink(server_send_part, &server, format);
+	server.responding = NULL;
+	server.statements = statement_cache_open(STATEMENT_CACHE_SIZE);
+	server.statement = malloc(SERVER_MAX_REQUEST + 1);
+	server.connections = NULL;
+	server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (server.epoll_fd == -1) {
+		printf("Error creating epoll instance: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+
+	sigset_t stop_signals;
+	sigset_t wait_mask;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	sigprocmask(SIG_BLOCK, &stop_signals, &wait_mask);
+	sigdelset(&wait_mask, SIGINT);
+	sigdelset(&wait_mask, SIGTERM);
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = server_stop;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	server_listen_unix(&server, socket_path);
+	if (port != 0) {
+		server_listen_tcp(&server, port);
+	}
+	fflush(stdout);
+
+	struct epoll_event events[SERVER_MAX_EVENTS];
+	for (;;) {
+		int count = epoll_pwait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1, &wait_mask);
+		if (count == -1) {
+			if (errno == EINTR) {
+				break;  // stop signal
+			}
+			printf("Error waiting for connections: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		for (int i = 0; i < count; ++i) {
+			Connection* connection = events[i].data.ptr;
+			if (connection->listening) {
+				server_accept(&server, connection);
+				continue;
+			}
+			if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection->closing) {
+				if (!connection_read(connection)) {
+					connection->closing = true;
+				}
+			}
+			server_service(&server, connection);
+		}
+	}
+
+	while (server.connections != NULL) {
+		server_remove(&server, server.connections);
+	}
+	unlink(socket_path);
+	close(server.epoll_fd);
+	free(server.statement);
+	statement_cache_close(server.statements);
+	output_close(server.output);
+	sigprocmask(SIG_UNBLOCK, &stop_signals, NULL);
+}
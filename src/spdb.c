@@ -0,0 +1,121 @@
+#include "../inc/spdb.h"
+
+/**
+  * @brief: start reading the rows of a prepared select. The leaves are
+  *         planned like execute_select() does, skipping those the zone map
+  *         rules out, but read in order by the caller rather than the pool.
+  *         Rows are those of the table when the query was opened
+  */
+ExecuteResult query_open(QueryCursor* query, Table* table, PreparedStatement* prepared) {
+	ExecuteResult result = statement_apply(prepared);
+	if (result != EXECUTE_SUCCESS) {
+		return result;
+	}
+	Statement* statement = &(prepared->statement);
+	if (statement->type != STATEMENT_SELECT || statement->num_aggregates > 0) {
+		return EXECUTE_NOT_A_QUERY;
+	}
+	query->statement = statement;
+	query->dictionary = table->dictionary;
+	pager_begin_read(table->pager);
+	compile_filter(statement, table);
+	scan_open(&query->scan, table, statement->key_range.low, statement->key_range.high,
+			statement->num_predicates > 0 ? zone_matches : NULL, statement);
+	pager_end_read(table->pager);
+	query->page = malloc(PAGE_SIZE);
+	query->leaf = 0;
+	query->node = NULL;
+	query->cell_num = 0;
+	query->end = 0;
+	query->remaining = statement->limit;
+	return EXECUTE_SUCCESS;
+}
+
+/**
+  * @brief: move to the next row the select matches, copying in the next leaf
+  *         of the scan once the current one runs out
+  */
+bool query_next(QueryCursor* query) {
+	Pager* pager = query->scan.table->pager;
+	if (query->remaining == 0) {
+		query->node = NULL;
+		return false;
+	}
+	if (query->node != NULL) {
+		query->cell_num++;
+	}
+	for (;;) {
+		if (query->node != NULL) {
+			for (; query->cell_num < query->end; ++query->cell_num) {
+				if (vm_run(&query->statement->filter, query->node, query->cell_num)) {
+					stats_add(STAT_ROWS_RETURNED, 1);
+					if (query->statement->limit != SELECT_NO_LIMIT) {
+						query->remaining--;
+					}
+					return true;
+				}
+			}
+			query->node = NULL;
+			query->leaf++;
+		}
+		if (query->leaf >= query->scan.num_leaves) {
+			return false;
+		}
+		if (query->leaf % SCAN_TASK_LEAVES == 0) {
+			scan_read_ahead(&query->scan, query->leaf);
+		}
+		pager_snapshot_read(pager, query->scan.snapshot, query->scan.leaves[query->leaf],
+				query->page);
+		query->node = query->page;
+		scan_leaf_cells(&query->scan, query->node, &query->cell_num, &query->end);
+		if (query->cell_num < query->end) {
+			stats_add(STAT_ROWS_SCANNED, query->end - query->cell_num);
+		}
+	}
+}
+
+uint32_t query_sl_no(const QueryCursor* query) {
+	return leaf_node_key(query->node, query->cell_num);
+}
+
+uint32_t query_year(const QueryCursor* query) {
+	uint32_t year;
+	memcpy(&year, leaf_node_field(query->node, query->cell_num, YEAR_OFFSET, YEAR_SIZE),
+			sizeof(year));
+	return year;
+}
+
+/**
+  * @brief: company of the current row, looked up by its code in a
+  *         dictionary leaf
+  */
+const char* query_company(const QueryCursor* query) {
+	const char* company = leaf_node_field(query->node, query->cell_num, COMPANY_OFFSET,
+			COMPANY_SIZE);
+	if (leaf_node_layout(query->node) == LEAF_LAYOUT_DICTIONARY) {
+		uint16_t code;
+		memcpy(&code, company, sizeof(code));
+		return dictionary_name(query->dictionary, code);
+	}
+	return company;
+}
+
+const char* query_model(const QueryCursor* query) {
+	return leaf_node_field(query->node, query->cell_num, MODEL_OFFSET, MODEL_SIZE);
+}
+
+double query_power(const QueryCursor* query) {
+	double power;
+	memcpy(&power, leaf_node_field(query->node, query->cell_num, POWER_OFFSET, POWER_SIZE),
+			sizeof(power));
+	return power;
+}
+
+/**
+  * @brief: stop reading, the snapshot is let go with the scan
+  */
+void query_close(QueryCursor* query) {
+	free(query->page);
+	query->node = NULL;
+	scan_close(&query->scan);
+}
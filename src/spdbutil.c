@@ -35,8 +35,6 @@ const uint32_t POWER_OFFSET = MODEL_OFFSET + MODEL_SIZE;
  * Also rows should not cross the page boundaries, since pages are not going to
  * exist side-by-side to each other in memory. */
 const uint32_t PAGE_SIZE = 4096;
-const uint32_t ROWS_PER_PAGE = PAGE_SIZE / ROW_SIZE;
-const uint32_t TABLE_MAX_ROWS = TABLE_MAX_PAGES * ROWS_PER_PAGE;
 
 /**
  * @brief: create new input buffer to perform I/O operation
@@ -58,9 +56,9 @@ void print_prompt() {
 
 /**
  * @brief: read input to created input buffer,
- *         read input from stdin for given length into the instance of InputBuffer
+ *         read a line from stream for given length into the instance of InputBuffer
  */
-void read_input(InputBuffer* input_buffer) {
+bool read_input(InputBuffer* input_buffer, FILE* stream) {
 	/* general syntax of getline():
 	 * getline(&buffer, &length, stdin);
 	 * and prototype for getline() is:
@@ -72,19 +70,17 @@ void read_input(InputBuffer* input_buffer) {
 	 * also use getline() read the file
 	 * */
 	ssize_t bytes_read =
-		getline(&(input_buffer->buffer), &(input_buffer->buffer_length), stdin);
+		getline(&(input_buffer->buffer), &(input_buffer->buffer_length), stream);
 	if (bytes_read <= 0) {
-		printf("Error reading input\n");
-		/* EXIT_FAILURE -> same as exit(1), representing failure
-		 * EXIT_SUCCESS -> same as exit(0), representing success
-		 * EXIT_SUCCESS, EXIT_FAILURE is std. way as some system actually use 0, 1
-		 * for opposite as said above
-		 * */
-		exit(EXIT_FAILURE);
-	}
-	// Ignore trailing new line
-	input_buffer->input_length = bytes_read - 1;
-	input_buffer->buffer[bytes_read - 1] = 0;
+		// end of input, caller decides whether that's an error
+		return false;
+	}
+	// Ignore trailing new line, last line of a script may not have one
+	if (input_buffer->buffer[bytes_read - 1] == '\n') {
+		input_buffer->buffer[--bytes_read] = 0;
+	}
+	input_buffer->input_length = bytes_read;
+	return true;
 }
 
 /**
@@ -96,57 +92,38 @@ MetaCommandResult do_meta_command(InputBuffer* input_buffer, Table* table) {
 		db_close(table);
 		exit(EXIT_SUCCESS);
 	}
-	else {
-		return META_COMMAND_UNRECOGNIZED;
+	else if (strncmp(input_buffer->buffer, ".import ", 8) == 0) {
+		char* filename = input_buffer->buffer + 8;
+		while (*filename == ' ') {
+			++filename;
+		}
+		ImportStats stats;
+		if (import_file(table, filename, &stats) == -1) {
+			printf("Unable to read '%s'.\n", filename);
+			return META_COMMAND_SUCCESS;
+		}
+		printf("Imported %lu rows in %.3f s (%.0f rows/s), %lu duplicate keys, %lu bad lines skipped.\n",
+				(unsigned long)stats.imported, stats.seconds,
+				stats.seconds > 0 ? stats.imported / stats.seconds : 0.0,
+				(unsigned long)stats.duplicates, (unsigned long)stats.bad_lines);
+		return META_COMMAND_SUCCESS;
 	}
-}
-
-PrepareResult prepare_insert(InputBuffer* input_buffer, Statement* statement) {
-	statement->type = STATEMENT_INSERT;
-
-	char* query_type = strtok(input_buffer->buffer, " ");
-	char* sl_no = strtok(NULL, " ");
-	char* mfd_year = strtok(NULL, " ");
-	char* comp_name = strtok(NULL, " ");
-	char* model_name = strtok(NULL, " ");
-	char* power = strtok(NULL, " ");
-
-	if ((sl_no == NULL)
-			|| (mfd_year == NULL)
-			|| (comp_name == NULL)
-			|| (model_name == NULL)
-			|| (power == NULL)) {
-		return PREPARE_SYNTAX_ERROR;
+	else if (strcmp(input_buffer->buffer, ".stats") == 0) {
+		stats_print(stdout, false);
+		return META_COMMAND_SUCCESS;
 	}
-
-	if ((strlen(comp_name) > COMPANY_SIZE)
-			|| (strlen(model_name) > MODEL_SIZE)) {
-		return PREPARE_STRING_TOO_LONG;
+	else if (strcmp(input_buffer->buffer, ".stats tsv") == 0) {
+		// every counter and histogram bucket as name<TAB>value, for scripts
+		stats_print(stdout, true);
+		return META_COMMAND_SUCCESS;
 	}
-
-	statement->row_to_insert.sl_no = atoi(sl_no);
-	statement->row_to_insert.year = atoi(mfd_year);
-	strcpy(statement->row_to_insert.company, comp_name);
-	strcpy(statement->row_to_insert.model, model_name);
-	statement->row_to_insert.power = atof(power);  // atof takes char* and returns double
-	/*free(query_type);*/
-	return PREPARE_SUCCESS;
-}
-
-/**
- * @brief: Prepare Statement, put data from created input buffer to created Statement,
- *         insert statement type and then data from input buffer to statement->row
- */
-PrepareResult prepare_statement(InputBuffer* input_buffer, Statement* statement) {
-	/* using strncmp, cause there will be queries after insert, select etc. queries */
-	if (strncmp(input_buffer->buffer, "insert", 6) == 0) {
-		return prepare_insert(input_buffer, statement);
+	else if (strcmp(input_buffer->buffer, ".stats reset") == 0) {
+		stats_reset();
+		return META_COMMAND_SUCCESS;
 	}
-	if (strncmp(input_buffer->buffer, "select", 6) == 0) {
-		statement->type = STATEMENT_SELECT;
-		return PREPARE_SUCCESS;
+	else {
+		return META_COMMAND_UNRECOGNIZED;
 	}
-	return PREPARE_UNRECOGNIZED_STATEMENT;
 }
 
 /**
@@ -171,220 +148,357 @@ void deserialize_row(void* source, Row* destination) {
 	memcpy(&(destination->power), source + POWER_OFFSET, POWER_SIZE);
 }
 
-/**
-  * @brief: create page, if not exists and/or provide the offset slot of row in which to store data
-  */
-void* row_slot(Table* table, uint32_t row_num) {
-	uint32_t page_num = row_num / ROWS_PER_PAGE;
-	void* page = get_page(table->pager, page_num);
-	uint32_t row_offset = row_num % ROWS_PER_PAGE;
-	uint32_t byte_offset = row_offset * ROW_SIZE;
-	return page + byte_offset;
-}
-
 /**
   * @brief: execution of insert statement(query),
-  *         check if table is full, if not, serialize row from statement set from InputBuffer
-  *         to table with provided page with correct byte offset and return status according to it
+  *         serialize row from statement set from InputBuffer and insert it into
+  *         the B+tree keyed on its sl_no, fails if that sl_no is already there.
+  *         Changed pages are committed to the log before returning. The
+  *         write latch keeps snapshots from being taken mid insert, and the
+  *         epoch pager_end_write() moves on to is what makes a snapshot taken
+  *         after it see the row, so a snapshot sees the whole row or none of it
   */
 ExecuteResult execute_insert(Table* table, Statement* statement) {
-	if (table->num_rows >= TABLE_MAX_ROWS) {
-		return EXECUTE_TABLE_FULL;
-	}
-
 	Row* row_to_insert = &(statement->row_to_insert);
-
-	/* source is row_to_insert,
-	   destination is table's page with provided byte_offset */
-	serialize_row(row_to_insert, row_slot(table, table->num_rows));
-	++table->num_rows;  // increasse the num_rows to show that row is now filled
-	return EXECUTE_SUCCESS;
+	uint8_t cell[LEAF_NODE_CELL_SIZE];
+	serialize_row(row_to_insert, cell);
+	ExecuteResult result = EXECUTE_SUCCESS;
+	pager_begin_write(table->pager);
+	if (table->num_rows == UINT32_MAX) {
+		result = EXECUTE_TABLE_FULL;
+	}
+	else if (btree_insert(table, row_to_insert->sl_no, cell) == BTREE_DUPLICATE_KEY) {
+		result = EXECUTE_DUPLICATE_KEY;
+	}
+	else {
+		// every statement is its own transaction
+		pager_commit(table->pager);
+	}
+	pager_end_write(table->pager);
+	return result;
 }
 
 /**
-  * @brief: execution of select statement(query),
-  *         deserialize_row from table, to new row instance(of Row struct) and
-  *         iterate through number of rows created in table to show full data
+  * @brief: whether a column whose values are in [min, max] may have one for
+  *         which "value op against" holds
   */
-ExecuteResult execute_select(Table* table) {
-	Row row;
-	for (uint32_t i = 0; i < table->num_rows; ++i) {
-		deserialize_row(row_slot(table,i), &row);
-		print_row(&row);
+static bool range_may_match(CompareOp op, double against, double min, double max) {
+	switch (op) {
+		case (COMPARE_EQUAL):
+			return min <= against && against <= max;
+		case (COMPARE_NOT_EQUAL):
+			return !(min == against && max == against);
+		case (COMPARE_LESS):
+			return min < against;
+		case (COMPARE_LESS_EQUAL):
+			return min <= against;
+		case (COMPARE_GREATER):
+			return max > against;
+		case (COMPARE_GREATER_EQUAL):
+			return max >= against;
 	}
-	return EXECUTE_SUCCESS;
+	return true;
 }
 
 /**
-  * @brief: see type of query from provied statement and execute it and provide table
-  *         on/from to perform action
+  * @brief: whether a leaf with the ranges of zone may have a row meeting
+  *         every predicate of the select. Company has no ranges and never
+  *         rules a leaf out
   */
-ExecuteResult execute_statement(Table* table, Statement* statement) {
-	switch (statement->type) {
-		case (STATEMENT_INSERT):
-			return execute_insert(table, statement);
-		case (STATEMENT_SELECT):
-			// return execute_select(table, statement);
-			return execute_select(table);
+bool zone_matches(void* context, const ZoneEntry* zone) {
+	Statement* statement = context;
+	for (uint32_t i = 0; i < statement->num_predicates; ++i) {
+		Predicate* predicate = &(statement->predicates[i]);
+		bool matches = true;
+		switch (predicate->column) {
+			case (COLUMN_SLNO):
+				matches = range_may_match(predicate->op, predicate->number, zone->min_key,
+						zone->max_key);
+				break;
+			case (COLUMN_YEAR):
+				matches = range_may_match(predicate->op, predicate->number, zone->min_year,
+						zone->max_year);
+				break;
+			case (COLUMN_POWER):
+				matches = range_may_match(predicate->op, predicate->real, zone->min_power,
+						zone->max_power);
+				break;
+			case (COLUMN_COMPANY):
+				break;
+		}
+		if (!matches) {
+			return false;
+		}
 	}
+	return true;
 }
 
+/* what the leaves of a select's scan write to */
+typedef struct {
+	Statement* statement;
+	Dictionary* dictionary;
+	Output* output;  // used when the scan runs on this thread alone
+	Output** parts;  // one per task of a batch when tasks run at once
+	uint32_t remaining;  // rows left to the limit, only counted with parts NULL
+} SelectScan;
+
 /**
-  * @brief: put data from specified file to created table
-  *         it calls pager_open(), which will open that database file
-  *         and will keep track of its size and sets different attribute for
-  *         Table object
-  * @return: newly created table
+  * @brief: hand the rows of a leaf meeting the predicates to output, a
+  *         columnar leaf's row is only put together once it's known to match
   */
-Table* db_open(const char* filename) {
-	Pager* pager = pager_open(filename);
-	uint32_t num_rows = pager->file_length / ROW_SIZE;
-	Table* table = malloc(sizeof(Table));
-	table->pager = pager;
-	table->num_rows = num_rows;
-	return table;
+static void select_leaf(void* context, uint32_t task, void* node, uint32_t start, uint32_t end) {
+	SelectScan* select = context;
+	Output* output = select->parts ? select->parts[task] : select->output;
+	uint8_t buffer[sizeof(Row)];  // a serialized row is never bigger than Row
+	uint32_t returned = 0;
+	for (uint32_t i = start; i < end && select->remaining > 0; ++i) {
+		if (vm_run(&select->statement->filter, node, i)) {
+			output_row(output, leaf_node_row(node, i, buffer, select->dictionary));
+			++returned;
+			if (select->parts == NULL) {
+				--select->remaining;
+			}
+		}
+	}
+	stats_add(STAT_ROWS_RETURNED, returned);
 }
 
 /**
-  * @brief: opens/creates the database file and keeps track of its length
-  *         opens file with read/write access mode and read and write permission
-  *         bits, and check if its successful, it then gets the file length with lseek()
-  *         with the help of SEEK_END constant as it makes the file offset to length of
-  *         file + offset(which is 0 here) and then it declares and initializes the Pager
-  *         object and provides appropriate settings for the attibute of Pager's object
-  */
-Pager* pager_open(const char* filename) {
-	/* int open(const char* filename, int flags[, mode_t mode]); */
-	int file_desc = open(filename,
-			// access modes
-			O_RDWR  // open the file for both reading and writing
-			// open-time flag
-			| O_CREAT,  // the file will be created if not already exist
-			// permission bits
-			S_IWUSR  // read permission for owner of file(0400)
-			| S_IRUSR); // write permission for owner(0200)
-	// Refer here for more details:
-	// https://www.gnu.org/software/libc/manual/html_node/Opening-and-Closing-Files.html
+ * Structure of IndexLookup
+ *
+ * where the rows an index lookup found are, settled with the writer kept
+ * out and read afterwards as of the snapshot taken then
+ */
+typedef struct {
+	uint32_t* page_nums;  // leaf of every row, in key order
+	uint32_t* cell_nums;  // cell of the row in its leaf
+	uint32_t num_rows;
+	Snapshot* snapshot;
+} IndexLookup;
 
-	if (file_desc == -1) {
-		printf("Unable to open file\n");
-		exit(EXIT_FAILURE);
+/**
+  * @brief: rows of a select with company = X looked up through the company
+  *         index, each by its key, in key order like a scan would give them.
+  *         A company with a big share of the rows is quicker to find by
+  *         scanning its leaves, left to the caller then. The caller holds the
+  *         read latch, only where the rows are is found here, they're read by
+  *         select_index_rows() once the writer is let back in
+  * @return: whether the index was used
+  */
+static bool select_by_company_index(Table* table, Statement* statement, IndexLookup* lookup) {
+	if (table->company_index == NULL) {
+		return false;
+	}
+	Predicate* company = NULL;
+	for (uint32_t i = 0; i < statement->num_predicates && company == NULL; ++i) {
+		Predicate* predicate = &(statement->predicates[i]);
+		if (predicate->column == COLUMN_COMPANY && predicate->op == COMPARE_EQUAL) {
+			company = predicate;
+		}
+	}
+	if (company == NULL) {
+		return false;
+	}
+	// pages are fetched with get_page(), other readers' scans share the pool
+	pthread_mutex_lock(&table->pager->lock);
+	uint32_t* keys;
+	uint32_t num_keys = hashindex_find(table->company_index,
+			hashindex_hash(company->text, company->text_length), &keys);
+	if (num_keys > table->num_rows / COMPANY_INDEX_MAX_SHARE) {
+		pthread_mutex_unlock(&table->pager->lock);
+		free(keys);
+		return false;
 	}
 
-	// refer to 'man lseek' for more info
-	off_t file_length = lseek(file_desc, 0, SEEK_END);
-
-	Pager* pager = malloc(sizeof(Pager));
-	pager->file_descriptor = file_desc;
-	pager->file_length = file_length;
-
-	for (uint32_t i = 0; i < TABLE_MAX_PAGES; ++i) {
-		pager->pages[i] = NULL;
+	qsort(keys, num_keys, sizeof(uint32_t), compare_uint32);
+	lookup->page_nums = malloc((num_keys ? num_keys : 1) * sizeof(uint32_t));
+	lookup->cell_nums = malloc((num_keys ? num_keys : 1) * sizeof(uint32_t));
+	lookup->num_rows = 0;
+	for (uint32_t i = 0; i < num_keys; ++i) {
+		if (keys[i] < statement->key_range.low || keys[i] > statement->key_range.high) {
+			continue;
+		}
+		Cursor cursor = table_find(table, keys[i]);
+		if (cursor.end_of_table || cursor_key(&cursor) != keys[i]) {
+			continue;
+		}
+		lookup->page_nums[lookup->num_rows] = cursor.page_num;
+		lookup->cell_nums[lookup->num_rows] = cursor.cell_num;
+		++lookup->num_rows;
 	}
-	return pager;
+	pthread_mutex_unlock(&table->pager->lock);
+	free(keys);
+	lookup->snapshot = pager_snapshot_open(table->pager);
+	return true;
 }
 
 /**
-  * @brief: fetches the required page and contains the logic of handling cache
-  *         miss. Assuming pages are saved one after one and every offset is of
-  *         PAGE_SIZE. If the requested page lies outside the bound of file it
-  *         should be empty so we'll create a empty page and return it else
-  *         simply return the page of required page_num
+  * @brief: hand the rows an index lookup found meeting the predicates to
+  *         output, copying their leaves as of its snapshot, without holding
+  *         anything a slow output would keep the writer or other readers
+  *         waiting on. Rows are in key order, so a leaf is copied once for
+  *         all of its rows
   */
-void* get_page(Pager* pager, uint32_t page_num) {
-	if (page_num > TABLE_MAX_ROWS) {
-		printf("Trying to access page out of bound\n");
-		exit(EXIT_FAILURE);
-	}
-	if (pager->pages[page_num] == NULL) {
-		// cache miss, allocate memory and load data from file
-		void* page = malloc(PAGE_SIZE);
-		uint32_t num_pages = pager->file_length / PAGE_SIZE;
-		// if any parital page missed
-		if (pager->file_length % PAGE_SIZE) {
-			num_pages++;
+static void select_index_rows(Table* table, Statement* statement, IndexLookup* lookup,
+		Output* output) {
+	Pager* pager = table->pager;
+	void* node = malloc(PAGE_SIZE);
+	uint32_t node_page = 0;  // the header page is never a leaf, so nothing is copied yet
+	uint8_t buffer[sizeof(Row)];
+	uint32_t returned = 0;
+	uint32_t i = 0;
+	for (; i < lookup->num_rows && returned < statement->limit; ++i) {
+		if (lookup->page_nums[i] != node_page) {
+			node_page = lookup->page_nums[i];
+			pager_snapshot_read(pager, lookup->snapshot, node_page, node);
 		}
-
-		if (page_num <= num_pages) {
-			// seek forward to size of page_num * PAGE_SIZE
-			lseek(pager->file_descriptor, page_num * PAGE_SIZE, SEEK_SET);
-			ssize_t bytes_read = read(pager->file_descriptor, page, PAGE_SIZE);
-			if (bytes_read == -1) {
-				printf("Error reading file: %d\n", errno);
-				exit(EXIT_FAILURE);
-			}
+		if (vm_run(&statement->filter, node, lookup->cell_nums[i])) {
+			output_row(output, leaf_node_row(node, lookup->cell_nums[i], buffer, table->dictionary));
+			++returned;
 		}
-		pager->pages[page_num] = page;
 	}
-	return pager->pages[page_num];
+	stats_add(STAT_ROWS_SCANNED, i);
+	stats_add(STAT_ROWS_RETURNED, returned);
+	free(node);
+	pager_snapshot_close(pager, lookup->snapshot);
+	free(lookup->page_nums);
+	free(lookup->cell_nums);
+	output_flush(output);
 }
 
 /**
-  * @brief: does following tasks:
-  *         calls pager_flush to flush the page cache to disk
-  *         closes the database file
-  *         frees memory of Pager and Table data structure
+  * @brief: execution of select statement(query),
+  *         only leaves which can hold keys in range are visited, so a point or
+  *         range lookup reads O(log n) pages, company = X goes through the
+  *         company index when the table has one, and rows meeting the other
+  *         conditions are handed to output straight from the page. A scan of
+  *         many leaves is split among the worker threads, every task formats
+  *         its rows into its own buffer and the buffers are written out in
+  *         task order, which is key order. A select with a limit runs its
+  *         tasks one after another instead and stops at the one reaching
+  *         it, the leaves after it are never read
   */
-void db_close(Table* table) {
+ExecuteResult execute_select(Table* table, Statement* statement, Output* output) {
+	// the filter, index lookup and leaf list are all settled with the writer
+	// kept out, the leaves are read after it's let back in
 	Pager* pager = table->pager;
-	uint32_t full_page_num = table->num_rows / ROWS_PER_PAGE;
-	for (int i = 0; i < full_page_num; ++i) {
-		// not many times this if statement is going to be true so branching
-		// will be less
-		if (pager->pages[i] == NULL) {
-			continue;
-		}
-		pager_flush(pager, i, PAGE_SIZE);
-		free(pager->pages[i]);
-		pager->pages[i] = NULL;
-	}
-	// There maybe partially filled page left at the end of file
-	uint32_t num_row_left = table->num_rows % ROWS_PER_PAGE;
-	if (num_row_left > 0) {
-		uint32_t page_num = full_page_num;
-		if (pager->pages[page_num] != NULL) {
-			pager_flush(pager, page_num, num_row_left * ROW_SIZE);
-			free(pager->pages[page_num]);
-			pager->pages[page_num] = NULL;
+	pager_begin_read(pager);
+	compile_filter(statement, table);
+	IndexLookup lookup;
+	if (statement->num_aggregates == 0 && select_by_company_index(table, statement, &lookup)) {
+		pager_end_read(pager);
+		select_index_rows(table, statement, &lookup, output);
+		return EXECUTE_SUCCESS;
+	}
+	Scan scan;
+	scan_open(&scan, table, statement->key_range.low, statement->key_range.high,
+			statement->num_predicates > 0 ? zone_matches : NULL, statement);
+	pager_end_read(pager);
+	if (statement->num_aggregates > 0) {
+		ExecuteResult result = execute_aggregate(table, statement, &scan, output);
+		scan_close(&scan);
+		return result;
+	}
+	SelectScan select;
+	select.statement = statement;
+	select.dictionary = table->dictionary;
+	select.output = output;
+	select.parts = NULL;
+	select.remaining = statement->limit;
+	if (statement->limit != SELECT_NO_LIMIT) {
+		for (uint32_t task = 0; task < scan.num_tasks && select.remaining > 0; ++task) {
+			scan_run(&scan, task, 1, select_leaf, &select);
 		}
 	}
-	int close_result = close(pager->file_descriptor);
-	if (close_result == -1) {
-		printf("Error closing in db file.\n");
-		exit(EXIT_FAILURE);
+	else if (!scan.parallel) {
+		scan_run(&scan, 0, scan.num_tasks, select_leaf, &select);
 	}
-	for (int i = 0; i < TABLE_MAX_PAGES; ++i) {
-		void* page = pager->pages[i];
-		if (page) {
-			free(page);
-			pager->pages[i] = NULL;
+	else {
+		select.parts = malloc(SCAN_BATCH_TASKS * sizeof(Output*));
+		for (uint32_t i = 0; i < SCAN_BATCH_TASKS; ++i) {
+			select.parts[i] = output_open(NULL, output->format);
+		}
+		for (uint32_t first = 0; first < scan.num_tasks; first += SCAN_BATCH_TASKS) {
+			uint32_t count = scan.num_tasks - first;
+			if (count > SCAN_BATCH_TASKS) {
+				count = SCAN_BATCH_TASKS;
+			}
+			scan_run(&scan, first, count, select_leaf, &select);
+			for (uint32_t i = 0; i < count; ++i) {
+				output_append(output, select.parts[i]);
+			}
 		}
+		for (uint32_t i = 0; i < SCAN_BATCH_TASKS; ++i) {
+			output_close(select.parts[i]);
+		}
+		free(select.parts);
 	}
-	free(pager);
-	free(table);
+	scan_close(&scan);
+	output_flush(output);
+	return EXECUTE_SUCCESS;
 }
 
 /**
-  * @brief: writes to db file(disk) from Pager->pages, it takes both page_num
-  *         and size as param even though we have fixed PAGE_SIZE because there
-  *         could be few rows left as partial page and have to save those to
-  *         file too
+  * @brief: see type of query from provied statement and execute it and provide table
+  *         on/from to perform action
   */
-void pager_flush(Pager* pager, uint32_t page_num, uint32_t size) {
-	if (pager->pages[page_num] == NULL) {
-		printf("Tried to flush NULL page.\n");
-		exit(EXIT_FAILURE);
+ExecuteResult execute_statement(Table* table, Statement* statement, Output* output) {
+	uint64_t start = stats_clock();
+	ExecuteResult result = EXECUTE_SUCCESS;
+	StatStatement kind = STAT_INSERT;
+	switch (statement->type) {
+		case (STATEMENT_INSERT):
+			result = execute_insert(table, statement);
+			break;
+		case (STATEMENT_SELECT):
+			kind = statement->num_aggregates > 0 ? STAT_AGGREGATE : STAT_SELECT;
+			result = execute_select(table, statement, output);
+			break;
 	}
-	off_t offset = lseek(pager->file_descriptor, page_num * size, SEEK_SET);
-	if (offset == -1) {
-		printf("Error seeking: %d\n", errno);
-		exit(EXIT_FAILURE);
+	stats_record_latency(kind, start);
+	return result;
+}
+
+/**
+  * @brief: put data from specified file to created table
+  *         it calls pager_open(), which will open that database file
+  *         and will keep track of its size, then reads the root page and row
+  *         count from the header page, or sets up an empty tree for a new file
+  * @return: newly created table
+  */
+Table* db_open(const char* filename, const PagerOptions* options, LeafLayout layout) {
+	Pager* pager = pager_open(filename, options);
+	Table* table = malloc(sizeof(Table));
+	table->pager = pager;
+	table->pool = NULL;
+	if (pager->num_pages == 0) {
+		btree_init(table, layout);
 	}
-	ssize_t bytes_written = write(pager->file_descriptor, pager->pages[page_num], size);
-	if (bytes_written == -1) {
-		printf("Error writing: %d\n", errno);
-		exit(EXIT_FAILURE);
+	else {
+		btree_load_header(table);
 	}
+	return table;
+}
+
+/**
+  * @brief: does following tasks:
+  *         writes back dirty pages left in the buffer pool
+  *         closes the database file, frees memory of Pager and Table data structure
+  */
+void db_close(Table* table) {
+	if (table->pool != NULL) {
+		threadpool_close(table->pool);
+	}
+	if (table->dictionary != NULL) {
+		dictionary_close(table->dictionary);
+	}
+	if (table->zones != NULL) {
+		zonemap_close(table->zones);
+	}
+	if (table->company_index != NULL) {
+		hashindex_close(table->company_index);
+	}
+	pager_close(table->pager);
+	free(table);
 }
 
 /**
@@ -406,3 +520,13 @@ void close_input_buffer(InputBuffer* input_buffer) {
 	// I think the problem with above line is that input_buffer->buffer is not dynamically allocated,
 	free(input_buffer);
 }
+
+/**
+  * @brief: qsort() comparator of uint32_t, shared by the pager's page
+  *         lists and the index lookup's keys
+  */
+int compare_uint32(const void* a, const void* b) {
+	uint32_t left = *(const uint32_t*)a;
+	uint32_t right = *(const uint32_t*)b;
+	return (left > right) - (left < right);
+}
@@ -0,0 +1,216 @@
+#include <pthread.h>
+#include <time.h>
+
+#include "../inc/spdbutil.h"
+
+static const char* counter_names[STAT_NUM_COUNTERS] = {
+	"page_hits",
+	"page_misses",
+	"read_ahead",
+	"bytes_read",
+	"bytes_written",
+	"read_calls",
+	"write_calls",
+	"sync_calls",
+	"rows_scanned",
+	"rows_returned"
+};
+
+static const char* statement_names[STAT_NUM_STATEMENTS] = {
+	"insert",
+	"select",
+	"aggregate"
+};
+
+static __thread Stats* stats_local;  // calling thread's block, NULL until it counts
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;  // to fold a block into stats_exited when its thread ends
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;  // of the lists below, not of counting
+static Stats* stats_threads;  // blocks of running threads
+static Stats stats_exited;  // what threads counted before they ended
+static Stats stats_base;  // totals at the last stats_reset()
+
+/**
+  * @brief: a value another thread may be adding to, read whole
+  */
+static uint64_t stats_load(const uint64_t* value) {
+	return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+/**
+  * @brief: add a block into the totals
+  */
+static void stats_sum(Stats* totals, const Stats* stats) {
+	for (uint32_t i = 0; i < STAT_NUM_COUNTERS; ++i) {
+		totals->counters[i] += stats_load(&stats->counters[i]);
+	}
+	for (uint32_t i = 0; i < STAT_NUM_STATEMENTS; ++i) {
+		for (uint32_t b = 0; b < STATS_LATENCY_BUCKETS; ++b) {
+			totals->latencies[i][b] += stats_load(&stats->latencies[i][b]);
+		}
+	}
+}
+
+/**
+  * @brief: thread ending, keep what it counted and free its block
+  */
+static void stats_thread_exit(void* argument) {
+	Stats* stats = argument;
+	pthread_mutex_lock(&stats_lock);
+	Stats** link = &stats_threads;
+	while (*link != stats) {
+		link = &(*link)->next;
+	}
+	*link = stats->next;
+	stats_sum(&stats_exited, stats);
+	pthread_mutex_unlock(&stats_lock);
+	free(stats);
+}
+
+static void stats_create_key(void) {
+	pthread_key_create(&stats_key, stats_thread_exit);
+}
+
+/**
+  * @brief: first count of a thread, give it a block
+  */
+static Stats* stats_register(void) {
+	pthread_once(&stats_once, stats_create_key);
+	Stats* stats = calloc(1, sizeof(Stats));
+	pthread_mutex_lock(&stats_lock);
+	stats->next = stats_threads;
+	stats_threads = stats;
+	pthread_mutex_unlock(&stats_lock);
+	pthread_setspecific(stats_key, stats);
+	stats_local = stats;
+	return stats;
+}
+
+/**
+  * @brief: only the owning thread writes its block, so the add needn't be
+  *         atomic, the store is just kept whole for readers
+  */
+void stats_add(StatCounter counter, uint64_t amount) {
+	Stats* stats = stats_local != NULL ? stats_local : stats_register();
+	__atomic_store_n(&stats->counters[counter], stats->counters[counter] + amount,
+			__ATOMIC_RELAXED);
+}
+
+uint64_t stats_clock(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void stats_record_latency(StatStatement statement, uint64_t start) {
+	uint64_t micros = (stats_clock() - start) / 1000;
+	uint32_t bucket = 0;
+	while (micros > 0 && bucket < STATS_LATENCY_BUCKETS - 1) {
+		micros >>= 1;
+		++bucket;
+	}
+	Stats* stats = stats_local != NULL ? stats_local : stats_register();
+	uint64_t* count = &stats->latencies[statement][bucket];
+	__atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+}
+
+/**
+  * @brief: totals since start, without subtracting the base
+  */
+static void stats_total(Stats* totals) {
+	memset(totals, 0, sizeof(Stats));
+	pthread_mutex_lock(&stats_lock);
+	stats_sum(totals, &stats_exited);
+	for (Stats* stats = stats_threads; stats != NULL; stats = stats->next) {
+		stats_sum(totals, stats);
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void stats_collect(Stats* totals) {
+	stats_total(totals);
+	pthread_mutex_lock(&stats_lock);
+	for (uint32_t i = 0; i < STAT_NUM_COUNTERS; ++i) {
+		totals->counters[i] -= stats_base.counters[i];
+	}
+	for (uint32_t i = 0; i < STAT_NUM_STATEMENTS; ++i) {
+		for (uint32_t b = 0; b < STATS_LATENCY_BUCKETS; ++b) {
+			totals->latencies[i][b] -= stats_base.latencies[i][b];
+		}
+	}
+	pthread_mutex_unlock(&stats_lock);
+	totals->next = NULL;
+}
+
+/**
+  * @brief: count from zero again, by remembering the totals now rather than
+  *         clearing blocks other threads are adding to
+  */
+void stats_reset(void) {
+	Stats totals;
+	stats_total(&totals);
+	pthread_mutex_lock(&stats_lock);
+	stats_base = totals;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+  * @brief: upper bound in microseconds of the bucket holding the share-th
+  *         of count latencies
+  */
+static uint64_t stats_percentile(const uint64_t* buckets, uint64_t count, double share) {
+	uint64_t rank = (uint64_t)(share * count);
+	uint64_t seen = 0;
+	for (uint32_t b = 0; b < STATS_LATENCY_BUCKETS; ++b) {
+		seen += buckets[b];
+		if (seen > rank) {
+			return (uint64_t)1 << b;
+		}
+	}
+	return (uint64_t)1 << (STATS_LATENCY_BUCKETS - 1);
+}
+
+/**
+  * @brief: print the totals, the histograms in full for machines and as
+  *         percentiles for people
+  */
+void stats_print(FILE* stream, bool machine) {
+	Stats totals;
+	stats_collect(&totals);
+	for (uint32_t i = 0; i < STAT_NUM_COUNTERS; ++i) {
+		fprintf(stream, machine ? "%s\t%lu\n" : "%-16s %lu\n", counter_names[i],
+				(unsigned long)totals.counters[i]);
+	}
+	for (uint32_t i = 0; i < STAT_NUM_STATEMENTS; ++i) {
+		const uint64_t* buckets = totals.latencies[i];
+		uint64_t count = 0;
+		for (uint32_t b = 0; b < STATS_LATENCY_BUCKETS; ++b) {
+			count += buckets[b];
+		}
+		if (machine) {
+			fprintf(stream, "%s_count\t%lu\n", statement_names[i], (unsigned long)count);
+			for (uint32_t b = 0; b < STATS_LATENCY_BUCKETS; ++b) {
+				// bucket by its upper bound, the last one has none
+				if (b < STATS_LATENCY_BUCKETS - 1) {
+					fprintf(stream, "%s_us_lt_%lu\t%lu\n", statement_names[i],
+							(unsigned long)1 << b, (unsigned long)buckets[b]);
+				}
+				else {
+					fprintf(stream, "%s_us_inf\t%lu\n", statement_names[i],
+							(unsigned long)buckets[b]);
+				}
+			}
+			continue;
+		}
+		if (count == 0) {
+			fprintf(stream, "%-16s 0\n", statement_names[i]);
+			continue;
+		}
+		fprintf(stream, "%-16s %lu, p50 < %luus, p99 < %luus, max < %luus\n", statement_names[i],
+				(unsigned long)count,
+				(unsigned long)stats_percentile(buckets, count, 0.5),
+				(unsigned long)stats_percentile(buckets, count, 0.99),
+				(unsigned long)stats_percentile(buckets, count, 1.0 - 1.0 / (2.0 * count)));
+	}
+	fflush(stream);
+}
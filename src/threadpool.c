@@ -0,0 +1,180 @@
+#include "../inc/spdbutil.h"
+
+/**
+  * @brief: next task of worker's own range
+  */
+static bool threadpool_take(TaskRange* range, uint32_t* task) {
+	bool found = false;
+	pthread_mutex_lock(&range->lock);
+	if (range->next < range->end) {
+		*task = range->next++;
+		found = true;
+	}
+	pthread_mutex_unlock(&range->lock);
+	return found;
+}
+
+/**
+  * @brief: take the back half of the first other worker's range that has
+  *         anything left, keep its first task and make the rest own range.
+  *         Tasks never add tasks, so once every range is empty the run is over
+  */
+static bool threadpool_steal(ThreadPool* pool, uint32_t self, uint32_t* task) {
+	uint32_t workers = pool->num_threads + 1;
+	for (uint32_t i = 1; i < workers; ++i) {
+		TaskRange* victim = &pool->ranges[(self + i) % workers];
+		pthread_mutex_lock(&victim->lock);
+		uint32_t left = victim->end - victim->next;
+		if (left == 0) {
+			pthread_mutex_unlock(&victim->lock);
+			continue;
+		}
+		uint32_t start = victim->end - (left + 1) / 2;
+		uint32_t end = victim->end;
+		victim->end = start;
+		pthread_mutex_unlock(&victim->lock);
+
+		TaskRange* own = &pool->ranges[self];
+		pthread_mutex_lock(&own->lock);
+		own->next = start + 1;
+		own->end = end;
+		pthread_mutex_unlock(&own->lock);
+		*task = start;
+		return true;
+	}
+	return false;
+}
+
+/**
+  * @brief: run tasks until there are none left anywhere
+  */
+static void threadpool_work(ThreadPool* pool, uint32_t self) {
+	uint32_t task;
+	while (threadpool_take(&pool->ranges[self], &task) || threadpool_steal(pool, self, &task)) {
+		pool->function(pool->context, task);
+	}
+}
+
+typedef struct {
+	ThreadPool* pool;
+	uint32_t self;
+} WorkerArgs;
+
+/**
+  * @brief: worker thread, sleeps until a run starts, works on it and reports
+  *         back when it's out of tasks
+  */
+static void* threadpool_worker(void* arg) {
+	WorkerArgs* args = arg;
+	ThreadPool* pool = args->pool;
+	uint32_t self = args->self;
+	free(args);
+
+	uint64_t seen = 0;
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		while (pool->run == seen && !pool->shutdown) {
+			pthread_cond_wait(&pool->work_ready, &pool->lock);
+		}
+		if (pool->shutdown) {
+			break;
+		}
+		seen = pool->run;
+		pthread_mutex_unlock(&pool->lock);
+
+		threadpool_work(pool, self);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0) {
+			pthread_cond_signal(&pool->work_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/**
+  * @brief: start workers
+  */
+ThreadPool* threadpool_open(uint32_t num_threads) {
+	ThreadPool* pool = malloc(sizeof(ThreadPool));
+	pool->num_threads = num_threads;
+	pool->threads = malloc(num_threads * sizeof(pthread_t));
+	pool->ranges = malloc((num_threads + 1) * sizeof(TaskRange));
+	for (uint32_t i = 0; i <= num_threads; ++i) {
+		pthread_mutex_init(&pool->ranges[i].lock, NULL);
+		pool->ranges[i].next = 0;
+		pool->ranges[i].end = 0;
+	}
+	pthread_mutex_init(&pool->run_lock, NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+	pool->run = 0;
+	pool->busy = 0;
+	pool->shutdown = false;
+
+	for (uint32_t i = 0; i < num_threads; ++i) {
+		WorkerArgs* args = malloc(sizeof(WorkerArgs));
+		args->pool = pool;
+		args->self = i;
+		if (pthread_create(&pool->threads[i], NULL, threadpool_worker, args) != 0) {
+			printf("Unable to start worker thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return pool;
+}
+
+/**
+  * @brief: run function(context, task) for task in [0, num_tasks), tasks are
+  *         dealt out in contiguous shares so neighbouring tasks, and the pages
+  *         they read, tend to stay on one thread
+  */
+void threadpool_run(ThreadPool* pool, TaskFunction function, void* context, uint32_t num_tasks) {
+	uint32_t workers = pool->num_threads + 1;
+	pthread_mutex_lock(&pool->run_lock);
+	pthread_mutex_lock(&pool->lock);
+	pool->function = function;
+	pool->context = context;
+	for (uint32_t i = 0; i < workers; ++i) {
+		pool->ranges[i].next = (uint32_t)((uint64_t)num_tasks * i / workers);
+		pool->ranges[i].end = (uint32_t)((uint64_t)num_tasks * (i + 1) / workers);
+	}
+	pool->busy = pool->num_threads;
+	pool->run++;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->lock);
+
+	threadpool_work(pool, pool->num_threads);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy > 0) {
+		pthread_cond_wait(&pool->work_done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	pthread_mutex_unlock(&pool->run_lock);
+}
+
+/**
+  * @brief: stop and join workers, free pool
+  */
+void threadpool_close(ThreadPool* pool) {
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->lock);
+	for (uint32_t i = 0; i < pool->num_threads; ++i) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	for (uint32_t i = 0; i <= pool->num_threads; ++i) {
+		pthread_mutex_destroy(&pool->ranges[i].lock);
+	}
+	pthread_mutex_destroy(&pool->run_lock);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work_ready);
+	pthread_cond_destroy(&pool->work_done);
+	free(pool->ranges);
+	free(pool->threads);
+	free(pool);
+}
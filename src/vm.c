@@ -0,0 +1,192 @@
+#include "../inc/spdbutil.h"
+
+/* a register holds a column of the row being tested */
+typedef union {
+	uint32_t number;
+	double real;
+	const char* text;
+} RegisterValue;
+
+/**
+  * @brief: add an instruction at the end of program
+  */
+static Instruction* program_emit(Program* program, Opcode opcode, Register reg) {
+	Instruction* instruction = &program->code[program->length++];
+	instruction->opcode = opcode;
+	instruction->reg = reg;
+	instruction->size = 0;
+	instruction->operand.offset = 0;
+	return instruction;
+}
+
+/**
+  * @brief: load of a column into its register, only the first time a
+  *         predicate needs it
+  */
+static void program_load(Program* program, bool* loaded, Opcode opcode, Register reg,
+		uint32_t offset, uint32_t size) {
+	if (loaded[reg]) {
+		return;
+	}
+	loaded[reg] = true;
+	Instruction* instruction = program_emit(program, opcode, reg);
+	instruction->operand.offset = offset;
+	instruction->size = size;
+}
+
+/**
+  * @brief: compile the predicates of a select into its filter, tests are in
+  *         the order the where clause has them. Company is compared by code
+  *         in a dictionary table, a name no row has gets a code no row has
+  */
+void compile_filter(Statement* statement, Table* table) {
+	Program* program = &(statement->filter);
+	bool loaded[REGISTER_COUNT] = {false};
+	program->length = 0;
+	for (uint32_t i = 0; i < statement->num_predicates; ++i) {
+		Predicate* predicate = &(statement->predicates[i]);
+		Instruction* test;
+		switch (predicate->column) {
+			case (COLUMN_SLNO):
+				program_load(program, loaded, OP_LOAD_UINT32, REGISTER_SLNO, SLNO_OFFSET, SLNO_SIZE);
+				// tests follow the order of CompareOp
+				test = program_emit(program, OP_UINT32_EQUAL + predicate->op, REGISTER_SLNO);
+				test->operand.number = predicate->number;
+				break;
+			case (COLUMN_YEAR):
+				program_load(program, loaded, OP_LOAD_UINT32, REGISTER_YEAR, YEAR_OFFSET, YEAR_SIZE);
+				test = program_emit(program, OP_UINT32_EQUAL + predicate->op, REGISTER_YEAR);
+				test->operand.number = predicate->number;
+				break;
+			case (COLUMN_POWER):
+				program_load(program, loaded, OP_LOAD_DOUBLE, REGISTER_POWER, POWER_OFFSET, POWER_SIZE);
+				test = program_emit(program, OP_DOUBLE_EQUAL + predicate->op, REGISTER_POWER);
+				test->operand.real = predicate->real;
+				break;
+			case (COLUMN_COMPANY):
+				if (table->dictionary != NULL) {
+					program_load(program, loaded, OP_LOAD_CODE, REGISTER_COMPANY, COMPANY_OFFSET,
+							COMPANY_SIZE);
+					test = program_emit(program, predicate->op == COMPARE_EQUAL
+							? OP_UINT32_EQUAL : OP_UINT32_NOT_EQUAL, REGISTER_COMPANY);
+					test->operand.number = dictionary_lookup(table->dictionary, predicate->text,
+							predicate->text_length);
+					break;
+				}
+				program_load(program, loaded, OP_LOAD_TEXT, REGISTER_COMPANY, COMPANY_OFFSET,
+						COMPANY_SIZE);
+				test = program_emit(program, predicate->op == COMPARE_EQUAL
+						? OP_TEXT_EQUAL : OP_TEXT_NOT_EQUAL, REGISTER_COMPANY);
+				test->operand.text = predicate->text;
+				test->size = predicate->text_length;
+				break;
+		}
+	}
+	program_emit(program, OP_MATCH, REGISTER_SLNO);
+}
+
+/**
+  * @brief: run a program on a cell of a leaf, columns are read in place so
+  *         rows that don't match are never copied out of the page, and a
+  *         columnar leaf only has the loaded columns read
+  */
+bool vm_run(const Program* program, void* node, uint32_t cell_num) {
+	RegisterValue registers[REGISTER_COUNT];
+	for (const Instruction* instruction = program->code; ; ++instruction) {
+		RegisterValue* value = &registers[instruction->reg];
+		switch ((Opcode)instruction->opcode) {
+			case (OP_LOAD_UINT32):
+				memcpy(&value->number, leaf_node_field(node, cell_num, instruction->operand.offset,
+							instruction->size), sizeof(uint32_t));
+				break;
+			case (OP_LOAD_DOUBLE):
+				memcpy(&value->real, leaf_node_field(node, cell_num, instruction->operand.offset,
+							instruction->size), sizeof(double));
+				break;
+			case (OP_LOAD_TEXT):
+				// stops at the terminator, a slotted record has nothing after it to pad
+				value->text = leaf_node_field(node, cell_num, instruction->operand.offset,
+						instruction->size);
+				break;
+			case (OP_LOAD_CODE): {
+				uint16_t code;
+				memcpy(&code, leaf_node_field(node, cell_num, instruction->operand.offset,
+							instruction->size), sizeof(code));
+				value->number = code;
+				break;
+			}
+			case (OP_UINT32_EQUAL):
+				if (!(value->number == instruction->operand.number)) {
+					return false;
+				}
+				break;
+			case (OP_UINT32_NOT_EQUAL):
+				if (!(value->number != instruction->operand.number)) {
+					return false;
+				}
+				break;
+			case (OP_UINT32_LESS):
+				if (!(value->number < instruction->operand.number)) {
+					return false;
+				}
+				break;
+			case (OP_UINT32_LESS_EQUAL):
+				if (!(value->number <= instruction->operand.number)) {
+					return false;
+				}
+				break;
+			case (OP_UINT32_GREATER):
+				if (!(value->number > instruction->operand.number)) {
+					return false;
+				}
+				break;
+			case (OP_UINT32_GREATER_EQUAL):
+				if (!(value->number >= instruction->operand.number)) {
+					return false;
+				}
+				break;
+			case (OP_DOUBLE_EQUAL):
+				if (!(value->real == instruction->operand.real)) {
+					return false;
+				}
+				break;
+			case (OP_DOUBLE_NOT_EQUAL):
+				if (!(value->real != instruction->operand.real)) {
+					return false;
+				}
+				break;
+			case (OP_DOUBLE_LESS):
+				if (!(value->real < instruction->operand.real)) {
+					return false;
+				}
+				break;
+			case (OP_DOUBLE_LESS_EQUAL):
+				if (!(value->real <= instruction->operand.real)) {
+					return false;
+				}
+				break;
+			case (OP_DOUBLE_GREATER):
+				if (!(value->real > instruction->operand.real)) {
+					return false;
+				}
+				break;
+			case (OP_DOUBLE_GREATER_EQUAL):
+				if (!(value->real >= instruction->operand.real)) {
+					return false;
+				}
+				break;
+			case (OP_TEXT_EQUAL):
+				if (strncmp(value->text, instruction->operand.text, instruction->size + 1) != 0) {
+					return false;
+				}
+				break;
+			case (OP_TEXT_NOT_EQUAL):
+				if (strncmp(value->text, instruction->operand.text, instruction->size + 1) == 0) {
+					return false;
+				}
+				break;
+			case (OP_MATCH):
+				return true;
+		}
+	}
+}
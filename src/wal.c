@@ -0,0 +1,434 @@
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "../inc/spdbutil.h"
+
+/* log header
+
+   attr        size     offset
+   magic       4        0
+   page_size   4        4
+   salt        4        8
+   reserved    4        12
+   */
+const uint32_t WAL_HEADER_SIZE = 16;
+
+/* every frame is a header followed by a page
+
+   attr        size     offset
+   page_num    4        0
+   commit      4        4    pages in database if this frame ends a transaction, else 0
+   salt        4        8    salt of the log when frame was written
+   checksum    4        12   over the first 12 bytes and the page
+   */
+const uint32_t WAL_FRAME_HEADER_SIZE = 16;
+
+/**
+  * @brief: Fletcher style checksum of frame header fields and page, cheap
+  *         enough to run on every frame and catches torn writes at the tail
+  */
+static uint32_t wal_checksum(uint32_t* header, void* page) {
+	uint32_t s1 = 0;
+	uint32_t s2 = 0;
+	for (uint32_t i = 0; i < 3; ++i) {
+		s1 += header[i];
+		s2 += s1;
+	}
+	uint32_t* words = page;
+	for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); ++i) {
+		s1 += words[i];
+		s2 += s1;
+	}
+	return s1 ^ (s2 << 16) ^ (s2 >> 16);
+}
+
+/**
+  * @brief: write log header with the current salt
+  */
+static void wal_write_header(Wal* wal) {
+	uint32_t header[4] = {WAL_MAGIC, PAGE_SIZE, wal->salt, 0};
+	if (pwrite(wal->file_descriptor, header, WAL_HEADER_SIZE, 0) == -1) {
+		printf("Error writing log: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+  * @brief: open or create the log of a database file, a log with a bad
+  *         header is started over as nothing in it can be trusted
+  */
+Wal* wal_open(const char* db_filename, WalSyncPolicy sync) {
+	Wal* wal = malloc(sizeof(Wal));
+	wal->filename = malloc(strlen(db_filename) + sizeof("-wal"));
+	strcpy(wal->filename, db_filename);
+	strcat(wal->filename, "-wal");
+
+	wal->file_descriptor = open(wal->filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+	if (wal->file_descriptor == -1) {
+		printf("Unable to open log file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	wal->index = NULL;
+	wal->index_length = 0;
+	wal->pages = NULL;
+	wal->num_pages = 0;
+	wal->pages_capacity = 0;
+	wal->num_frames = 0;
+	wal->end = WAL_HEADER_SIZE;
+	wal->sync = sync;
+	wal->group_size = WAL_DEFAULT_GROUP_SIZE;
+	wal->group_interval_ms = WAL_DEFAULT_GROUP_INTERVAL_MS;
+	wal->unsynced_commits = 0;
+	pthread_mutex_init(&wal->sync_lock, NULL);
+	// deadlines are taken from the monotonic clock like first_unsynced
+	pthread_condattr_t wake_attributes;
+	pthread_condattr_init(&wake_attributes);
+	pthread_condattr_setclock(&wake_attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&wal->syncer_wake, &wake_attributes);
+	pthread_condattr_destroy(&wake_attributes);
+	wal->syncer_running = false;
+	wal->closing = false;
+	wal->checkpoint_frames = WAL_DEFAULT_CHECKPOINT_FRAMES;
+
+	uint32_t header[4];
+	ssize_t bytes_read = pread(wal->file_descriptor, header, WAL_HEADER_SIZE, 0);
+	if (bytes_read == WAL_HEADER_SIZE && header[0] == WAL_MAGIC && header[1] == PAGE_SIZE) {
+		wal->salt = header[2];
+	}
+	else {
+		wal->salt = (uint32_t)time(NULL);
+		wal_reset(wal);
+	}
+	return wal;
+}
+
+/**
+  * @brief: point page_num at the frame at offset, index grows by doubling.
+  *         Pages are also listed the first time they show up so checkpoint
+  *         and reset only look at pages in the log, not the whole index
+  */
+static void wal_index_set(Wal* wal, uint32_t page_num, off_t offset) {
+	if (page_num >= wal->index_length) {
+		uint32_t length = wal->index_length ? wal->index_length : 64;
+		while (length <= page_num) {
+			length *= 2;
+		}
+		wal->index = realloc(wal->index, length * sizeof(off_t));
+		memset(wal->index + wal->index_length, 0, (length - wal->index_length) * sizeof(off_t));
+		wal->index_length = length;
+	}
+	if (wal->index[page_num] == 0) {
+		if (wal->num_pages == wal->pages_capacity) {
+			wal->pages_capacity = wal->pages_capacity ? wal->pages_capacity * 2 : 64;
+			wal->pages = realloc(wal->pages, wal->pages_capacity * sizeof(uint32_t));
+		}
+		wal->pages[wal->num_pages++] = page_num;
+	}
+	wal->index[page_num] = offset;
+}
+
+/**
+  * @brief: scan frames left by an earlier session. Frames are only trusted
+  *         up to the last commit frame whose salt and checksum match, a
+  *         transaction cut short by a crash is dropped along with anything
+  *         after it. A log with frames but no commit is reset on the spot
+  */
+uint32_t wal_recover(Wal* wal) {
+	uint32_t commit_pages = 0;
+	uint32_t frame_size = WAL_FRAME_HEADER_SIZE + PAGE_SIZE;
+	void* frame = malloc(frame_size);
+	// pages of the transaction being read, indexed once its commit frame shows up
+	uint32_t* pending_pages = malloc(sizeof(uint32_t) * 64);
+	off_t* pending_offsets = malloc(sizeof(off_t) * 64);
+	uint32_t pending_capacity = 64;
+	uint32_t num_pending = 0;
+
+	off_t offset = WAL_HEADER_SIZE;
+	off_t committed_end = WAL_HEADER_SIZE;
+	uint32_t committed_frames = 0;
+	uint32_t frames = 0;
+	while (pread(wal->file_descriptor, frame, frame_size, offset) == frame_size) {
+		uint32_t* header = frame;
+		if (header[2] != wal->salt
+				|| header[3] != wal_checksum(header, frame + WAL_FRAME_HEADER_SIZE)) {
+			break;
+		}
+		if (num_pending == pending_capacity) {
+			pending_capacity *= 2;
+			pending_pages = realloc(pending_pages, sizeof(uint32_t) * pending_capacity);
+			pending_offsets = realloc(pending_offsets, sizeof(off_t) * pending_capacity);
+		}
+		pending_pages[num_pending] = header[0];
+		pending_offsets[num_pending] = offset;
+		++num_pending;
+		++frames;
+		offset += frame_size;
+
+		if (header[1] != 0) {
+			for (uint32_t i = 0; i < num_pending; ++i) {
+				wal_index_set(wal, pending_pages[i], pending_offsets[i]);
+			}
+			num_pending = 0;
+			commit_pages = header[1];
+			committed_end = offset;
+			committed_frames = frames;
+		}
+	}
+	free(frame);
+	free(pending_pages);
+	free(pending_offsets);
+
+	wal->end = committed_end;
+	wal->num_frames = committed_frames;
+	// session which wrote them may not have synced them, checkpoint will
+	if (committed_frames > 0) {
+		wal->unsynced_commits = 1;
+		clock_gettime(CLOCK_MONOTONIC, &wal->first_unsynced);
+	}
+	else if (lseek(wal->file_descriptor, 0, SEEK_END) > WAL_HEADER_SIZE) {
+		// nothing committed, so checkpoint won't reset the log. Frames are
+		// checksummed one at a time, left with this salt they could be read
+		// as the rest of a later transaction cut short before its commit
+		wal_reset(wal);
+	}
+	return commit_pages;
+}
+
+/**
+  * @brief: offset of the latest frame of page_num, 0 if page isn't in the log
+  */
+off_t wal_find(Wal* wal, uint32_t page_num) {
+	if (page_num >= wal->index_length) {
+		return 0;
+	}
+	return wal->index[page_num];
+}
+
+/**
+  * @brief: read page contents of the frame at offset
+  */
+void wal_read_page(Wal* wal, off_t offset, void* page) {
+	ssize_t bytes_read = pread(wal->file_descriptor, page, PAGE_SIZE, offset + WAL_FRAME_HEADER_SIZE);
+	if (bytes_read != PAGE_SIZE) {
+		printf("Error reading log: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	stats_add(STAT_READ_CALLS, 1);
+	stats_add(STAT_BYTES_READ, bytes_read);
+}
+
+/**
+  * @brief: append a frame for each of pages. Frame headers are built in one
+  *         array and every frame goes out as (header, page) pair of iovecs,
+  *         so a whole transaction is a single pwritev() without copying pages
+  */
+void wal_append_pages(Wal* wal, uint32_t* page_nums, void** pages, uint32_t count,
+		uint32_t commit_pages) {
+	uint32_t frame_size = WAL_FRAME_HEADER_SIZE + PAGE_SIZE;
+	uint32_t max_frames = IOV_MAX / 2;
+	uint32_t* headers = malloc(count * WAL_FRAME_HEADER_SIZE);
+	struct iovec* iov = malloc(2 * (count < max_frames ? count : max_frames) * sizeof(struct iovec));
+
+	for (uint32_t done = 0; done < count;) {
+		uint32_t batch = count - done;
+		if (batch > max_frames) {
+			batch = max_frames;
+		}
+		for (uint32_t i = 0; i < batch; ++i) {
+			uint32_t n = done + i;
+			uint32_t* header = headers + n * 4;
+			header[0] = page_nums[n];
+			header[1] = (n == count - 1) ? commit_pages : 0;
+			header[2] = wal->salt;
+			header[3] = wal_checksum(header, pages[n]);
+			iov[2 * i].iov_base = header;
+			iov[2 * i].iov_len = WAL_FRAME_HEADER_SIZE;
+			iov[2 * i + 1].iov_base = pages[n];
+			iov[2 * i + 1].iov_len = PAGE_SIZE;
+		}
+		ssize_t expected = (ssize_t)batch * frame_size;
+		if (pwritev(wal->file_descriptor, iov, 2 * batch, wal->end) != expected) {
+			printf("Error writing log: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		stats_add(STAT_WRITE_CALLS, 1);
+		stats_add(STAT_BYTES_WRITTEN, expected);
+		for (uint32_t i = 0; i < batch; ++i) {
+			wal_index_set(wal, page_nums[done + i], wal->end);
+			wal->end += frame_size;
+		}
+		wal->num_frames += batch;
+		done += batch;
+	}
+	free(headers);
+	free(iov);
+}
+
+/**
+  * @brief: append a frame holding page
+  */
+void wal_append(Wal* wal, uint32_t page_num, void* page, uint32_t commit_pages) {
+	wal_append_pages(wal, &page_num, &page, 1, commit_pages);
+}
+
+/**
+  * @brief: fsync the log if any commit isn't synced yet, sync_lock is held
+  */
+static void wal_sync_locked(Wal* wal) {
+	if (wal->unsynced_commits == 0) {
+		return;
+	}
+	if (fdatasync(wal->file_descriptor) == -1) {
+		printf("Error syncing log: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	stats_add(STAT_SYNC_CALLS, 1);
+	wal->unsynced_commits = 0;
+}
+
+void wal_sync(Wal* wal) {
+	pthread_mutex_lock(&wal->sync_lock);
+	wal_sync_locked(wal);
+	pthread_mutex_unlock(&wal->sync_lock);
+}
+
+/**
+  * @brief: when the oldest unsynced commit has waited group_interval_ms
+  */
+static struct timespec wal_sync_deadline(Wal* wal) {
+	struct timespec deadline = wal->first_unsynced;
+	deadline.tv_sec += wal->group_interval_ms / 1000;
+	deadline.tv_nsec += (long)(wal->group_interval_ms % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+	return deadline;
+}
+
+/**
+  * @brief: sync a group once its oldest commit is due, for when the writer
+  *         goes idle and no commit comes along to do it. Only holds
+  *         sync_lock, never the pager's latch, so readers don't wait on it
+  */
+static void* wal_syncer(void* argument) {
+	Wal* wal = argument;
+	pthread_mutex_lock(&wal->sync_lock);
+	while (!wal->closing) {
+		if (wal->unsynced_commits == 0) {
+			pthread_cond_wait(&wal->syncer_wake, &wal->sync_lock);
+			continue;
+		}
+		struct timespec deadline = wal_sync_deadline(wal);
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec > deadline.tv_sec
+				|| (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+			wal_sync_locked(wal);
+			continue;
+		}
+		pthread_cond_timedwait(&wal->syncer_wake, &wal->sync_lock, &deadline);
+	}
+	pthread_mutex_unlock(&wal->sync_lock);
+	return NULL;
+}
+
+/**
+  * @brief: a transaction has been committed, fsync according to sync policy.
+  *         With WAL_SYNC_NORMAL commits are grouped, the log is synced once
+  *         group_size commits are waiting or the oldest of them has waited
+  *         group_interval_ms, so one fsync pays for the whole batch. The
+  *         syncer thread holds a group to the interval when no commit
+  *         follows to check it
+  */
+void wal_commit(Wal* wal) {
+	if (wal->sync == WAL_SYNC_OFF) {
+		return;
+	}
+	if (wal->sync == WAL_SYNC_NORMAL && !wal->syncer_running) {
+		if (pthread_create(&wal->syncer, NULL, wal_syncer, wal) != 0) {
+			printf("Error starting log syncer: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		wal->syncer_running = true;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&wal->sync_lock);
+	if (wal->unsynced_commits == 0) {
+		wal->first_unsynced = now;
+		pthread_cond_signal(&wal->syncer_wake);
+	}
+	wal->unsynced_commits++;
+
+	if (wal->sync == WAL_SYNC_FULL || wal->unsynced_commits >= wal->group_size) {
+		wal_sync_locked(wal);
+	}
+	else {
+		int64_t waited_ms = (now.tv_sec - wal->first_unsynced.tv_sec) * 1000
+			+ (now.tv_nsec - wal->first_unsynced.tv_nsec) / 1000000;
+		if (waited_ms >= wal->group_interval_ms) {
+			wal_sync_locked(wal);
+		}
+	}
+	pthread_mutex_unlock(&wal->sync_lock);
+}
+
+/**
+  * @brief: whether the log has grown enough to be checkpointed
+  */
+bool wal_needs_checkpoint(Wal* wal) {
+	return wal->num_frames >= wal->checkpoint_frames;
+}
+
+/**
+  * @brief: empty the log after its pages have been checkpointed
+  */
+void wal_reset(Wal* wal) {
+	wal->salt++;
+	if (ftruncate(wal->file_descriptor, WAL_HEADER_SIZE) == -1) {
+		printf("Error truncating log: %d\n", errno);
+		exit(EXIT_FAILURE);
+	}
+	wal_write_header(wal);
+	if (wal->sync != WAL_SYNC_OFF) {
+		if (fdatasync(wal->file_descriptor) == -1) {
+			printf("Error syncing log: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		stats_add(STAT_SYNC_CALLS, 1);
+	}
+	for (uint32_t i = 0; i < wal->num_pages; ++i) {
+		wal->index[wal->pages[i]] = 0;
+	}
+	wal->num_pages = 0;
+	wal->end = WAL_HEADER_SIZE;
+	wal->num_frames = 0;
+	pthread_mutex_lock(&wal->sync_lock);
+	wal->unsynced_commits = 0;
+	pthread_mutex_unlock(&wal->sync_lock);
+}
+
+/**
+  * @brief: close the log, deleting the file if asked to
+  */
+void wal_close(Wal* wal, bool remove_file) {
+	if (wal->syncer_running) {
+		pthread_mutex_lock(&wal->sync_lock);
+		wal->closing = true;
+		pthread_cond_signal(&wal->syncer_wake);
+		pthread_mutex_unlock(&wal->sync_lock);
+		pthread_join(wal->syncer, NULL);
+	}
+	pthread_mutex_destroy(&wal->sync_lock);
+	pthread_cond_destroy(&wal->syncer_wake);
+	close(wal->file_descriptor);
+	if (remove_file) {
+		unlink(wal->filename);
+	}
+	free(wal->index);
+	free(wal->pages);
+	free(wal->filename);
+	free(wal);
+}
@@ -0,0 +1,165 @@
+#include <math.h>
+
+#include "../inc/spdbutil.h"
+
+static const uint32_t ZONE_NEXT_PAGE_OFFSET = 0;
+static const uint32_t ZONE_HEADER_SIZE = 8;  // next_page and padding
+
+/**
+  * @brief: entry of a leaf with no rows
+  */
+void zone_entry_init(ZoneEntry* entry) {
+	entry->min_key = UINT32_MAX;
+	entry->max_key = 0;
+	entry->min_year = UINT32_MAX;
+	entry->max_year = 0;
+	entry->min_power = INFINITY;
+	entry->max_power = -INFINITY;
+}
+
+/**
+  * @brief: entry covering every value, for pages never set
+  */
+static void zone_entry_init_unknown(ZoneEntry* entry) {
+	entry->min_key = 0;
+	entry->max_key = UINT32_MAX;
+	entry->min_year = 0;
+	entry->max_year = UINT32_MAX;
+	entry->min_power = -INFINITY;
+	entry->max_power = INFINITY;
+}
+
+/**
+  * @brief: widen entry to hold a row
+  */
+void zone_entry_add(ZoneEntry* entry, uint32_t key, uint32_t year, double power) {
+	if (key < entry->min_key) {
+		entry->min_key = key;
+	}
+	if (key > entry->max_key) {
+		entry->max_key = key;
+	}
+	if (year < entry->min_year) {
+		entry->min_year = year;
+	}
+	if (year > entry->max_year) {
+		entry->max_year = year;
+	}
+	if (power < entry->min_power) {
+		entry->min_power = power;
+	}
+	if (power > entry->max_power) {
+		entry->max_power = power;
+	}
+}
+
+static void* zonemap_entry_in_page(void* page, uint32_t index) {
+	return page + ZONE_HEADER_SIZE + index * sizeof(ZoneEntry);
+}
+
+/**
+  * @brief: add a page at the end of the chain, every entry of it unknown
+  */
+static void zonemap_add_page(ZoneMap* zones, uint32_t page_num) {
+	if (zones->num_pages == zones->pages_capacity) {
+		zones->pages_capacity = zones->pages_capacity ? zones->pages_capacity * 2 : 16;
+		zones->pages = realloc(zones->pages, zones->pages_capacity * sizeof(uint32_t));
+		zones->entries = realloc(zones->entries,
+				zones->pages_capacity * ZONE_ENTRIES_PER_PAGE * sizeof(ZoneEntry));
+	}
+	zones->pages[zones->num_pages++] = page_num;
+}
+
+/**
+  * @brief: allocate the next page of the chain and link it after the last one
+  */
+static void zonemap_grow(ZoneMap* zones) {
+	Pager* pager = zones->pager;
+	uint32_t page_num = pager_allocate_page(pager);
+	if (zones->num_pages > 0) {
+		void* last = get_page_for_write(pager, zones->pages[zones->num_pages - 1]);
+		memcpy(last + ZONE_NEXT_PAGE_OFFSET, &page_num, sizeof(uint32_t));
+	}
+	zonemap_add_page(zones, page_num);
+
+	void* page = get_page_for_write(pager, page_num);
+	memset(page, 0, PAGE_SIZE);
+	ZoneEntry* entries = zones->entries + (zones->num_pages - 1) * ZONE_ENTRIES_PER_PAGE;
+	for (uint32_t i = 0; i < ZONE_ENTRIES_PER_PAGE; ++i) {
+		zone_entry_init_unknown(&entries[i]);
+	}
+	memcpy(zonemap_entry_in_page(page, 0), entries, ZONE_ENTRIES_PER_PAGE * sizeof(ZoneEntry));
+}
+
+static ZoneMap* zonemap_new(Pager* pager) {
+	ZoneMap* zones = malloc(sizeof(ZoneMap));
+	zones->pager = pager;
+	zones->first_page = 0;
+	zones->pages = NULL;
+	zones->num_pages = 0;
+	zones->pages_capacity = 0;
+	zones->entries = NULL;
+	return zones;
+}
+
+/**
+  * @brief: new zone map with its first page allocated
+  */
+ZoneMap* zonemap_create(Pager* pager) {
+	ZoneMap* zones = zonemap_new(pager);
+	zonemap_grow(zones);
+	zones->first_page = zones->pages[0];
+	return zones;
+}
+
+/**
+  * @brief: load a zone map written before, following its pages
+  */
+ZoneMap* zonemap_open(Pager* pager, uint32_t first_page) {
+	ZoneMap* zones = zonemap_new(pager);
+	zones->first_page = first_page;
+	uint32_t page_num = first_page;
+	while (page_num != 0) {
+		zonemap_add_page(zones, page_num);
+		void* page = get_page(pager, page_num);
+		memcpy(zones->entries + (zones->num_pages - 1) * ZONE_ENTRIES_PER_PAGE,
+				zonemap_entry_in_page(page, 0), ZONE_ENTRIES_PER_PAGE * sizeof(ZoneEntry));
+		memcpy(&page_num, page + ZONE_NEXT_PAGE_OFFSET, sizeof(uint32_t));
+	}
+	return zones;
+}
+
+/**
+  * @brief: entry of a page, NULL if the map doesn't reach it
+  */
+const ZoneEntry* zonemap_get(ZoneMap* zones, uint32_t page_num) {
+	if (page_num >= zones->num_pages * ZONE_ENTRIES_PER_PAGE) {
+		return NULL;
+	}
+	return &zones->entries[page_num];
+}
+
+/**
+  * @brief: replace the entry of a page, rows inserted without changing the
+  *         ranges of their leaf don't write anything
+  */
+void zonemap_set(ZoneMap* zones, uint32_t page_num, const ZoneEntry* entry) {
+	while (page_num >= zones->num_pages * ZONE_ENTRIES_PER_PAGE) {
+		zonemap_grow(zones);
+	}
+	if (memcmp(&zones->entries[page_num], entry, sizeof(ZoneEntry)) == 0) {
+		return;
+	}
+	zones->entries[page_num] = *entry;
+	void* page = get_page_for_write(zones->pager, zones->pages[page_num / ZONE_ENTRIES_PER_PAGE]);
+	memcpy(zonemap_entry_in_page(page, page_num % ZONE_ENTRIES_PER_PAGE), entry, sizeof(ZoneEntry));
+}
+
+/**
+  * @brief: free the in memory copy
+  */
+void zonemap_close(ZoneMap* zones) {
+	free(zones->pages);
+	free(zones->entries);
+	free(zones);
+}
@@ -0,0 +1,421 @@
+#include <time.h>
+
+#include "spdb.h"
+
+/* benchmarks of the engine, linked to it directly so nothing but the code
+ * being measured is timed. A table of synthetic rows is built from scratch
+ * in file, then each benchmark runs in turn against it
+
+   insert      execute_insert() of every row, keys in order or shuffled (-R)
+   get_page    get_page() of random pages
+   lookup      select where sl_no = ? of random keys
+   scan_cold   full scan right after the table is opened, with the file
+               dropped from the OS cache first so its pages come off disk
+   scan_warm   full scan once the page cache holds what it can
+   close       db_close() after inserting a batch of rows, the dirty pages
+               written back
+
+ * results are tab separated, one line per benchmark after a header, with
+ * the latency of a single operation at the 50th and 99th percentile
+
+   spdbbench -n 1000000 -l dictionary -m 64 /tmp/bench.db > results.tsv
+   */
+
+#define BENCH_SEED 88172645463325252ULL
+#define BENCH_COMPANIES 3000  // distinct companies of the rows
+#define BENCH_CLOSE_SHARE 100  // close inserts 1/100th of the rows first
+
+#ifndef BENCH_BUILD
+#define BENCH_BUILD "unknown"  // compiler and flags of the engine, given by make bench
+#endif
+
+/**
+ * Structure of BenchOptions
+ *
+ * the table built and how much work each benchmark does
+ */
+typedef struct {
+	const char* filename;
+	PagerOptions pager;
+	LeafLayout layout;
+	uint32_t num_rows;
+	uint32_t num_lookups;  // get_page and lookup operations
+	uint32_t rounds;  // scans and closes
+	uint32_t num_threads;  // for scans, counting the calling one
+	bool shuffle;  // insert keys in random order
+} BenchOptions;
+
+/**
+ * Structure of Samples
+ *
+ * how long every operation of a benchmark took
+ */
+typedef struct {
+	const char* name;
+	double* seconds;
+	uint32_t count;
+	uint32_t capacity;
+	double start;
+} Samples;
+
+static uint64_t random_state = BENCH_SEED;
+
+/**
+  * @brief: xorshift, the same numbers on every run so runs compare
+  */
+static uint64_t bench_random(void) {
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+}
+
+static double now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void samples_init(Samples* samples, const char* name, uint32_t capacity) {
+	samples->name = name;
+	samples->seconds = malloc((capacity ? capacity : 1) * sizeof(double));
+	samples->count = 0;
+	samples->capacity = capacity;
+}
+
+static void samples_start(Samples* samples) {
+	samples->start = now();
+}
+
+static void samples_stop(Samples* samples) {
+	if (samples->count < samples->capacity) {
+		samples->seconds[samples->count++] = now() - samples->start;
+	}
+}
+
+static int compare_seconds(const void* a, const void* b) {
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+  * @brief: latency at percentile of sorted samples, nearest rank
+  */
+static double samples_percentile(const Samples* samples, double percentile) {
+	if (samples->count == 0) {
+		return 0;
+	}
+	uint32_t rank = (uint32_t)(percentile / 100 * samples->count + 0.5);
+	if (rank > 0) {
+		--rank;
+	}
+	if (rank >= samples->count) {
+		rank = samples->count - 1;
+	}
+	return samples->seconds[rank];
+}
+
+/**
+  * @brief: print the line of a benchmark and free its samples
+  */
+static void samples_report(Samples* samples) {
+	double total = 0;
+	for (uint32_t i = 0; i < samples->count; ++i) {
+		total += samples->seconds[i];
+	}
+	qsort(samples->seconds, samples->count, sizeof(double), compare_seconds);
+	printf("%s\t%u\t%.6f\t%.0f\t%.3f\t%.3f\t%.3f\n", samples->name, samples->count, total,
+			total > 0 ? samples->count / total : 0,
+			samples_percentile(samples, 50) * 1e6, samples_percentile(samples, 99) * 1e6,
+			samples->count ? samples->seconds[samples->count - 1] * 1e6 : 0);
+	fflush(stdout);
+	free(samples->seconds);
+}
+
+/**
+  * @brief: synthetic row of a key, the same for a key on every run
+  */
+static void bench_row(Row* row, uint32_t key) {
+	row->sl_no = key;
+	row->year = 1990 + key % 30;
+	snprintf(row->company, sizeof(row->company), "co%u", key % BENCH_COMPANIES);
+	snprintf(row->model, sizeof(row->model), "model%u", key);
+	row->power = (key % 100000) / 10.0;
+}
+
+/**
+  * @brief: have the OS forget the cached pages of the closed table's file
+  */
+static void bench_drop_cache(const BenchOptions* options) {
+	int file_descriptor = open(options->filename, O_RDONLY);
+	if (file_descriptor == -1) {
+		printf("Unable to open '%s': %d\n", options->filename, errno);
+		exit(EXIT_FAILURE);
+	}
+	posix_fadvise(file_descriptor, 0, 0, POSIX_FADV_DONTNEED);
+	close(file_descriptor);
+}
+
+static Table* bench_open(const BenchOptions* options) {
+	Table* table = db_open(options->filename, &options->pager, options->layout);
+	if (options->num_threads > 1) {
+		table->pool = threadpool_open(options->num_threads - 1);
+	}
+	return table;
+}
+
+/**
+  * @brief: insert rows with keys first..first + count - 1, one statement each
+  */
+static void bench_insert(Table* table, Samples* samples, uint32_t first, uint32_t count,
+		bool shuffle) {
+	uint32_t* keys = malloc(count * sizeof(uint32_t));
+	for (uint32_t i = 0; i < count; ++i) {
+		keys[i] = first + i;
+	}
+	for (uint32_t i = count; shuffle && i > 1; --i) {
+		uint32_t j = bench_random() % i;
+		uint32_t key = keys[i - 1];
+		keys[i - 1] = keys[j];
+		keys[j] = key;
+	}
+	Statement statement;
+	statement.type = STATEMENT_INSERT;
+	for (uint32_t i = 0; i < count; ++i) {
+		bench_row(&statement.row_to_insert, keys[i]);
+		if (samples != NULL) {
+			samples_start(samples);
+		}
+		ExecuteResult result = execute_insert(table, &statement);
+		if (samples != NULL) {
+			samples_stop(samples);
+		}
+		if (result != EXECUTE_SUCCESS) {
+			printf("Insert of %u failed: %d\n", keys[i], result);
+			exit(EXIT_FAILURE);
+		}
+	}
+	free(keys);
+}
+
+static void bench_prepare(PreparedStatement* prepared, const char* text) {
+	if (statement_prepare(prepared, text) != PREPARE_SUCCESS) {
+		printf("Unable to prepare '%s'.\n", text);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void bench_step(Table* table, PreparedStatement* prepared, Output* output) {
+	if (statement_step(table, prepared, output) != EXECUTE_SUCCESS) {
+		printf("Statement failed.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void bench_get_page(Table* table, const BenchOptions* options) {
+	Samples samples;
+	samples_init(&samples, "get_page", options->num_lookups);
+	Pager* pager = table->pager;
+	for (uint32_t i = 0; i < options->num_lookups; ++i) {
+		uint32_t page_num = bench_random() % pager->num_pages;
+		samples_start(&samples);
+		get_page(pager, page_num);
+		samples_stop(&samples);
+	}
+	samples_report(&samples);
+}
+
+static void bench_lookup(Table* table, const BenchOptions* options, Output* output) {
+	Samples samples;
+	samples_init(&samples, "lookup", options->num_lookups);
+	PreparedStatement prepared;
+	bench_prepare(&prepared, "select where sl_no = ?");
+	for (uint32_t i = 0; i < options->num_lookups; ++i) {
+		statement_bind_uint32(&prepared, 1, 1 + bench_random() % options->num_rows);
+		samples_start(&samples);
+		bench_step(table, &prepared, output);
+		samples_stop(&samples);
+	}
+	samples_report(&samples);
+}
+
+/**
+  * @brief: full scans, on a table just opened or on one already scanned
+  */
+static void bench_scan(const BenchOptions* options, Output* output, bool cold) {
+	Samples samples;
+	samples_init(&samples, cold ? "scan_cold" : "scan_warm", options->rounds);
+	PreparedStatement prepared;
+	bench_prepare(&prepared, "select count(*), sum(power)");
+	Table* table = cold ? NULL : bench_open(options);
+	if (!cold) {
+		bench_step(table, &prepared, output);
+	}
+	for (uint32_t i = 0; i < options->rounds; ++i) {
+		if (cold) {
+			bench_drop_cache(options);
+			table = bench_open(options);
+		}
+		samples_start(&samples);
+		bench_step(table, &prepared, output);
+		samples_stop(&samples);
+		if (cold) {
+			db_close(table);
+		}
+	}
+	if (!cold) {
+		db_close(table);
+	}
+	samples_report(&samples);
+}
+
+/**
+  * @brief: close after a batch of inserts, keys go on after the table's
+  */
+static void bench_close(const BenchOptions* options) {
+	Samples samples;
+	samples_init(&samples, "close", options->rounds);
+	uint32_t batch = options->num_rows / BENCH_CLOSE_SHARE + 1;
+	uint32_t first = options->num_rows + 1;
+	for (uint32_t i = 0; i < options->rounds; ++i) {
+		Table* table = bench_open(options);
+		bench_insert(table, NULL, first, batch, options->shuffle);
+		first += batch;
+		samples_start(&samples);
+		db_close(table);
+		samples_stop(&samples);
+	}
+	samples_report(&samples);
+}
+
+static void usage(const char* program) {
+	printf("Usage: %s [-A] [-D] [-H] [-n rows] [-k lookups] [-r rounds] [-R] [-j threads] [-l rows|columns|slotted|dictionary] [-m cache_mb] [-M] [-s off|normal|full] [-w] <db file>\n",
+			program);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	pager_options_init(&options.pager);
+	options.layout = LEAF_LAYOUT_SLOTTED;
+	options.num_rows = 100000;
+	options.num_lookups = 100000;
+	options.rounds = 5;
+	options.num_threads = 1;
+	options.shuffle = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "ADHj:k:l:m:Mn:r:Rs:w")) != -1) {
+		switch (opt) {
+			case 'A':
+				options.pager.read_ahead = false;
+				break;
+			case 'D':
+				options.pager.direct_io = true;
+				break;
+			case 'H':
+				options.pager.huge_pages = true;
+				break;
+			case 'j':
+				options.num_threads = atol(optarg);
+				break;
+			case 'k':
+				options.num_lookups = atol(optarg);
+				break;
+			case 'l':
+				if (strcmp(optarg, "rows") == 0) {
+					options.layout = LEAF_LAYOUT_ROWS;
+				}
+				else if (strcmp(optarg, "columns") == 0) {
+					options.layout = LEAF_LAYOUT_COLUMNS;
+				}
+				else if (strcmp(optarg, "slotted") == 0) {
+					options.layout = LEAF_LAYOUT_SLOTTED;
+				}
+				else if (strcmp(optarg, "dictionary") == 0) {
+					options.layout = LEAF_LAYOUT_DICTIONARY;
+				}
+				else {
+					usage(argv[0]);
+				}
+				break;
+			case 'm':
+				options.pager.pool_size = (size_t)atol(optarg) * 1024 * 1024;
+				break;
+			case 'M':
+				options.pager.backend = PAGER_BACKEND_MMAP;
+				break;
+			case 'n':
+				options.num_rows = atol(optarg);
+				break;
+			case 'r':
+				options.rounds = atol(optarg);
+				break;
+			case 'R':
+				options.shuffle = true;
+				break;
+			case 's':
+				if (strcmp(optarg, "off") == 0) {
+					options.pager.sync = WAL_SYNC_OFF;
+				}
+				else if (strcmp(optarg, "normal") == 0) {
+					options.pager.sync = WAL_SYNC_NORMAL;
+				}
+				else if (strcmp(optarg, "full") == 0) {
+					options.pager.sync = WAL_SYNC_FULL;
+				}
+				else {
+					usage(argv[0]);
+				}
+				break;
+			case 'w':
+				options.pager.use_wal = false;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind >= argc || options.num_rows < 1 || options.num_threads < 1) {
+		usage(argv[0]);
+	}
+	options.filename = argv[optind];
+
+	// built from scratch every run, a table left by the last one would skew it
+	char* wal_filename = malloc(strlen(options.filename) + sizeof("-wal"));
+	strcpy(wal_filename, options.filename);
+	strcat(wal_filename, "-wal");
+	unlink(options.filename);
+	unlink(wal_filename);
+	free(wal_filename);
+
+	static const char* layouts[] = {"rows", "columns", "slotted", "dictionary"};
+	printf("# rows=%u lookups=%u rounds=%u order=%s threads=%u layout=%s backend=%s cache_mb=%zu wal=%s read_ahead=%s direct_io=%s huge_pages=%s build=\"%s\"\n",
+			options.num_rows, options.num_lookups, options.rounds,
+			options.shuffle ? "random" : "sequential", options.num_threads,
+			layouts[options.layout], options.pager.backend == PAGER_BACKEND_MMAP ? "mmap" : "pool",
+			options.pager.pool_size / (1024 * 1024), options.pager.use_wal ? "on" : "off",
+			options.pager.read_ahead ? "on" : "off", options.pager.direct_io ? "on" : "off",
+			options.pager.huge_pages ? "on" : "off", BENCH_BUILD);
+	printf("benchmark\tops\tseconds\tops_per_s\tp50_us\tp99_us\tmax_us\n");
+
+	FILE* null = fopen("/dev/null", "w");
+	Output* output = output_open(null, OUTPUT_BINARY);
+
+	Samples samples;
+	samples_init(&samples, "insert", options.num_rows);
+	Table* table = bench_open(&options);
+	bench_insert(table, &samples, 1, options.num_rows, options.shuffle);
+	samples_report(&samples);
+	bench_get_page(table, &options);
+	bench_lookup(table, &options, output);
+	db_close(table);
+
+	bench_scan(&options, output, true);
+	bench_scan(&options, output, false);
+	bench_close(&options);
+
+	output_close(output);
+	fclose(null);
+	return 0;
+}
@@ -0,0 +1,260 @@
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "server.h"
+
+/* load generator for spdb -S, every connection is a thread keeping a number
+ * of requests in flight and timing each from when it's sent until its
+ * response is read. A value of # is replaced by a number no other request
+ * uses, so inserts don't collide
+
+   spdbload -S /tmp/spdb.sock -c 8 -n 10000 -d 16 'select where sl_no = ?' #
+   */
+
+#define LOAD_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Structure of LoadOptions
+ *
+ * what every connection sends, and where to
+ */
+typedef struct {
+	const char* socket_path;
+	uint16_t port;  // TCP on localhost instead, if not 0
+	uint32_t num_requests;  // per connection
+	uint32_t depth;  // requests in flight per connection
+	const char* statement;
+	const char** values;
+	uint32_t num_values;
+	uint32_t first_number;  // of the numbers put for #
+} LoadOptions;
+
+/**
+ * Structure of LoadConnection
+ *
+ * one client thread and what it measured
+ */
+typedef struct {
+	const LoadOptions* options;
+	uint32_t index;
+	pthread_t thread;
+	uint64_t errors;
+	uint64_t bytes;  // of response bodies
+	double total_latency;
+	double max_latency;
+} LoadConnection;
+
+static double now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+  * @brief: connect to the server as options say
+  */
+static int load_connect(const LoadOptions* options) {
+	int fd;
+	if (options->port != 0) {
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(options->port);
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+			printf("Unable to connect to port %u: %d\n", options->port, errno);
+			exit(EXIT_FAILURE);
+		}
+		return fd;
+	}
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, options->socket_path, sizeof(address.sun_path) - 1);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+		printf("Unable to connect to '%s': %d\n", options->socket_path, errno);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+/**
+  * @brief: send the request-th request of a connection
+  */
+static void load_send(LoadConnection* load, int fd, uint32_t request) {
+	const LoadOptions* options = load->options;
+	char buffer[SERVER_MAX_REQUEST + PROTOCOL_HEADER_SIZE];
+	char number[16];
+	const char* values[MAX_PARAMETERS];
+	snprintf(number, sizeof(number), "%u",
+			options->first_number + load->index * options->num_requests + request);
+	for (uint32_t i = 0; i < options->num_values; ++i) {
+		values[i] = strcmp(options->values[i], "#") == 0 ? number : options->values[i];
+	}
+	size_t length = protocol_encode_request(buffer, sizeof(buffer), options->statement, values,
+			options->num_values);
+	if (length == 0) {
+		printf("Request is too long.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (size_t sent = 0; sent < length; ) {
+		ssize_t count = send(fd, buffer + sent, length - sent, MSG_NOSIGNAL);
+		if (count <= 0) {
+			printf("Error sending request: %d\n", errno);
+			exit(EXIT_FAILURE);
+		}
+		sent += count;
+	}
+}
+
+/**
+  * @brief: read exactly length bytes, or skip them if buffer is NULL
+  */
+static void load_receive(int fd, char* buffer, size_t length) {
+	char discard[64 * 1024];
+	while (length > 0) {
+		size_t size = length;
+		char* into = buffer;
+		if (buffer == NULL) {
+			into = discard;
+			size = size < sizeof(discard) ? size : sizeof(discard);
+		}
+		ssize_t count = recv(fd, into, size, 0);
+		if (count <= 0) {
+			printf("Server closed the connection.\n");
+			exit(EXIT_FAILURE);
+		}
+		length -= count;
+		if (buffer != NULL) {
+			buffer += count;
+		}
+	}
+}
+
+/**
+  * @brief: keep depth requests in flight until every one is answered
+  */
+static void* load_run(void* argument) {
+	LoadConnection* load = argument;
+	const LoadOptions* options = load->options;
+	int fd = load_connect(options);
+	double* sent_at = malloc(options->depth * sizeof(double));
+	uint32_t sent = 0;
+	for (uint32_t received = 0; received < options->num_requests; ++received) {
+		while (sent < options->num_requests && sent - received < options->depth) {
+			sent_at[sent % options->depth] = now();
+			load_send(load, fd, sent++);
+		}
+		char header[PROTOCOL_HEADER_SIZE];
+		uint32_t length;
+		uint8_t kind;
+		do {  // a big result comes in parts before its last frame
+			load_receive(fd, header, sizeof(header));
+			protocol_decode_header(header, &length, &kind);
+			if (kind == RESPONSE_ERROR && load->errors++ == 0) {
+				char message[256];
+				uint32_t size = length < sizeof(message) - 1 ? length : sizeof(message) - 1;
+				load_receive(fd, message, size);
+				message[size] = '\0';
+				printf("connection %u: %s\n", load->index, message);
+				length -= size;
+			}
+			load_receive(fd, NULL, length);
+			load->bytes += length;
+		} while (kind == RESPONSE_MORE);
+		double latency = now() - sent_at[received % options->depth];
+		load->total_latency += latency;
+		if (latency > load->max_latency) {
+			load->max_latency = latency;
+		}
+	}
+	free(sent_at);
+	close(fd);
+	return NULL;
+}
+
+static void usage(const char* program) {
+	printf("Usage: %s (-S socket | -p port) [-c connections] [-n requests] [-d depth] [-k first] statement [value ...]\n",
+			program);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+	LoadOptions options;
+	options.socket_path = NULL;
+	options.port = 0;
+	options.num_requests = 1000;
+	options.depth = 1;
+	options.first_number = 1;
+	long num_connections = 1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "c:d:k:n:p:S:")) != -1) {
+		switch (opt) {
+			case 'c':
+				num_connections = atol(optarg);
+				break;
+			case 'd':
+				options.depth = atol(optarg);
+				break;
+			case 'k':
+				options.first_number = atol(optarg);
+				break;
+			case 'n':
+				options.num_requests = atol(optarg);
+				break;
+			case 'p':
+				options.port = atol(optarg);
+				break;
+			case 'S':
+				options.socket_path = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind >= argc || num_connections < 1 || options.depth < 1
+			|| (options.socket_path == NULL && options.port == 0)
+			|| argc - optind - 1 > MAX_PARAMETERS) {
+		usage(argv[0]);
+	}
+	options.statement = argv[optind];
+	options.values = (const char**)(argv + optind + 1);
+	options.num_values = argc - optind - 1;
+
+	LoadConnection* loads = calloc(num_connections, sizeof(LoadConnection));
+	double start = now();
+	for (long i = 0; i < num_connections; ++i) {
+		loads[i].options = &options;
+		loads[i].index = i;
+		pthread_create(&loads[i].thread, NULL, load_run, &loads[i]);
+	}
+	uint64_t errors = 0;
+	uint64_t bytes = 0;
+	double total_latency = 0;
+	double max_latency = 0;
+	for (long i = 0; i < num_connections; ++i) {
+		pthread_join(loads[i].thread, NULL);
+		errors += loads[i].errors;
+		bytes += loads[i].bytes;
+		total_latency += loads[i].total_latency;
+		if (loads[i].max_latency > max_latency) {
+			max_latency = loads[i].max_latency;
+		}
+	}
+	double seconds = now() - start;
+	uint64_t requests = (uint64_t)num_connections * options.num_requests;
+	printf("%lu requests, %lu errors, %lu bytes in %.3fs\n", requests, errors, bytes, seconds);
+	printf("%.0f requests/s, latency avg %.3fms max %.3fms\n", requests / seconds,
+			requests > 0 ? total_latency / requests * 1e3 : 0, max_latency * 1e3);
+	free(loads);
+	return 0;
+}